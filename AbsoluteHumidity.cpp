@@ -0,0 +1,88 @@
+//
+// (c)2020 by Lucky Resistor. See LICENSE for details.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+#include "AbsoluteHumidity.hpp"
+
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+
+namespace lr {
+
+
+namespace {
+
+constexpr int32_t cMinimumTemperature = -100000; ///< The lowest temperature in the table, in 1/1000 celsius.
+constexpr int32_t cMaximumTemperature = 100000; ///< The highest temperature in the table, in 1/1000 celsius.
+constexpr int32_t cTemperatureStep = 125; ///< The temperature step of the table, in 1/1000 celsius.
+constexpr int32_t cMaximumHumidity = 100000; ///< The maximum relative humidity, in 1/1000 percent.
+constexpr std::size_t cTableSize = (cMaximumTemperature - cMinimumTemperature) / cTemperatureStep + 2; ///< Including one padding entry.
+
+/// Calculate the absolute humidity in g/m3, using the formula from the datasheet.
+///
+double getAbsoluteHumidityDouble(double temperatureCelsius, double relativeHumidity)
+{
+    const double humidityFactor = (relativeHumidity / 100);
+    const double temperatureFactor = std::exp((17.62 * temperatureCelsius)/(243.12 + temperatureCelsius));
+    return 216.7 * ((humidityFactor * 6.112 * temperatureFactor) / (273.15 + temperatureCelsius));
+}
+
+/// Create the table with the absolute humidity at 100% relative humidity, in 1/65536 g/m3.
+///
+std::array<uint32_t, cTableSize> createSaturationTable()
+{
+    std::array<uint32_t, cTableSize> table{};
+    for (std::size_t i = 0; i < cTableSize - 1; ++i) {
+        const double temperature = (cMinimumTemperature + static_cast<int32_t>(i) * cTemperatureStep) / 1000.0;
+        table[i] = static_cast<uint32_t>(std::lround(getAbsoluteHumidityDouble(temperature, 100.0) * 65536.0));
+    }
+    // The padding entry allows the interpolation at the maximum temperature without a branch.
+    table[cTableSize - 1] = table[cTableSize - 2];
+    return table;
+}
+
+const auto cSaturationTable = createSaturationTable();
+
+}
+
+
+uint16_t getAbsoluteHumidity(int32_t temperatureMilliCelsius, int32_t relativeHumidityMilliPercent) noexcept
+{
+    const auto temperature = std::clamp(temperatureMilliCelsius, cMinimumTemperature, cMaximumTemperature);
+    const auto humidity = std::clamp(relativeHumidityMilliPercent, 0, cMaximumHumidity);
+    const auto offset = static_cast<uint32_t>(temperature - cMinimumTemperature);
+    const auto index = offset / cTemperatureStep;
+    const auto fraction = offset % cTemperatureStep;
+    const uint64_t saturation = cSaturationTable[index]
+        + (static_cast<uint64_t>(cSaturationTable[index + 1] - cSaturationTable[index]) * fraction) / cTemperatureStep;
+    // Scale from 1/65536 g/m3 to the 8.8 fixed-point format (1/256 g/m3).
+    const auto result = (saturation * static_cast<uint64_t>(humidity)) / (static_cast<uint64_t>(cMaximumHumidity) * 256);
+    return static_cast<uint16_t>(std::min<uint64_t>(result, 0xffffu));
+}
+
+
+uint16_t calculateAbsoluteHumidity(double temperatureCelsius, double relativeHumidity) noexcept
+{
+    const double absoluteHumidity = getAbsoluteHumidityDouble(temperatureCelsius, relativeHumidity);
+    return static_cast<uint16_t>(std::min(absoluteHumidity * 256.0, 65535.0));
+}
+
+
+}
+
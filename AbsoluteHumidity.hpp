@@ -0,0 +1,52 @@
+#pragma once
+//
+// (c)2020 by Lucky Resistor. See LICENSE for details.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+
+
+#include <cstdint>
+
+
+namespace lr {
+
+
+/// Calculate the absolute humidity in the 8.8 fixed-point format of the SGP30.
+///
+/// This function uses a lookup table over the temperature range from -100 to 100 celsius
+/// in steps of 1/8 celsius, and interpolates linearly between the entries. It only uses
+/// integer arithmetic and returns the same value as `calculateAbsoluteHumidity()`,
+/// within one LSB. Values outside of the valid range are clamped.
+///
+/// @param temperatureMilliCelsius The temperature in 1/1000 celsius (-100000 to 100000).
+/// @param relativeHumidityMilliPercent The relative humidity in 1/1000 percent (0 to 100000).
+/// @return The absolute humidity in g/m3, as 8.8 fixed-point value, clamped to 0xffff.
+///
+uint16_t getAbsoluteHumidity(int32_t temperatureMilliCelsius, int32_t relativeHumidityMilliPercent) noexcept;
+
+/// Calculate the absolute humidity in the 8.8 fixed-point format of the SGP30.
+///
+/// This is the reference implementation, using the formula from the datasheet with double precision.
+///
+/// @param temperatureCelsius The temperature in celsius (-100 to 100).
+/// @param relativeHumidity The relative humidity in percent (0 to 100).
+/// @return The absolute humidity in g/m3, as 8.8 fixed-point value, clamped to 0xffff.
+///
+uint16_t calculateAbsoluteHumidity(double temperatureCelsius, double relativeHumidity) noexcept;
+
+
+}
+
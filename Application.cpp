@@ -18,12 +18,23 @@
 #include "Application.hpp"
 
 
+#include "BusDiscovery.hpp"
+#include "Coprocess.hpp"
 #include "Configuration.hpp"
+#include "I2CBus.hpp"
+#include "MeasurementFormat.hpp"
+#include "Sampler.hpp"
+#include "StatusMessage.hpp"
+#include "SHT3x.hpp"
+#include "SHT4x.hpp"
 
 #include <sstream>
 #include <fstream>
 #include <iomanip>
 #include <algorithm>
+#include <csignal>
+#include <cstring>
+#include <stdexcept>
 
 
 namespace lr {
@@ -43,6 +54,10 @@ Application::ActionDefinitionList Application::_actionDefinitions = {
     LR_AD(SoftReset, "-z", "Reset the sensor (and other sensors on the same bus!)."),
     LR_AD(StoreIAQBaseline, "-xs", "Store the iAQ baseline."),
     LR_AD(RestoreIAQBaseline, "-xr", "Restore the iAQ baseline."),
+    LR_AD(SampleContinuously, "-c", "Continuously sample the measurements."),
+    LR_AD(WarmStart, "-w", "Initialize the measurements and restore the baseline."),
+    LR_AD(Discover, "-f", "Find the sensors on all buses and multiplexers."),
+    LR_AD(Coprocess, "--coprocess", "Read commands from stdin and answer each with a JSON line."),
 };
 
 
@@ -51,7 +66,36 @@ Application::Application()
     _debuggingEnabled(false),
     _action(Action::None),
     _bus(1),
-    _sgp(nullptr)
+    _muxAddress(0),
+    _muxChannel(0),
+    _discoveryMuxAddresses(),
+    _rescanEnabled(false),
+    _busLockPolicy(BusLock::Policy::Fair),
+    _busLockTimeout(2000),
+    _busLockStatisticsEnabled(false),
+    _statisticsEnabled(false),
+    _perfEnabled(false),
+    _lowPowerEnabled(false),
+    _processingThreadEnabled(false),
+    _rawSignalsEnabled(false),
+    _outputFormat(OutputFormat::Json),
+    _outputSinks(),
+    _outputSinkPolicy(OutputPipeline::Policy::DropOldest),
+    _perfCounters(),
+    _humidityValues(),
+    _humiditySensorType(HumiditySensorType::None),
+    _humidityInterval(60),
+    _humidityFeedSource(),
+    _cacheMaximumAge(0),
+    _measurementCache(),
+    _traceRecordPath(),
+    _traceReplayPath(),
+    _traceReplaySpeed(1.0),
+    _traceRecorder(),
+    _traceReplayer(),
+    _recoveryPolicy(RecoveryEngine::cDefaultPolicy),
+    _sgp(nullptr),
+    _humiditySensor(nullptr)
 {
 }
 
@@ -65,8 +109,34 @@ void Application::showHelp()
         std::cerr << " " << std::setw(12) << std::left << actionDefinition.command;
         std::cerr << " " << std::setw(0) << actionDefinition.description << '\n';
     }
-    std::cerr << " -b0 -b1      Select the bus. 1 is the default.\n";
-    std::cerr << " -d           Show debugging messages." << std::endl;
+    std::cerr << " -b<n>        Select the bus, e.g. -b0. 1 is the default.\n";
+    std::cerr << " -d           Show debugging messages.\n";
+    std::cerr << " --mux=<address>:<channel>    Select a channel of a TCA9548 multiplexer, e.g. --mux=0x70:2.\n";
+    std::cerr << " --mux-addresses=<list>       The multiplexer addresses probed with -f, e.g. --mux-addresses=0x70,0x71.\n";
+    std::cerr << " --rescan                     Probe all buses with -f, instead of verifying the cached topology.\n";
+    std::cerr << " --lock-timeout=<ms>          Maximum wait for the bus lock. 2000 is the default.\n";
+    std::cerr << " --lock-policy=fair|backoff   The policy to wait for the bus lock. fair is the default.\n";
+    std::cerr << " --lock-stats                 Write the bus lock wait statistics to stderr.\n";
+    std::cerr << " --stats                      Write the bus and command latency statistics to stderr.\n";
+    std::cerr << " --perf                       Write the CPU performance counters of the action and of each sampling cycle.\n";
+    std::cerr << " --format=json|cbor|msgpack   The format of the results and samples. json is the default.\n";
+    std::cerr << " --sink=<sink>                Write the samples of -c through a buffered pipeline into a sink: stdout,\n";
+    std::cerr << "                              file:<path>, socket:<path> or shm:<name>. Can be repeated.\n";
+    std::cerr << " --sink-policy=<policy>       drop-oldest or block, if a sink is too slow. drop-oldest is the default.\n";
+    std::cerr << " --cache=<ms>                 Return a cached measurement if it is not older than <ms>.\n";
+    std::cerr << " --humidity=<T>,<RH>          Set the humidity compensation for -w, in celsius and percent.\n";
+    std::cerr << " --sht3x --sht4x              Use a SHT3x or SHT4x sensor on the same bus for the humidity compensation.\n";
+    std::cerr << " --humidity-interval=<s>      The interval to update the humidity compensation with -c. 60 is the default.\n";
+    std::cerr << " --humidity-feed=<path>       Read \"<T> <RH>\" lines for the humidity compensation with -c. - for stdin.\n";
+    std::cerr << " --trace-record=<path>        Record all bus transfers into a binary trace file.\n";
+    std::cerr << " --trace-replay=<path>        Replay the bus transfers from a trace file instead of using the bus.\n";
+    std::cerr << " --trace-speed=<factor>       The speed factor of the replay. 1 is the default, 0 replays without delays.\n";
+    std::cerr << " --retries=<n>                Retries of a failed reading with -c. 3 is the default.\n";
+    std::cerr << " --retry-backoff=<ms>         The wait before the first retry, doubled for each retry. 10 is the default.\n";
+    std::cerr << " --no-reset                   Do not reset the sensor to recover from failed readings with -c.\n";
+    std::cerr << " --low-power                  Sample with -c in a single wakeup per reading, and flush the output every 10 readings.\n";
+    std::cerr << " --processing-thread          Format and write the samples of -c in a separate thread, fed by a lock-free queue.\n";
+    std::cerr << " --raw-signals                Read the raw H2 and ethanol signals with each measurement of -c." << std::endl;
 }
 
 
@@ -104,10 +174,156 @@ Application::ParsingStatus Application::parseCommandLine(int argc, char **argv)
             return ParsingStatus::Success;
         } else if (arg == "-d") {
             _debuggingEnabled = true;
-        } else if (arg == "-b0") {
-            _bus = 0;
-        } else if (arg == "-b1") {
-            _bus = 1;
+        } else if (arg.rfind("-b", 0) == 0 && arg.size() > 2) {
+            try {
+                std::size_t end = 0;
+                _bus = std::stoi(arg.substr(2), &end);
+                if (end != arg.size() - 2 || _bus < 0) {
+                    throw std::invalid_argument("invalid bus");
+                }
+            } catch (const std::logic_error&) {
+                std::cerr << "Invalid bus \"" << arg << "\"." << std::endl;
+                return ParsingStatus::Failure;
+            }
+        } else if (arg.rfind("--mux=", 0) == 0) {
+            const auto separator = arg.find(':');
+            try {
+                if (separator == std::string::npos) {
+                    throw std::invalid_argument("missing separator");
+                }
+                const auto address = std::stoul(arg.substr(6, separator - 6), nullptr, 0);
+                const auto channel = std::stoul(arg.substr(separator + 1));
+                if (address < BusDiscovery::cFirstMuxAddress || address > BusDiscovery::cLastMuxAddress
+                    || channel >= BusDiscovery::cMuxChannelCount) {
+                    throw std::out_of_range("invalid mux");
+                }
+                _muxAddress = static_cast<uint8_t>(address);
+                _muxChannel = static_cast<uint8_t>(channel);
+            } catch (const std::logic_error&) {
+                std::cerr << "Invalid multiplexer channel \"" << arg << "\"." << std::endl;
+                return ParsingStatus::Failure;
+            }
+        } else if (arg.rfind("--mux-addresses=", 0) == 0) {
+            std::istringstream addressList(arg.substr(16));
+            std::string addressText;
+            try {
+                while (std::getline(addressList, addressText, ',')) {
+                    const auto address = std::stoul(addressText, nullptr, 0);
+                    if (address < BusDiscovery::cFirstMuxAddress || address > BusDiscovery::cLastMuxAddress) {
+                        throw std::out_of_range("invalid mux");
+                    }
+                    _discoveryMuxAddresses.push_back(static_cast<uint8_t>(address));
+                }
+                if (_discoveryMuxAddresses.empty()) {
+                    throw std::invalid_argument("no address");
+                }
+            } catch (const std::logic_error&) {
+                std::cerr << "Invalid multiplexer addresses \"" << arg << "\"." << std::endl;
+                return ParsingStatus::Failure;
+            }
+        } else if (arg == "--rescan") {
+            _rescanEnabled = true;
+        } else if (arg.rfind("--lock-timeout=", 0) == 0) {
+            try {
+                _busLockTimeout = std::chrono::milliseconds(std::stoul(arg.substr(15)));
+            } catch (const std::logic_error&) {
+                std::cerr << "Invalid lock timeout \"" << arg << "\"." << std::endl;
+                return ParsingStatus::Failure;
+            }
+        } else if (arg == "--lock-policy=fair") {
+            _busLockPolicy = BusLock::Policy::Fair;
+        } else if (arg == "--lock-policy=backoff") {
+            _busLockPolicy = BusLock::Policy::Backoff;
+        } else if (arg == "--lock-stats") {
+            _busLockStatisticsEnabled = true;
+        } else if (arg == "--stats") {
+            _statisticsEnabled = true;
+        } else if (arg == "--perf") {
+            _perfEnabled = true;
+        } else if (arg == "--low-power") {
+            _lowPowerEnabled = true;
+        } else if (arg == "--processing-thread") {
+            _processingThreadEnabled = true;
+        } else if (arg == "--raw-signals") {
+            _rawSignalsEnabled = true;
+        } else if (arg == "--format=json") {
+            _outputFormat = OutputFormat::Json;
+        } else if (arg == "--format=cbor") {
+            _outputFormat = OutputFormat::Cbor;
+        } else if (arg == "--format=msgpack") {
+            _outputFormat = OutputFormat::MessagePack;
+        } else if (arg.rfind("--sink=", 0) == 0) {
+            const auto sink = arg.substr(7);
+            if (sink != "stdout" && sink.rfind("file:", 0) != 0 && sink.rfind("socket:", 0) != 0
+                && sink.rfind("shm:", 0) != 0) {
+                std::cerr << "Invalid sink \"" << arg << "\"." << std::endl;
+                return ParsingStatus::Failure;
+            }
+            _outputSinks.push_back(sink);
+        } else if (arg == "--sink-policy=drop-oldest") {
+            _outputSinkPolicy = OutputPipeline::Policy::DropOldest;
+        } else if (arg == "--sink-policy=block") {
+            _outputSinkPolicy = OutputPipeline::Policy::Block;
+        } else if (arg.rfind("--humidity=", 0) == 0) {
+            const auto separator = arg.find(',');
+            try {
+                if (separator == std::string::npos) {
+                    throw std::invalid_argument("missing separator");
+                }
+                _humidityValues = std::make_tuple(
+                    std::stod(arg.substr(11, separator - 11)),
+                    std::stod(arg.substr(separator + 1)));
+            } catch (const std::logic_error&) {
+                std::cerr << "Invalid humidity values \"" << arg << "\"." << std::endl;
+                return ParsingStatus::Failure;
+            }
+        } else if (arg == "--sht3x") {
+            _humiditySensorType = HumiditySensorType::SHT3x;
+        } else if (arg == "--sht4x") {
+            _humiditySensorType = HumiditySensorType::SHT4x;
+        } else if (arg.rfind("--humidity-interval=", 0) == 0) {
+            try {
+                _humidityInterval = std::chrono::seconds(std::stoul(arg.substr(20)));
+            } catch (const std::logic_error&) {
+                std::cerr << "Invalid humidity interval \"" << arg << "\"." << std::endl;
+                return ParsingStatus::Failure;
+            }
+        } else if (arg.rfind("--humidity-feed=", 0) == 0) {
+            _humidityFeedSource = arg.substr(16);
+        } else if (arg.rfind("--trace-record=", 0) == 0) {
+            _traceRecordPath = arg.substr(15);
+        } else if (arg.rfind("--trace-replay=", 0) == 0) {
+            _traceReplayPath = arg.substr(15);
+        } else if (arg.rfind("--trace-speed=", 0) == 0) {
+            try {
+                _traceReplaySpeed = std::stod(arg.substr(14));
+            } catch (const std::logic_error&) {
+                std::cerr << "Invalid trace speed \"" << arg << "\"." << std::endl;
+                return ParsingStatus::Failure;
+            }
+        } else if (arg.rfind("--retries=", 0) == 0) {
+            try {
+                _recoveryPolicy.retryCount = static_cast<uint32_t>(std::stoul(arg.substr(10)));
+            } catch (const std::logic_error&) {
+                std::cerr << "Invalid retry count \"" << arg << "\"." << std::endl;
+                return ParsingStatus::Failure;
+            }
+        } else if (arg.rfind("--retry-backoff=", 0) == 0) {
+            try {
+                _recoveryPolicy.initialBackoff = std::chrono::milliseconds(std::stoul(arg.substr(16)));
+            } catch (const std::logic_error&) {
+                std::cerr << "Invalid retry backoff \"" << arg << "\"." << std::endl;
+                return ParsingStatus::Failure;
+            }
+        } else if (arg == "--no-reset") {
+            _recoveryPolicy.resetSensor = false;
+        } else if (arg.rfind("--cache=", 0) == 0) {
+            try {
+                _cacheMaximumAge = std::chrono::milliseconds(std::stoul(arg.substr(8)));
+            } catch (const std::logic_error&) {
+                std::cerr << "Invalid cache age \"" << arg << "\"." << std::endl;
+                return ParsingStatus::Failure;
+            }
         } else if (auto it = getActionDefinition(arg); it != _actionDefinitions.cend()) {
             if (_action != Action::None) {
                 std::cerr << "You can only specify one action." << std::endl;
@@ -132,24 +348,92 @@ int Application::run(int argc, char **argv)
     if (const auto result = parseCommandLine(argc, argv); result != ParsingStatus::RunAction) {
         return (result == ParsingStatus::Success) ? 0 : 1;
     }
+    if (!_traceReplayPath.empty()) {
+        // A replay must not mix with the measurements of the real sensor.
+        _cacheMaximumAge = std::chrono::milliseconds(0);
+        if (hasError(_traceReplayer.open(_traceReplayPath))) {
+            return 1;
+        }
+        _traceReplayer.setSpeed(_traceReplaySpeed);
+        _traceReplayer.setEndHandler([]() { Sampler::requestStop(); });
+    }
+    if (_perfEnabled && hasError(_perfCounters.open())) {
+        reportError("open the performance counters", std::strerror(errno));
+        _perfEnabled = false;
+    }
+    if (_action == Action::Discover) {
+        // The discovery opens all buses itself.
+        _perfCounters.start();
+        const auto hasResult = handleDiscover();
+        const auto perfValues = _perfCounters.stop();
+        if (!hasResult) {
+            return 1;
+        }
+        if (_perfEnabled) {
+            writePerfValues("-f", perfValues);
+        }
+        return 0;
+    }
+    if (_action == Action::ReadMeasurements && _cacheMaximumAge.count() > 0) {
+        _perfCounters.start();
+        const bool isCached = readMeasurementsFromCache();
+        const auto perfValues = _perfCounters.stop();
+        if (isCached) {
+            if (_perfEnabled) {
+                writePerfValues("-r", perfValues);
+            }
+            return 0;
+        }
+    }
+    if (!_traceRecordPath.empty() && hasError(_traceRecorder.open(_traceRecordPath))) {
+        return 1;
+    }
     _sgp = new lr::SGP30(_bus, _debuggingEnabled);
-    if (hasError(_sgp->openBus())) {
+    if (!_traceRecordPath.empty()) {
+        _sgp->getBus()->setTraceRecorder(&_traceRecorder);
+    }
+    if (!_traceReplayPath.empty()) {
+        _sgp->getBus()->setBackend(&_traceReplayer);
+    }
+    _sgp->getBus()->setMuxChannel(_muxAddress, _muxChannel);
+    if (const auto status = _sgp->openBus(); hasError(status)) {
+        reportError("open the I2C bus", getStatusMessage(status, _sgp->getErrorDetail(status)));
         return 1;
     }
-    std::string result;
+    _sgp->getBusLock().setPolicy(_busLockPolicy);
+    _sgp->getBusLock().setTimeout(_busLockTimeout);
+    if (_humiditySensorType == HumiditySensorType::SHT3x) {
+        _humiditySensor = new lr::SHT3x(_sgp->getBus());
+    } else if (_humiditySensorType == HumiditySensorType::SHT4x) {
+        _humiditySensor = new lr::SHT4x(_sgp->getBus());
+    }
+    bool hasResult = false;
     const auto actionIt = std::find_if(
             _actionDefinitions.cbegin(),
             _actionDefinitions.cend(),
             [=](const ActionDefinition &ad) {
                 return ad.action == _action;
             });
+    PerfCounters::Values perfValues;
     if (actionIt != _actionDefinitions.cend()) {
-        result = (this->*(actionIt->handler))();
+        _perfCounters.start();
+        hasResult = (this->*(actionIt->handler))();
+        perfValues = _perfCounters.stop();
+    }
+    if (_busLockStatisticsEnabled) {
+        writeBusLockStatistics();
+    }
+    if (_statisticsEnabled) {
+        writeStatistics();
     }
-    if (result.empty()) {
+    if (!hasResult) {
         return 1;
     }
-    std::cout << result << std::endl;
+    if (_perfEnabled) {
+        writePerfValues(actionIt->command, perfValues);
+    }
+    delete _humiditySensor;
+    _humiditySensor = nullptr;
     _sgp->closeBus();
     delete _sgp;
     _sgp = nullptr;
@@ -160,138 +444,478 @@ int Application::run(int argc, char **argv)
 }
 
 
-std::string Application::handleInitializeMeasurements()
+void Application::writeBusLockStatistics()
 {
-    const auto readResult = _sgp->initializeMeasurements();
-    if (hasError(readResult)) {
-        return std::string();
+    const auto &statistics = _sgp->getBusLock().getStatistics();
+    const auto toMs = [](std::chrono::nanoseconds duration) -> double {
+        return std::chrono::duration<double, std::milli>(duration).count();
+    };
+    std::cerr << "{ \"bus_lock_wait_ms\": " << std::fixed << std::setprecision(3) << toMs(statistics.totalWait)
+        << ", \"bus_lock_max_wait_ms\": " << toMs(statistics.maximumWait)
+        << ", \"bus_lock_acquisitions\": " << statistics.acquisitions
+        << ", \"bus_lock_contentions\": " << statistics.contentions
+        << ", \"bus_lock_timeouts\": " << statistics.timeouts << " }" << std::endl;
+}
+
+
+void Application::writeStatistics()
+{
+    std::vector<const SensirionSensor*> sensors = {_sgp};
+    if (_humiditySensor != nullptr) {
+        sensors.push_back(_humiditySensor);
+    }
+    SensirionSensor::writeStatisticsJson(std::cerr, sensors);
+    std::cerr << std::endl;
+}
+
+
+void Application::writePerfValues(const std::string &action, const PerfCounters::Values &values) const
+{
+    auto &output = (_outputFormat == OutputFormat::Json) ? std::cout : std::cerr;
+    output << "{ \"action\": \"" << action << "\", \"perf\": ";
+    values.writeJson(output);
+    output << " }" << std::endl;
+}
+
+
+bool Application::readMeasurementsFromCache()
+{
+    try {
+        fs::create_directories(getStorageDir());
+    } catch (const fs::filesystem_error&) {
+        // ignore any errors from this.
+    }
+    if (hasError(_measurementCache.open(getMeasurementCacheFile()))) {
+        return false;
+    }
+    const auto lookupResult = _measurementCache.lookup(_cacheMaximumAge);
+    if (hasError(lookupResult)) {
+        return false;
+    }
+    if (_debuggingEnabled) {
+        std::cout << "# Using the cached measurement." << std::endl;
+    }
+    const auto [co2, tvoc] = lookupResult.getValue();
+    writeMeasurementResult(MeasurementRecord{co2, tvoc});
+    return true;
+}
+
+
+bool Application::reportError(const char *action, const std::string &message)
+{
+    std::cerr << "Failed to " << action << ". " << message << std::endl;
+    return false;
+}
+
+
+bool Application::writeStatusResult(const char *status) const
+{
+    if (_outputFormat == OutputFormat::Json) {
+        std::cout << R"({ "status": ")" << status << "\" }" << std::endl;
+        return true;
+    }
+    BinaryRecordWriter writer(_outputFormat);
+    writer.writeStatus(status);
+    return writeBinaryResult(writer);
+}
+
+
+bool Application::writeMeasurementResult(const MeasurementRecord &record) const
+{
+    if (_outputFormat == OutputFormat::Json) {
+        writeMeasurementJson(std::cout, record);
+        std::cout << std::endl;
+        return true;
     }
-    // Output the values as JSON
-    return std::string(R"({ "status": "init_success" })");
+    BinaryRecordWriter writer(_outputFormat);
+    writer.writeMeasurement(record);
+    return writeBinaryResult(writer);
 }
 
 
-std::string Application::handleReadMeasurements()
+bool Application::writeSerialNumberResult(uint64_t serialNumber) const
+{
+    if (_outputFormat == OutputFormat::Json) {
+        std::cout << R"({ "serial_number": ")" << std::hex << std::setw(12) << std::setfill('0') << serialNumber
+            << std::dec << std::setfill(' ') << "\" }" << std::endl;
+        return true;
+    }
+    BinaryRecordWriter writer(_outputFormat);
+    writer.writeSerialNumber(serialNumber);
+    return writeBinaryResult(writer);
+}
+
+
+bool Application::writeBinaryResult(const BinaryRecordWriter &writer) const
+{
+    writer.writeTo(std::cout);
+    std::cout.flush();
+    return true;
+}
+
+
+bool Application::handleInitializeMeasurements()
+{
+    const auto status = _sgp->initializeMeasurements();
+    if (hasError(status)) {
+        return reportError("initialize the measurements", getStatusMessage(status, _sgp->getErrorDetail(status)));
+    }
+    return writeStatusResult("init_success");
+}
+
+
+bool Application::handleReadMeasurements()
 {
     const auto readResult = _sgp->readMeasurements();
     if (hasError(readResult)) {
-        return std::string();
+        return reportError("read the measurements", getStatusMessage(readResult));
+    }
+    if (_cacheMaximumAge.count() > 0) {
+        if (const auto status = _measurementCache.update(readResult.getValue()); hasError(status)) {
+            reportError("update the measurement cache", std::strerror(errno));
+        }
     }
-    // Output the values as JSON
     const auto [co2, tvoc] = readResult.getValue();
-    std::stringstream result;
-    result << "{ \"co2_ppm\": " << co2 << ", \"tvoc_ppb\": " << tvoc << " }";
-    return result.str();
+    return writeMeasurementResult(MeasurementRecord{co2, tvoc});
 }
 
 
-std::string Application::handleMeasurementTest()
+bool Application::handleMeasurementTest()
 {
     const auto readResult = _sgp->makeMeasurementTest();
-    // Output the values as JSON
     if (hasError(readResult)) {
-        return std::string(R"({ "status": "test_failure" })");
-    } else {
-        return std::string(R"({ "status": "test_success" })");
+        reportError("make the measurement test", getStatusMessage(readResult));
+        return writeStatusResult("test_failure");
+    }
+    if (readResult.getValue() != SGP30::cMeasurementTestPassed) {
+        std::cerr << "The measurement test returned 0x" << std::hex << std::setw(4) << std::setfill('0')
+            << readResult.getValue() << ", expected 0x" << SGP30::cMeasurementTestPassed << "." << std::dec << std::endl;
+        return writeStatusResult("test_failure");
     }
+    return writeStatusResult("test_success");
 }
 
 
-std::string Application::handleReadSerialNumber()
+bool Application::handleReadSerialNumber()
 {
-    const auto readResult = _sgp->readSerialNumber();
+    const auto readResult = _sgp->readSerialNumberValue();
     if (hasError(readResult)) {
-        return std::string();
+        return reportError("read the serial number", getStatusMessage(readResult));
     }
-    std::stringstream result;
-    result << R"({ "serial_number": ")" << readResult.getValue() << "\" }";
-    return result.str();
+    return writeSerialNumberResult(readResult.getValue());
 }
 
 
-std::string Application::handleSoftReset()
+bool Application::handleSoftReset()
 {
-    const auto readResult = _sgp->softReset();
-    if (hasError(readResult)) {
-        return std::string();
+    const auto status = _sgp->softReset();
+    if (hasError(status)) {
+        return reportError("reset the sensor", getStatusMessage(status, _sgp->getErrorDetail(status)));
     }
-    return std::string(R"({ "status": "reset_successful" })");
+    return writeStatusResult("reset_successful");
 }
 
 
-std::string Application::handleStoreIAQBaseline()
+bool Application::handleStoreIAQBaseline()
 {
     const auto readResult = _sgp->getIAQBaseline();
     if (hasError(readResult)) {
-        return std::string();
+        return reportError("read the baseline", getStatusMessage(readResult));
+    }
+    const auto serialResult = _sgp->readSerialNumberValue();
+    if (hasError(serialResult)) {
+        return reportError("read the serial number", getStatusMessage(serialResult));
     }
     const auto [a, b] = readResult.getValue();
     if (_debuggingEnabled) {
         std::cout << "# Read the baseline values 0x"
             << std::hex << std::setw(4) << std::setfill('0') << a
-            << " and 0x" << b << " from the sensor." << std::endl;
+            << " and 0x" << b << " from the sensor." << std::dec << std::endl;
     }
     try {
         fs::create_directories(getStorageDir());
     } catch (const fs::filesystem_error&) {
         // ignore any errors from this.
     }
-    const auto baselineFile = getBaselineFile();
-    auto tmpFile = baselineFile;
+    const auto journalFile = getStateJournalFile();
     if (_debuggingEnabled) {
-        std::cout << "# Open file for write: " << tmpFile.string() << std::endl;
+        std::cout << "# Append to the state journal: " << journalFile.string() << std::endl;
     }
-    tmpFile.replace_extension(fs::path(".tmp"));
-    std::ofstream fs(tmpFile);
-    if (!fs.is_open()) {
-        std::cerr << "Failed to open the storage file: " << baselineFile << std::endl;
-        return std::string(R"({ "status": "store_failed" })");
+    BaselineStore baselineStore;
+    if (hasError(baselineStore.open(journalFile))) {
+        return writeStatusResult("store_failed");
+    }
+    if (hasError(baselineStore.store(serialResult.getValue(), readResult.getValue()))
+        || hasError(baselineStore.sync())) {
+        return writeStatusResult("store_failed");
+    }
+    if (_outputFormat != OutputFormat::Json) {
+        BinaryRecordWriter writer(_outputFormat);
+        writer.writeBaseline(serialResult.getValue(), readResult.getValue());
+        return writeBinaryResult(writer);
     }
-    fs << a << '\n' << b << '\n';
-    fs.close();
+    return writeStatusResult("store_successful");
+}
+
+
+bool Application::handleRestoreIAQBaseline()
+{
+    const auto serialResult = _sgp->readSerialNumberValue();
+    if (hasError(serialResult)) {
+        return reportError("read the serial number", getStatusMessage(serialResult));
+    }
+    const auto baselineResult = readStoredIAQBaseline(serialResult.getValue());
+    if (hasError(baselineResult)) {
+        return writeStatusResult("restore_failed");
+    }
+    const auto [a, b] = baselineResult.getValue();
     if (_debuggingEnabled) {
-        std::cout << "# Rename file: " << tmpFile.string() << " => " << baselineFile.string() << std::endl;
+        std::cout << "# Restore the baseline values 0x"
+                << std::hex << std::setw(4) << std::setfill('0')
+                << a << " and 0x" << b << "." << std::dec << std::endl;
+    }
+    if (const auto status = _sgp->setIAQBaseline(std::make_tuple(a, b)); hasError(status)) {
+        reportError("set the baseline values", getStatusMessage(status, _sgp->getErrorDetail(status)));
+        return writeStatusResult("restore_failed");
+    }
+    return writeStatusResult("restore_successful");
+}
+
+
+bool Application::handleSampleContinuously()
+{
+    try {
+        fs::create_directories(getStorageDir());
+    } catch (const fs::filesystem_error&) {
+        // ignore any errors from this.
+    }
+    BaselineStore baselineStore;
+    if (hasError(baselineStore.open(getStateJournalFile()))) {
+        return false;
+    }
+    Sampler sampler(baselineStore, std::cout);
+    OutputPipeline outputPipeline;
+    if (!_outputSinks.empty()) {
+        for (const auto &sinkArgument : _outputSinks) {
+            auto sink = createOutputSink(sinkArgument);
+            if (sink == nullptr) {
+                return false;
+            }
+            outputPipeline.addSink(std::move(sink));
+        }
+        outputPipeline.setPolicy(_outputSinkPolicy);
+        if (hasError(outputPipeline.start())) {
+            return reportError("start the output pipeline", std::strerror(errno));
+        }
+        sampler.setOutputPipeline(&outputPipeline);
+    }
+    sampler.addSensor(_sgp, _humiditySensor);
+    if (_sgp->getBus()->hasBackend()) {
+        sampler.setInterval(std::chrono::milliseconds(0)); // The backend provides the timing.
+    }
+    sampler.setHumidityInterval(_humidityInterval);
+    sampler.setRecoveryPolicy(_recoveryPolicy);
+    sampler.setLowPower(_lowPowerEnabled);
+    sampler.setProcessingThread(_processingThreadEnabled);
+    sampler.setRawSignals(_rawSignalsEnabled);
+    sampler.setOutputFormat(_outputFormat);
+    if (_perfEnabled) {
+        sampler.setPerfCounters(&_perfCounters);
+    }
+    HumidityFeed humidityFeed;
+    if (!_humidityFeedSource.empty()) {
+        if (hasError(humidityFeed.start(_humidityFeedSource))) {
+            return false;
+        }
+        sampler.setHumidityFeed(&humidityFeed);
+    }
+    std::signal(SIGINT, [](int) { Sampler::requestStop(); });
+    std::signal(SIGTERM, [](int) { Sampler::requestStop(); });
+    std::signal(SIGUSR1, [](int) { Sampler::requestStatistics(); });
+    const auto status = sampler.run();
+    outputPipeline.stop();
+    if (hasError(status)) {
+        return false;
+    }
+    return writeStatusResult("sampling_stopped");
+}
+
+
+std::unique_ptr<OutputSink> Application::createOutputSink(const std::string &sink)
+{
+    if (sink == "stdout") {
+        auto fileSink = std::make_unique<FileSink>();
+        if (hasError(fileSink->openStandardOutput())) {
+            reportError("use the standard output as sink", std::strerror(errno));
+            return nullptr;
+        }
+        return fileSink;
+    }
+    if (sink.rfind("file:", 0) == 0) {
+        auto fileSink = std::make_unique<FileSink>();
+        if (hasError(fileSink->open(sink.substr(5)))) {
+            reportError("open the file sink", sink.substr(5) + ": " + std::strerror(errno));
+            return nullptr;
+        }
+        return fileSink;
+    }
+    if (sink.rfind("socket:", 0) == 0) {
+        auto socketSink = std::make_unique<SocketSink>();
+        const auto status = socketSink->open(sink.substr(7));
+        if (hasError(status)) {
+            reportError("connect the socket sink", sink.substr(7) + ": "
+                + ((status == SocketSink::Status::BadParameter) ? "The path is too long." : std::strerror(errno)));
+            return nullptr;
+        }
+        return socketSink;
+    }
+    auto name = sink.substr(4);
+    if (name.empty() || name.front() != '/') {
+        name.insert(0, 1, '/');
+    }
+    auto sharedMemorySink = std::make_unique<SharedMemorySink>();
+    if (hasError(sharedMemorySink->open(name))) {
+        reportError("create the shared memory sink", name + ": " + std::strerror(errno));
+        return nullptr;
+    }
+    return sharedMemorySink;
+}
+
+
+bool Application::handleCoprocess()
+{
+    // The answers of the co-process are JSON lines, so the final status is JSON as well.
+    _outputFormat = OutputFormat::Json;
+    try {
+        fs::create_directories(getStorageDir());
+    } catch (const fs::filesystem_error&) {
+        // ignore any errors from this.
+    }
+    BaselineStore baselineStore;
+    if (hasError(baselineStore.open(getStateJournalFile()))) {
+        return false;
+    }
+    Coprocess coprocess(*_sgp, baselineStore, std::cin, std::cout);
+    coprocess.run();
+    return writeStatusResult("coprocess_stopped");
+}
+
+
+bool Application::handleWarmStart()
+{
+    auto humidityValues = _humidityValues;
+    auto serialResult = SGP30::SerialNumberValueResult::error();
+    {
+        // The bus is only locked while reading from the sensors, not while the journal is locked and loaded.
+        const I2CBus::Transaction transaction(_sgp->getBus());
+        if (hasError(transaction.getStatus())) {
+            return reportError("lock the bus", getStatusMessage(transaction.getStatus()));
+        }
+        if (!humidityValues.has_value() && _humiditySensor != nullptr) {
+            const auto humidityResult = _humiditySensor->readTemperatureAndHumidity();
+            if (hasError(humidityResult)) {
+                return reportError("read the humidity sensor", getStatusMessage(humidityResult));
+            }
+            humidityValues = humidityResult.getValue();
+        }
+        serialResult = _sgp->readSerialNumberValue();
+    }
+    if (hasError(serialResult)) {
+        return reportError("read the serial number", getStatusMessage(serialResult));
+    }
+    std::optional<SGP30::BaselineValues> baselineValues;
+    BaselineStore baselineStore;
+    if (isSuccessful(baselineStore.open(getStateJournalFile()))) {
+        const auto baselineResult = baselineStore.findRestorable(serialResult.getValue());
+        if (isSuccessful(baselineResult)) {
+            baselineValues = baselineResult.getValue();
+        } else if (_debuggingEnabled) {
+            std::cout << "# Found no baseline which can be restored." << std::endl;
+        }
+        baselineStore.close();
+    }
+    const auto warmStartResult = _sgp->warmStart(baselineValues, humidityValues);
+    if (hasError(warmStartResult)) {
+        return reportError("initialize the measurements", getStatusMessage(warmStartResult));
+    }
+    const char *baselineSource;
+    switch (warmStartResult.getValue()) {
+    case SGP30::BaselineSource::IAQBaseline: baselineSource = "iaq_baseline"; break;
+    case SGP30::BaselineSource::TVOCInceptiveBaseline: baselineSource = "tvoc_inceptive_baseline"; break;
+    default: baselineSource = "none"; break;
+    }
+    if (_outputFormat != OutputFormat::Json) {
+        return writeStatusResult("warm_start_success");
     }
+    const auto validAt = std::chrono::duration_cast<std::chrono::seconds>(
+        (std::chrono::system_clock::now() + SGP30::cInitializationTime).time_since_epoch()).count();
+    std::cout << R"({ "status": "warm_start_success", "baseline_source": ")" << baselineSource
+        << R"(", "humidity_compensation": )" << (humidityValues.has_value() ? "true" : "false")
+        << ", \"valid_after_s\": " << SGP30::cInitializationTime.count()
+        << ", \"valid_at\": " << validAt << " }" << std::endl;
+    return true;
+}
+
+
+bool Application::handleDiscover()
+{
     try {
-        fs::rename(tmpFile, baselineFile);
-    } catch (const fs::filesystem_error &fse) {
-        std::cerr << "Failed to rename the temporary storage file: " << tmpFile.string()
-            << " Error: " << fse.what() << std::endl;
-        return std::string(R"({ "status": "store_failed" })");
+        fs::create_directories(getStorageDir());
+    } catch (const fs::filesystem_error&) {
+        // ignore any errors from this.
+    }
+    BusDiscovery discovery;
+    discovery.setTopologyCacheFile(getTopologyCacheFile());
+    auto muxAddresses = _discoveryMuxAddresses;
+    if (_muxAddress != 0) {
+        muxAddresses.push_back(_muxAddress);
     }
-    return std::string(R"({ "status": "store_successful" })");
+    discovery.setMuxAddresses(muxAddresses);
+    const auto startTime = std::chrono::steady_clock::now();
+    const auto sensors = discovery.discover(!_rescanEnabled);
+    const auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime);
+    std::cout << "{ \"sensors\": ";
+    BusDiscovery::writeJson(std::cout, sensors);
+    std::cout << ", \"from_cache\": " << (discovery.isFromCache() ? "true" : "false")
+        << ", \"elapsed_ms\": " << std::fixed << std::setprecision(1) << elapsed.count() << std::defaultfloat
+        << " }" << std::endl;
+    return true;
 }
 
 
-std::string Application::handleRestoreIAQBaseline()
+SGP30::BaselineResult Application::readStoredIAQBaseline(uint64_t serialNumber)
 {
+    const auto journalFile = getStateJournalFile();
+    if (_debuggingEnabled) {
+        std::cout << "# Open the state journal: " << journalFile.string() << std::endl;
+    }
+    BaselineStore baselineStore;
+    if (isSuccessful(baselineStore.open(journalFile))) {
+        const auto entryResult = baselineStore.find(serialNumber);
+        if (isSuccessful(entryResult)) {
+            const auto entry = entryResult.getValue();
+            return SGP30::BaselineResult::success(std::make_tuple(entry.co2Baseline, entry.tvocBaseline));
+        }
+    }
+    // Fall back to the text file written by previous versions.
     const auto baselineFile = getBaselineFile();
     std::ifstream fs(baselineFile);
     if (_debuggingEnabled) {
         std::cout << "# Open file for read: " << baselineFile.string() << std::endl;
     }
     if (!fs.is_open()) {
-        std::cerr << "Failed to open the storage file: " << baselineFile << std::endl;
-        return std::string(R"({ "status": "restore_failed" })");
+        std::cerr << "Found no stored baseline for this sensor." << std::endl;
+        return SGP30::BaselineResult::error();
     }
     uint16_t a;
     uint16_t b;
     fs >> std::skipws >> a;
     fs >> std::skipws >> b;
-    if (!fs.good()) {
+    if (fs.fail()) {
         std::cerr << "Failed to read the values from the storage file: " << baselineFile << std::endl;
-        return std::string(R"({ "status": "restore_failed" })");
+        return SGP30::BaselineResult::error();
     }
-    if (_debuggingEnabled) {
-        std::cout << "# Read the baseline values 0x"
-                << std::hex << std::setw(4) << std::setfill('0')
-                << a << " and 0x" << b << " from the file." << std::endl;
-    }
-    if (hasError(_sgp->setIAQBaseline(std::make_tuple(a, b)))) {
-        std::cerr << "Failed to set the baseline values." << std::endl;
-        return std::string(R"({ "status": "restore_failed" })");
-    }
-    return std::string(R"({ "status": "restore_failed" })");
+    return SGP30::BaselineResult::success(std::make_tuple(a, b));
 }
 
 
@@ -311,5 +935,34 @@ fs::path Application::getBaselineFile()
 }
 
 
+fs::path Application::getStateJournalFile()
+{
+    auto result = getStorageDir();
+    result.append("state.journal");
+    return result;
+}
+
+
+fs::path Application::getTopologyCacheFile()
+{
+    auto result = getStorageDir();
+    result.append("topology.cache");
+    return result;
+}
+
+
+fs::path Application::getMeasurementCacheFile() const
+{
+    auto result = getStorageDir();
+    if (_muxAddress != 0) {
+        result.append("measurement-" + std::to_string(_bus) + "-" + std::to_string(_muxAddress)
+            + "-" + std::to_string(_muxChannel) + ".cache");
+    } else {
+        result.append("measurement-" + std::to_string(_bus) + ".cache");
+    }
+    return result;
+}
+
+
 }
 
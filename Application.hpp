@@ -19,8 +19,19 @@
 
 
 #include "SGP30.hpp"
+#include "BusLock.hpp"
+#include "BusTrace.hpp"
+#include "MeasurementCache.hpp"
+#include "MeasurementFormat.hpp"
+#include "OutputPipeline.hpp"
+#include "PerfCounters.hpp"
+#include "BaselineStore.hpp"
+#include "HumiditySensor.hpp"
+#include "RecoveryEngine.hpp"
 
 #include <iostream>
+#include <memory>
+#include <optional>
 #include <string>
 #include <filesystem>
 #include <vector>
@@ -45,11 +56,15 @@ private:
         SoftReset,
         StoreIAQBaseline,
         RestoreIAQBaseline,
+        SampleContinuously,
+        WarmStart,
+        Discover,
+        Coprocess,
     };
 
     /// The action handler.
     ///
-    using ActionHandler = std::string (Application::*)();
+    using ActionHandler = bool (Application::*)();
 
     /// Action definitions.
     ///
@@ -64,6 +79,14 @@ private:
     ///
     using ActionDefinitionList = std::vector<ActionDefinition>;
 
+    /// The type of the companion humidity sensor.
+    ///
+    enum class HumiditySensorType {
+        None,
+        SHT3x,
+        SHT4x,
+    };
+
     /// The argument parser status.
     ///
     enum class ParsingStatus {
@@ -98,47 +121,113 @@ private:
     ///
     ParsingStatus parseCommandLine(int argc, char *argv[]);
 
+    /// Write the error of a failed call to `std::cerr`.
+    ///
+    /// @param action The failed action, like "read the measurements".
+    /// @param message The message for the status of the call.
+    /// @return Always `false`, to return it from the handler.
+    ///
+    static bool reportError(const char *action, const std::string &message);
+
+    /// Create and open a sink for the output pipeline.
+    ///
+    /// @param sink The sink argument, like "file:/var/log/sgp30.jsonl".
+    /// @return The opened sink, or `nullptr` after reporting an error.
+    ///
+    static std::unique_ptr<OutputSink> createOutputSink(const std::string &sink);
+
+    /// Write a status result in the selected output format to `std::cout`.
+    ///
+    /// @param status The status, like "init_success".
+    /// @return Always `true`, to return it from the handler.
+    ///
+    bool writeStatusResult(const char *status) const;
+
+    /// Write a measurement result in the selected output format to `std::cout`.
+    ///
+    bool writeMeasurementResult(const MeasurementRecord &record) const;
+
+    /// Write a serial number result in the selected output format to `std::cout`.
+    ///
+    bool writeSerialNumberResult(uint64_t serialNumber) const;
+
+    /// Write a binary record as result to `std::cout`, without a line break.
+    ///
+    bool writeBinaryResult(const BinaryRecordWriter &writer) const;
+
+    /// Write the bus lock statistics as JSON to `std::cerr`.
+    ///
+    void writeBusLockStatistics();
+
+    /// Write the bus and command statistics as JSON to `std::cerr`.
+    ///
+    void writeStatistics();
+
     /// Handle the initialize measurement action.
     ///
-    /// @return The JSON data to display, or empty string on any error.
+    /// @return `true` if the result was written, `false` on any error.
     ///
-    std::string handleInitializeMeasurements();
+    bool handleInitializeMeasurements();
 
     /// Handle the read measurement action.
     ///
-    /// @return The JSON data to display, or empty string on any error.
+    /// @return `true` if the result was written, `false` on any error.
     ///
-    std::string handleReadMeasurements();
+    bool handleReadMeasurements();
 
     /// Handle the measurement test action.
     ///
-    /// @return The JSON data to display, or empty string on any error.
+    /// @return `true` if the result was written, `false` on any error.
     ///
-    std::string handleMeasurementTest();
+    bool handleMeasurementTest();
 
     /// Handle the read serial number action.
     ///
-    /// @return The JSON data to display, or empty string on any error.
+    /// @return `true` if the result was written, `false` on any error.
     ///
-    std::string handleReadSerialNumber();
+    bool handleReadSerialNumber();
 
     /// Handle the soft reset action.
     ///
-    /// @return The JSON data to display, or empty string on any error.
+    /// @return `true` if the result was written, `false` on any error.
     ///
-    std::string handleSoftReset();
+    bool handleSoftReset();
 
     /// Handle the store iAQ baseline action.
     ///
-    /// @return The JSON data to display, or empty string on any error.
+    /// @return `true` if the result was written, `false` on any error.
     ///
-    std::string handleStoreIAQBaseline();
+    bool handleStoreIAQBaseline();
 
     /// Handle the restore iAQ baseline action.
     ///
-    /// @return The JSON data to display, or empty string on any error.
+    /// @return `true` if the result was written, `false` on any error.
     ///
-    std::string handleRestoreIAQBaseline();
+    bool handleRestoreIAQBaseline();
+
+    /// Handle the continuous sampling action.
+    ///
+    /// @return `true` if the result was written, `false` on any error.
+    ///
+    bool handleSampleContinuously();
+
+    /// Handle the warm start action.
+    ///
+    /// @return `true` if the result was written, `false` on any error.
+    ///
+    bool handleWarmStart();
+
+    /// Handle the discovery action.
+    ///
+    /// @return `true` if the result was written, `false` on any error.
+    ///
+    bool handleDiscover();
+
+    /// Handle the co-process action.
+    ///
+    /// @return `true` if the result was written, `false` on any error.
+    ///
+    bool handleCoprocess();
 
     /// Get the directory to store sensor data.
     ///
@@ -146,18 +235,90 @@ private:
     ///
     static std::filesystem::path getStorageDir();
 
-    /// Get the path to the baseline file.
+    /// Read the stored iAQ baseline for a sensor.
+    ///
+    /// Looks up the latest baseline in the baseline store, or falls back to
+    /// the baseline file written by previous versions.
+    ///
+    /// @param serialNumber The serial number of the sensor.
+    /// @return The stored baseline values.
+    ///
+    SGP30::BaselineResult readStoredIAQBaseline(uint64_t serialNumber);
+
+    /// Get the path to the baseline file written by previous versions.
     ///
     /// @return The path to the baseline storage file.
     ///
     static std::filesystem::path getBaselineFile();
 
+    /// Get the path to the state journal.
+    ///
+    /// @return The path to the state journal file.
+    ///
+    static std::filesystem::path getStateJournalFile();
+
+    /// Get the path to the topology cache of the discovery.
+    ///
+    /// @return The path to the topology cache file.
+    ///
+    static std::filesystem::path getTopologyCacheFile();
+
+    /// Get the path to the measurement cache file for the selected bus and multiplexer channel.
+    ///
+    /// @return The path to the measurement cache file.
+    ///
+    std::filesystem::path getMeasurementCacheFile() const;
+
+    /// Write the performance counter values of an action as JSON line.
+    ///
+    /// The line is written to `std::cout`, or to `std::cerr` with a binary output format.
+    ///
+    /// @param action The command of the action.
+    /// @param values The counted values.
+    ///
+    void writePerfValues(const std::string &action, const PerfCounters::Values &values) const;
+
+    /// Try to answer the read measurement action from the measurement cache.
+    ///
+    /// @return `true` if a cached measurement was written.
+    ///
+    bool readMeasurementsFromCache();
+
 private:
     static ActionDefinitionList _actionDefinitions; ///< Action definitions.
     bool _debuggingEnabled; ///< If debugging shall be enabled.
     Action _action; ///< The requested _action.
     int _bus; ///< The I2C bus to use.
+    uint8_t _muxAddress; ///< The address of the multiplexer, zero if not used.
+    uint8_t _muxChannel; ///< The channel of the multiplexer.
+    std::vector<uint8_t> _discoveryMuxAddresses; ///< The multiplexer addresses probed by the discovery.
+    bool _rescanEnabled; ///< If the discovery shall ignore the topology cache.
+    BusLock::Policy _busLockPolicy; ///< The policy to wait for the bus lock.
+    std::chrono::milliseconds _busLockTimeout; ///< The maximum time to wait for the bus lock.
+    bool _busLockStatisticsEnabled; ///< If the bus lock statistics shall be written.
+    bool _statisticsEnabled; ///< If the bus and command statistics shall be written.
+    bool _perfEnabled; ///< If the performance counters shall be written.
+    bool _lowPowerEnabled; ///< If the sampling shall use the low-power mode.
+    bool _processingThreadEnabled; ///< If the samples shall be written by a separate thread.
+    bool _rawSignalsEnabled; ///< If the sampling shall read the raw signals.
+    OutputFormat _outputFormat; ///< The format of the results and samples.
+    std::vector<std::string> _outputSinks; ///< The sinks for the output pipeline of the sampling, empty if not used.
+    OutputPipeline::Policy _outputSinkPolicy; ///< The policy of the output pipeline if its queue is full.
+    PerfCounters _perfCounters; ///< The performance counters.
+    std::optional<SGP30::HumidityValues> _humidityValues; ///< The humidity values for the compensation.
+    HumiditySensorType _humiditySensorType; ///< The type of the companion humidity sensor.
+    std::chrono::seconds _humidityInterval; ///< The interval to update the humidity compensation.
+    std::string _humidityFeedSource; ///< The source of the external humidity feed, empty if not used.
+    std::chrono::milliseconds _cacheMaximumAge; ///< The maximum age of cached measurements, zero to disable the cache.
+    MeasurementCache _measurementCache; ///< The measurement cache.
+    std::string _traceRecordPath; ///< The path to record a bus trace, empty if not used.
+    std::string _traceReplayPath; ///< The path of a bus trace to replay, empty if not used.
+    double _traceReplaySpeed; ///< The speed factor for the replay.
+    BusTraceRecorder _traceRecorder; ///< The bus trace recorder.
+    BusTraceReplayer _traceReplayer; ///< The bus trace replayer.
+    RecoveryEngine::Policy _recoveryPolicy; ///< The policy to recover from failed readings.
     lr::SGP30 *_sgp; ///< The sgp object used by all handler methods.
+    lr::HumiditySensor *_humiditySensor; ///< The optional humidity sensor on the same bus.
 };
 
 
@@ -0,0 +1,108 @@
+//
+// (c)2020 by Lucky Resistor. See LICENSE for details.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+#include "BaselineStore.hpp"
+
+
+#include <chrono>
+#include <limits>
+
+
+namespace lr {
+
+
+BaselineStore::BaselineStore()
+    : _journal(), _index(), _timeSource(&getRealTimeSource())
+{
+}
+
+
+BaselineStore::Status BaselineStore::open(const std::filesystem::path &path)
+{
+    _index.clear();
+    if (hasError(_journal.open(path))) {
+        return Status::Error;
+    }
+    // Syncs are done explicitly, after the values of all sensors are stored.
+    _journal.setSyncInterval(std::numeric_limits<uint32_t>::max());
+    for (const auto &entry : _journal.getEntries()) {
+        _index[entry.serialNumber] = entry;
+    }
+    return Status::Success;
+}
+
+
+void BaselineStore::setTimeSource(TimeSource *timeSource)
+{
+    _timeSource = (timeSource != nullptr) ? timeSource : &getRealTimeSource();
+}
+
+
+void BaselineStore::close()
+{
+    _journal.close();
+    _index.clear();
+}
+
+
+BaselineStore::EntryResult BaselineStore::find(uint64_t serialNumber) const
+{
+    const auto it = _index.find(serialNumber);
+    if (it == _index.end()) {
+        return EntryResult::error();
+    }
+    return EntryResult::success(it->second);
+}
+
+
+SGP30::BaselineResult BaselineStore::findRestorable(uint64_t serialNumber) const
+{
+    const auto entryResult = find(serialNumber);
+    if (hasError(entryResult)) {
+        return SGP30::BaselineResult::error();
+    }
+    const auto entry = entryResult.getValue();
+    const auto storedTime = std::chrono::system_clock::time_point(std::chrono::seconds(entry.timestamp));
+    if (_timeSource->getSystemTime() - storedTime > cMaximumBaselineAge) {
+        return SGP30::BaselineResult::error();
+    }
+    return SGP30::BaselineResult::success(std::make_tuple(entry.co2Baseline, entry.tvocBaseline));
+}
+
+
+BaselineStore::Status BaselineStore::store(uint64_t serialNumber, const SGP30::BaselineValues &baselineValues)
+{
+    const auto timestamp = std::chrono::duration_cast<std::chrono::seconds>(
+        _timeSource->getSystemTime().time_since_epoch()).count();
+    const auto entry = StateJournal::Entry{
+        serialNumber, timestamp, std::get<0>(baselineValues), std::get<1>(baselineValues)};
+    if (hasError(_journal.append(entry))) {
+        return Status::Error;
+    }
+    _index[serialNumber] = entry;
+    return Status::Success;
+}
+
+
+BaselineStore::Status BaselineStore::sync()
+{
+    return _journal.sync();
+}
+
+
+}
+
@@ -0,0 +1,116 @@
+#pragma once
+//
+// (c)2020 by Lucky Resistor. See LICENSE for details.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+
+
+#include "SGP30.hpp"
+#include "StateJournal.hpp"
+#include "TimeSource.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <unordered_map>
+
+
+namespace lr {
+
+
+/// The stored baseline values of all sensors, indexed by the serial number.
+///
+/// The index is built once from the state journal when the store is opened. Lookups
+/// are answered from memory, and new values are appended to the journal.
+///
+class BaselineStore
+{
+public:
+    using Status = CallStatus;
+
+    /// The result of a lookup.
+    ///
+    using EntryResult = StateJournal::EntryResult;
+
+    /// The maximum age of a baseline which can be restored.
+    ///
+    static constexpr auto cMaximumBaselineAge = std::chrono::hours(7 * 24);
+
+public:
+    /// ctor
+    ///
+    BaselineStore();
+
+public:
+    /// Open the state journal and build the index.
+    ///
+    /// @param path The path to the state journal.
+    /// @return The call status.
+    ///
+    Status open(const std::filesystem::path &path);
+
+    /// Set the source of time for the time stamps of the stored values.
+    ///
+    /// @param timeSource The time source, or `nullptr` for the real time.
+    ///
+    void setTimeSource(TimeSource *timeSource);
+
+    /// Sync and close the state journal.
+    ///
+    void close();
+
+    /// Find the latest baseline for a sensor.
+    ///
+    /// @param serialNumber The serial number of the sensor.
+    /// @return The latest entry, or an error if there is no baseline for this sensor.
+    ///
+    EntryResult find(uint64_t serialNumber) const;
+
+    /// Find the latest baseline for a sensor, which can be restored.
+    ///
+    /// The datasheet does not allow to restore a baseline which is older than one week.
+    ///
+    /// @param serialNumber The serial number of the sensor.
+    /// @return The baseline values, or an error if there is no usable baseline for this sensor.
+    ///
+    SGP30::BaselineResult findRestorable(uint64_t serialNumber) const;
+
+    /// Store a new baseline for a sensor.
+    ///
+    /// The value is appended to the journal, but not synced. Call `sync()` after storing
+    /// the values of all sensors.
+    ///
+    /// @param serialNumber The serial number of the sensor.
+    /// @param baselineValues The baseline values.
+    /// @return The call status.
+    ///
+    Status store(uint64_t serialNumber, const SGP30::BaselineValues &baselineValues);
+
+    /// Sync all stored values to the disk.
+    ///
+    /// @return The call status.
+    ///
+    Status sync();
+
+private:
+    StateJournal _journal; ///< The journal with the persistent values.
+    std::unordered_map<uint64_t, StateJournal::Entry> _index; ///< The latest entry for each sensor.
+    TimeSource *_timeSource; ///< The source of time for the time stamps.
+};
+
+
+}
+
@@ -0,0 +1,845 @@
+//
+// (c)2020 by Lucky Resistor. See LICENSE for details.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+
+
+#include "AbsoluteHumidity.hpp"
+#include "BaselineStore.hpp"
+#include "I2CBus.hpp"
+#include "MeasurementFormat.hpp"
+#include "OutputPipeline.hpp"
+#include "RecoveryEngine.hpp"
+#include "SampleRecord.hpp"
+#include "Sampler.hpp"
+#include "SGP30Model.hpp"
+#include "SGP30.hpp"
+#include "SimulatedBus.hpp"
+#include "TimeSource.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+/// @file Benchmark.cpp
+/// Benchmarks for the performance critical code paths of the tool.
+///
+/// Each benchmark writes one JSON line with the results to `std::cout`, with the time
+/// and the number of heap allocations per operation. The program returns a non zero
+/// exit code if a check fails.
+///
+
+
+namespace {
+
+/// The number of heap allocations, counted by the replaced `operator new` variants.
+std::atomic<uint64_t> gAllocationCount = 0;
+
+/// Allocate counted memory for all replaced `operator new` variants.
+///
+void *allocateCounted(std::size_t size, std::size_t alignment = 0)
+{
+    gAllocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (size == 0) {
+        size = 1;
+    }
+    void *memory;
+    if (alignment > alignof(std::max_align_t)) {
+        // `aligned_alloc()` requires a size which is a multiple of the alignment.
+        memory = std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+    } else {
+        memory = std::malloc(size);
+    }
+    if (memory == nullptr) {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+/// Free memory for all replaced `operator delete` variants.
+///
+void deallocateCounted(void *memory) noexcept
+{
+    std::free(memory);
+}
+
+}
+
+
+void *operator new(std::size_t size)
+{
+    return allocateCounted(size);
+}
+
+
+void *operator new[](std::size_t size)
+{
+    return allocateCounted(size);
+}
+
+
+void *operator new(std::size_t size, std::align_val_t alignment)
+{
+    return allocateCounted(size, static_cast<std::size_t>(alignment));
+}
+
+
+void *operator new[](std::size_t size, std::align_val_t alignment)
+{
+    return allocateCounted(size, static_cast<std::size_t>(alignment));
+}
+
+
+void operator delete(void *memory) noexcept
+{
+    deallocateCounted(memory);
+}
+
+
+void operator delete[](void *memory) noexcept
+{
+    deallocateCounted(memory);
+}
+
+
+void operator delete(void *memory, std::size_t) noexcept
+{
+    deallocateCounted(memory);
+}
+
+
+void operator delete[](void *memory, std::size_t) noexcept
+{
+    deallocateCounted(memory);
+}
+
+
+void operator delete(void *memory, std::align_val_t) noexcept
+{
+    deallocateCounted(memory);
+}
+
+
+void operator delete[](void *memory, std::align_val_t) noexcept
+{
+    deallocateCounted(memory);
+}
+
+
+void operator delete(void *memory, std::size_t, std::align_val_t) noexcept
+{
+    deallocateCounted(memory);
+}
+
+
+void operator delete[](void *memory, std::size_t, std::align_val_t) noexcept
+{
+    deallocateCounted(memory);
+}
+
+
+namespace {
+
+
+using Clock = std::chrono::steady_clock;
+
+
+/// A sink for benchmark results, so the compiler can not remove the benchmarked code.
+volatile uint64_t gSink = 0;
+
+/// The output for the results, which is independent of redirections of `std::cout`.
+std::ostream gOutput(std::cout.rdbuf());
+
+
+/// A stream buffer which discards all output.
+///
+class NullBuffer : public std::streambuf
+{
+protected:
+    int overflow(int c) override { return c; }
+    std::streamsize xsputn(const char*, std::streamsize count) override { return count; }
+};
+
+
+/// Run a benchmark and write the result as JSON line.
+///
+/// @param name The name of the benchmark.
+/// @param iterations The number of iterations.
+/// @param function The benchmarked function, called with the iteration index.
+///
+template<typename Function>
+void runBenchmark(const char *name, uint64_t iterations, Function function)
+{
+    uint64_t sum = 0;
+    for (uint64_t i = 0; i < iterations / 10; ++i) { // warm up
+        sum += function(i);
+    }
+    const auto startAllocationCount = gAllocationCount.load(std::memory_order_relaxed);
+    const auto startTime = Clock::now();
+    for (uint64_t i = 0; i < iterations; ++i) {
+        sum += function(i);
+    }
+    const auto elapsed = std::chrono::duration<double, std::nano>(Clock::now() - startTime).count();
+    const auto allocationCount = gAllocationCount.load(std::memory_order_relaxed) - startAllocationCount;
+    gSink = gSink + sum;
+    gOutput << R"({ "benchmark": ")" << name << R"(", "iterations": )" << iterations
+        << ", \"ns_per_op\": " << std::fixed << std::setprecision(3) << (elapsed / static_cast<double>(iterations))
+        << ", \"allocs_per_op\": " << (static_cast<double>(allocationCount) / static_cast<double>(iterations))
+        << std::defaultfloat << " }" << std::endl;
+}
+
+
+/// Compare the fixed-point absolute humidity with the double precision formula.
+///
+/// @return `true` if all values are within one LSB.
+///
+bool checkAbsoluteHumidityAccuracy()
+{
+    int maximumError = 0;
+    uint64_t differentValues = 0;
+    uint64_t checkedValues = 0;
+    for (int32_t temperature = -100000; temperature <= 100000; temperature += 10) {
+        for (int32_t humidity = 0; humidity <= 100000; humidity += 100) {
+            const int fixedPoint = lr::getAbsoluteHumidity(temperature, humidity);
+            const int reference = lr::calculateAbsoluteHumidity(temperature / 1000.0, humidity / 1000.0);
+            const int error = std::abs(fixedPoint - reference);
+            if (error != 0) {
+                differentValues += 1;
+                maximumError = std::max(maximumError, error);
+            }
+            checkedValues += 1;
+        }
+    }
+    const bool success = (maximumError <= 1);
+    gOutput << R"({ "check": "absolute_humidity_accuracy", "values": )" << checkedValues
+        << ", \"different_values\": " << differentValues
+        << ", \"max_error_lsb\": " << maximumError
+        << ", \"success\": " << (success ? "true" : "false") << " }" << std::endl;
+    return success;
+}
+
+
+/// Benchmark the absolute humidity calculations.
+///
+void benchmarkAbsoluteHumidity()
+{
+    constexpr std::size_t cInputCount = 1024;
+    std::mt19937 random(1);
+    std::uniform_int_distribution<int32_t> temperatureDistribution(-100000, 100000);
+    std::uniform_int_distribution<int32_t> humidityDistribution(0, 100000);
+    std::vector<int32_t> temperatures(cInputCount);
+    std::vector<int32_t> humidities(cInputCount);
+    std::vector<double> temperaturesDouble(cInputCount);
+    std::vector<double> humiditiesDouble(cInputCount);
+    for (std::size_t i = 0; i < cInputCount; ++i) {
+        temperatures[i] = temperatureDistribution(random);
+        humidities[i] = humidityDistribution(random);
+        temperaturesDouble[i] = temperatures[i] / 1000.0;
+        humiditiesDouble[i] = humidities[i] / 1000.0;
+    }
+    constexpr uint64_t cIterations = 10000000;
+    runBenchmark("absolute_humidity_double", cIterations, [&](uint64_t i) -> uint64_t {
+        const auto index = i % cInputCount;
+        return lr::calculateAbsoluteHumidity(temperaturesDouble[index], humiditiesDouble[index]);
+    });
+    runBenchmark("absolute_humidity_fixed_point", cIterations, [&](uint64_t i) -> uint64_t {
+        const auto index = i % cInputCount;
+        return lr::getAbsoluteHumidity(temperatures[index], humidities[index]);
+    });
+}
+
+
+/// Benchmark the CRC and the encoding and decoding of the values sent over the bus.
+///
+void benchmarkProtocol()
+{
+    constexpr std::size_t cValueCount = 1024;
+    std::mt19937 random(1);
+    std::uniform_int_distribution<uint16_t> valueDistribution;
+    std::vector<uint16_t> values(cValueCount);
+    std::vector<uint8_t> frames(cValueCount * 3);
+    for (std::size_t i = 0; i < cValueCount; ++i) {
+        values[i] = valueDistribution(random);
+        lr::SensirionSensor::encodeValue(values[i], &frames[i * 3]);
+    }
+    constexpr uint64_t cIterations = 10000000;
+    runBenchmark("crc8", cIterations, [&](uint64_t i) -> uint64_t {
+        return lr::SensirionSensor::getCrc8(&frames[(i % cValueCount) * 3], 2);
+    });
+    runBenchmark("frame_encode", cIterations, [&](uint64_t i) -> uint64_t {
+        uint8_t frame[3];
+        lr::SensirionSensor::encodeValue(values[i % cValueCount], frame);
+        return frame[2];
+    });
+    runBenchmark("frame_decode", cIterations, [&](uint64_t i) -> uint64_t {
+        return lr::SensirionSensor::decodeValue(&frames[(i % cValueCount) * 3], 1).getValue();
+    });
+}
+
+
+/// Benchmark the JSON output of the measurements.
+///
+/// The stream variant is used by the continuous sampling, the string variant by the single
+/// read of the measurements.
+///
+void benchmarkFormatting()
+{
+    constexpr uint64_t cIterations = 1000000;
+    const lr::MeasurementRecord record{412, 27, 0x0000012345abu, std::make_tuple(21.5, 45.25)};
+    NullBuffer nullBuffer;
+    std::ostream nullOutput(&nullBuffer);
+    runBenchmark("format_json_stream", cIterations, [&](uint64_t i) -> uint64_t {
+        writeMeasurementJson(nullOutput, record);
+        nullOutput << '\n';
+        return i;
+    });
+    runBenchmark("format_json_string", cIterations, [&](uint64_t) -> uint64_t {
+        std::stringstream result;
+        writeMeasurementJson(result, lr::MeasurementRecord{record.co2, record.tvoc});
+        return result.str().size();
+    });
+    lr::BinaryRecordWriter cborWriter(lr::OutputFormat::Cbor);
+    runBenchmark("format_cbor_stream", cIterations, [&](uint64_t) -> uint64_t {
+        cborWriter.writeMeasurement(record);
+        cborWriter.writeTo(nullOutput);
+        return cborWriter.getSize();
+    });
+    lr::BinaryRecordWriter messagePackWriter(lr::OutputFormat::MessagePack);
+    runBenchmark("format_msgpack_stream", cIterations, [&](uint64_t) -> uint64_t {
+        messagePackWriter.writeMeasurement(record);
+        messagePackWriter.writeTo(nullOutput);
+        return messagePackWriter.getSize();
+    });
+}
+
+
+/// Benchmark complete sensor commands on the simulated bus.
+///
+/// The simulated bus answers immediately, so the waits for the results are skipped and
+/// only the processing of the commands is measured.
+///
+void benchmarkSimulatedSensor()
+{
+    lr::SimulatedBus simulatedBus;
+    lr::SGP30 sgp(0);
+    sgp.getBus()->setBackend(&simulatedBus);
+    if (hasError(sgp.openBus()) || hasError(sgp.initializeMeasurements())) {
+        return;
+    }
+    constexpr uint64_t cIterations = 1000000;
+    runBenchmark("read_measurements_simulated", cIterations, [&](uint64_t) -> uint64_t {
+        return std::get<0>(sgp.readMeasurements().getValue());
+    });
+    runBenchmark("set_humidity_compensation_simulated", cIterations, [&](uint64_t i) -> uint64_t {
+        const auto temperature = static_cast<double>(i % 50);
+        const auto humidity = static_cast<double>(i % 100);
+        return static_cast<uint64_t>(sgp.setHumidityCompensation(temperature, humidity));
+    });
+    sgp.closeBus();
+}
+
+
+/// Benchmark the sample queue on its own, with push and pop in the same thread.
+///
+void benchmarkSampleQueue()
+{
+    auto queue = std::make_unique<lr::SampleQueue>();
+    lr::SampleRecord record{};
+    runBenchmark("sample_queue_push_pop", 10000000, [&](uint64_t i) -> uint64_t {
+        record.co2 = static_cast<uint16_t>(i);
+        queue->tryPush(record);
+        queue->tryPop(record);
+        return record.co2;
+    });
+}
+
+
+/// Pass samples through the sample queue from a producer to a consumer thread.
+///
+/// Without an interval, the producer adds the samples as fast as possible, which measures the
+/// throughput, and the latency includes the time in the full queue. With an interval, the
+/// latency from adding to removing a sample is measured. Load threads compete with both
+/// threads for the CPUs.
+///
+/// @param name The name of the benchmark.
+/// @param sampleCount The number of samples.
+/// @param interval The interval between two samples, or zero.
+/// @param loadThreadCount The number of load threads.
+///
+void benchmarkSampleQueueThreads(const char *name, uint64_t sampleCount, std::chrono::microseconds interval,
+    unsigned loadThreadCount)
+{
+    auto queue = std::make_unique<lr::SampleQueue>();
+    std::atomic<bool> isLoadRunning(true);
+    std::vector<std::thread> loadThreads;
+    for (unsigned i = 0; i < loadThreadCount; ++i) {
+        loadThreads.emplace_back([&isLoadRunning]() {
+            uint64_t value = 1;
+            while (isLoadRunning.load(std::memory_order_relaxed)) {
+                value = value * 6364136223846793005u + 1442695040888963407u;
+            }
+            gSink = gSink + value;
+        });
+    }
+    lr::LatencyHistogram latency;
+    const auto startTime = Clock::now();
+    std::thread consumer([&]() {
+        lr::SampleRecord record;
+        for (uint64_t received = 0; received < sampleCount;) {
+            if (queue->tryPop(record)) {
+                latency.record(Clock::now().time_since_epoch() - std::chrono::nanoseconds(record.timestamp));
+                received += 1;
+            } else {
+                std::this_thread::yield();
+            }
+        }
+    });
+    lr::SampleRecord record{};
+    auto nextSample = Clock::now();
+    for (uint64_t i = 0; i < sampleCount; ++i) {
+        if (interval.count() > 0) {
+            nextSample += interval;
+            while (Clock::now() < nextSample) {
+                std::this_thread::yield();
+            }
+        }
+        record.co2 = static_cast<uint16_t>(i);
+        record.timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+        while (!queue->tryPush(record)) {
+            std::this_thread::yield();
+        }
+    }
+    consumer.join();
+    const auto elapsed = std::chrono::duration<double, std::nano>(Clock::now() - startTime).count();
+    isLoadRunning = false;
+    for (auto &thread : loadThreads) {
+        thread.join();
+    }
+    gOutput << R"({ "benchmark": ")" << name << R"(", "samples": )" << sampleCount
+        << ", \"interval_us\": " << interval.count()
+        << ", \"load_threads\": " << loadThreadCount
+        << ", \"ns_per_sample\": " << std::fixed << std::setprecision(3) << (elapsed / static_cast<double>(sampleCount))
+        << std::defaultfloat << ", \"latency\": ";
+    latency.writeJson(gOutput);
+    gOutput << " }" << std::endl;
+}
+
+
+/// A sink which takes a fixed time for each batch, to simulate a slow consumer.
+///
+class SlowSink : public lr::OutputSink
+{
+public:
+    explicit SlowSink(std::atomic<uint64_t> &partialCount) : _partialCount(partialCount) {}
+
+    Status write(iovec *vectors, int count) override {
+        for (int i = 0; i < count; ++i) {
+            const auto *data = static_cast<const char*>(vectors[i].iov_base);
+            const auto size = vectors[i].iov_len;
+            if (size == 0 || data[0] != '{' || data[size - 1] != '\n') {
+                _partialCount.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        return Status::Success;
+    }
+
+private:
+    std::atomic<uint64_t> &_partialCount; ///< The number of records which were not complete.
+};
+
+
+/// Benchmark the output pipeline, from the stream of the sampling thread to a sink.
+///
+/// Each record is committed separately, and the stream is flushed every ten records, as by
+/// the low-power sampling.
+///
+void benchmarkOutputPipeline()
+{
+    lr::OutputPipeline pipeline;
+    auto sink = std::make_unique<lr::FileSink>();
+    if (hasError(sink->open("/dev/null"))) {
+        return;
+    }
+    pipeline.addSink(std::move(sink));
+    if (hasError(pipeline.start())) {
+        return;
+    }
+    const lr::MeasurementRecord record{412, 27, 0x0000012345abu, std::make_tuple(21.5, 45.25)};
+    auto &output = pipeline.getStream();
+    runBenchmark("output_pipeline_commit", 1000000, [&](uint64_t i) -> uint64_t {
+        writeMeasurementJson(output, record);
+        output << '\n';
+        pipeline.commitRecord();
+        if (i % 10 == 0) {
+            output.flush();
+        }
+        return i;
+    });
+    pipeline.stop();
+}
+
+
+/// Write records into a pipeline with a slow sink, and measure how long the writer is stalled.
+///
+/// @param policy The policy of the pipeline.
+/// @param policyName The name of the policy for the output.
+/// @param recordCount The number of records to write.
+/// @param paddingSize The size of a padding added to every other record, to exceed the record capacity.
+/// @return `true` if no record took longer than the maximum block time, with some tolerance
+///     for the scheduling, and the sink only got complete records.
+///
+bool checkSlowSink(lr::OutputPipeline::Policy policy, const char *policyName, uint64_t recordCount,
+    std::size_t paddingSize = 0)
+{
+    constexpr auto cTolerance = std::chrono::milliseconds(20);
+    const std::string padding(paddingSize, 'x');
+    std::atomic<uint64_t> partialCount{0};
+    lr::OutputPipeline pipeline;
+    pipeline.addSink(std::make_unique<SlowSink>(partialCount));
+    pipeline.setPolicy(policy);
+    if (hasError(pipeline.start())) {
+        gOutput << R"({ "check": "slow_sink", "success": false })" << std::endl;
+        return false;
+    }
+    auto &output = pipeline.getStream();
+    Clock::duration maximumStall{};
+    for (uint64_t i = 0; i < recordCount; ++i) {
+        const auto startTime = Clock::now();
+        output << R"({ "record": )" << i;
+        if (paddingSize > 0 && i % 2 == 1) {
+            output << R"(, "padding": ")" << padding << '"';
+        }
+        output << " }\n";
+        pipeline.commitRecord();
+        if (i % 10 == 0) {
+            output.flush();
+        }
+        maximumStall = std::max(maximumStall, Clock::now() - startTime);
+    }
+    pipeline.stop();
+    const auto partialRecords = partialCount.load(std::memory_order_relaxed);
+    const bool success = (maximumStall <= lr::OutputPipeline::cMaximumBlockTime + cTolerance) && partialRecords == 0;
+    gOutput << R"({ "check": "slow_sink", "policy": ")" << policyName << R"(", "records": )" << recordCount
+        << ", \"max_stall_us\": " << std::fixed << std::setprecision(3)
+        << std::chrono::duration<double, std::micro>(maximumStall).count()
+        << std::defaultfloat << ", \"partial_records\": " << partialRecords << ", \"output\": ";
+    pipeline.writeStatisticsJson(gOutput);
+    gOutput << ", \"success\": " << (success ? "true" : "false") << " }" << std::endl;
+    return success;
+}
+
+
+/// Run the continuous sampling of a simulated sensor for one day in simulated time.
+///
+/// @return `true` if the sampler took one sample per second without allocations and stored the baselines.
+///
+bool benchmarkSimulatedDay()
+{
+    constexpr auto cRunDuration = std::chrono::hours(24);
+    lr::SimulatedTimeSource timeSource;
+    lr::SimulatedBus simulatedBus;
+    lr::SGP30 sgp(0);
+    sgp.getBus()->setBackend(&simulatedBus);
+    const auto journalPath = std::filesystem::temp_directory_path() / "read_sgp30_bench.journal";
+    std::filesystem::remove(journalPath);
+    lr::BaselineStore baselineStore;
+    baselineStore.setTimeSource(&timeSource);
+    if (hasError(sgp.openBus()) || hasError(baselineStore.open(journalPath))) {
+        gOutput << R"({ "check": "simulated_day", "success": false })" << std::endl;
+        return false;
+    }
+    NullBuffer nullBuffer;
+    std::ostream nullOutput(&nullBuffer);
+    lr::Sampler sampler(baselineStore, nullOutput);
+    sampler.addSensor(&sgp);
+    sampler.setTimeSource(&timeSource);
+    sampler.setRunDuration(cRunDuration);
+    const auto startAllocationCount = gAllocationCount.load(std::memory_order_relaxed);
+    const auto startTime = Clock::now();
+    const auto status = sampler.run();
+    const auto elapsed = std::chrono::duration<double>(Clock::now() - startTime).count();
+    const auto allocationCount = gAllocationCount.load(std::memory_order_relaxed) - startAllocationCount;
+    const auto serialNumber = sgp.readSerialNumberValue().getValue();
+    const bool baselineStored = isSuccessful(baselineStore.find(serialNumber));
+    baselineStore.close();
+    sgp.closeBus();
+    std::filesystem::remove(journalPath);
+    const auto simulatedSeconds = std::chrono::duration<double>(timeSource.getElapsedTime()).count();
+    const auto samples = std::chrono::duration_cast<std::chrono::seconds>(cRunDuration).count();
+    // The setup and the hourly baseline stores allocate, but taking a sample must not.
+    const auto allocationsPerSample = static_cast<double>(allocationCount) / static_cast<double>(samples);
+    const bool success = isSuccessful(status) && baselineStored && simulatedSeconds >= static_cast<double>(samples)
+        && allocationsPerSample < 0.001;
+    gOutput << R"({ "check": "simulated_day", "samples": )" << samples
+        << ", \"simulated_s\": " << std::fixed << std::setprecision(3) << simulatedSeconds
+        << ", \"wall_s\": " << elapsed
+        << ", \"speedup\": " << std::setprecision(0) << (simulatedSeconds / elapsed)
+        << ", \"allocs_per_sample\": " << std::setprecision(3) << allocationsPerSample
+        << std::defaultfloat << ", \"baseline_stored\": " << (baselineStored ? "true" : "false")
+        << ", \"success\": " << (success ? "true" : "false") << " }" << std::endl;
+    return success;
+}
+
+
+/// Compare baseline persistence policies over weeks of simulated operation.
+///
+/// The sensor is modelled with its init phase and the baseline compensation. Every few days,
+/// the power is cut for a while, which loses the baseline of the sensor. The policies differ
+/// in how often the baseline is stored, and if it is restored at all.
+///
+/// @return `true` if storing the baseline improves the accuracy.
+///
+bool benchmarkBaselinePersistence()
+{
+    struct Policy {
+        const char *name; ///< The name of the policy.
+        std::chrono::seconds storeInterval; ///< The interval to store the baseline.
+        bool isRestored; ///< If the stored baseline is kept across restarts.
+    };
+    constexpr auto cSegmentDuration = std::chrono::hours(2 * 24);
+    constexpr auto cPowerOutage = std::chrono::hours(2);
+    constexpr int cSegmentCount = 7;
+    const Policy policies[] = {
+        {"cold_start", std::chrono::hours(1), false},
+        {"store_daily", std::chrono::hours(24), true},
+        {"store_hourly", std::chrono::hours(1), true},
+    };
+    const auto journalPath = std::filesystem::temp_directory_path() / "read_sgp30_bench.journal";
+    double coldStartError = 0.0;
+    double hourlyError = 0.0;
+    bool success = true;
+    for (const auto &policy : policies) {
+        lr::SimulatedTimeSource timeSource;
+        lr::SGP30Model model(timeSource);
+        lr::SimulatedBus simulatedBus;
+        simulatedBus.setModel(&model);
+        lr::SGP30 sgp(0);
+        sgp.getBus()->setBackend(&simulatedBus);
+        std::filesystem::remove(journalPath);
+        if (hasError(sgp.openBus())) {
+            return false;
+        }
+        NullBuffer nullBuffer;
+        std::ostream nullOutput(&nullBuffer);
+        bool segmentsSuccessful = true;
+        const auto startTime = Clock::now();
+        for (int segment = 0; segment < cSegmentCount; ++segment) {
+            if (!policy.isRestored) {
+                std::filesystem::remove(journalPath);
+            }
+            lr::BaselineStore baselineStore;
+            baselineStore.setTimeSource(&timeSource);
+            if (hasError(baselineStore.open(journalPath))) {
+                segmentsSuccessful = false;
+                break;
+            }
+            lr::Sampler sampler(baselineStore, nullOutput);
+            sampler.addSensor(&sgp);
+            sampler.setTimeSource(&timeSource);
+            sampler.setBaselineStoreInterval(policy.storeInterval);
+            sampler.setRunDuration(cSegmentDuration);
+            segmentsSuccessful &= isSuccessful(sampler.run());
+            baselineStore.close();
+            model.reset();
+            timeSource.advance(cPowerOutage);
+        }
+        const auto elapsed = std::chrono::duration<double>(Clock::now() - startTime).count();
+        sgp.closeBus();
+        std::filesystem::remove(journalPath);
+        const auto accuracy = model.getAccuracy();
+        if (!policy.isRestored) {
+            coldStartError = accuracy.co2MeanError;
+        } else if (policy.storeInterval == std::chrono::hours(1)) {
+            hourlyError = accuracy.co2MeanError;
+        }
+        success &= segmentsSuccessful;
+        gOutput << R"({ "check": "baseline_persistence", "policy": ")" << policy.name
+            << R"(", "simulated_days": )" << std::chrono::duration_cast<std::chrono::hours>(timeSource.getElapsedTime()).count() / 24
+            << ", \"restarts\": " << cSegmentCount
+            << ", \"samples\": " << accuracy.measurements
+            << ", \"init_phase_samples\": " << accuracy.initPhaseMeasurements
+            << ", \"co2_mean_error\": " << std::fixed << std::setprecision(1) << accuracy.co2MeanError
+            << ", \"co2_max_error\": " << accuracy.co2MaximumError
+            << ", \"tvoc_mean_error\": " << accuracy.tvocMeanError
+            << ", \"tvoc_max_error\": " << accuracy.tvocMaximumError
+            << ", \"wall_s\": " << std::setprecision(3) << elapsed
+            << std::defaultfloat << ", \"success\": " << (segmentsSuccessful ? "true" : "false") << " }" << std::endl;
+    }
+    return success && hourlyError < coldStartError;
+}
+
+
+/// Benchmark one bus transaction with a debugging policy.
+///
+/// The transfers are replayed from a trace without delays, so only the overhead of the
+/// bus implementation is measured.
+///
+/// @param name The name of the benchmark.
+/// @param tracePath The path to the trace file.
+/// @param iterations The number of iterations.
+/// @param debugging If the debugging output is enabled at runtime.
+///
+template<typename DebugPolicy>
+void benchmarkBusTransaction(const char *name, const std::filesystem::path &tracePath, uint64_t iterations, bool debugging)
+{
+    lr::BusTraceReplayer replayer;
+    if (hasError(replayer.open(tracePath))) {
+        return;
+    }
+    replayer.setSpeed(0.0);
+    lr::BasicI2CBus<DebugPolicy> bus(0x58);
+    bus.setBackend(&replayer);
+    bus.openBus();
+    bus.setDebugging(debugging);
+    NullBuffer nullBuffer;
+    const auto coutBuffer = std::cout.rdbuf(&nullBuffer);
+    runBenchmark(name, iterations, [&](uint64_t) -> uint64_t {
+        const uint8_t command[2] = {0x20, 0x08};
+        uint8_t response[6];
+        bus.writeData(command, sizeof(command));
+        bus.readData(response, sizeof(response));
+        return response[0];
+    });
+    std::cout.rdbuf(coutBuffer);
+    bus.setDebugging(false);
+    bus.closeBus();
+}
+
+
+/// Benchmark the overhead of the bus debugging policies.
+///
+void benchmarkBusDebugPolicy()
+{
+    constexpr uint64_t cIterations = 100000;
+    const auto tracePath = std::filesystem::temp_directory_path() / "read_sgp30_bench.trace";
+    {
+        std::ofstream file(tracePath, std::ios::binary | std::ios::trunc);
+        file.write("LRTRACE1", 8);
+        const lr::BusTrace::Record write{0, 0x58, lr::BusTrace::Direction::Write, 2, 0, 0, {0x20, 0x08}};
+        const lr::BusTrace::Record read{0, 0x58, lr::BusTrace::Direction::Read, 6, 0, 0, {0x01, 0x90, 0x4c, 0x00, 0x00, 0x81}};
+        for (uint64_t i = 0; i < cIterations + cIterations / 10; ++i) { // including the warm up
+            file.write(reinterpret_cast<const char*>(&write), sizeof(write));
+            file.write(reinterpret_cast<const char*>(&read), sizeof(read));
+        }
+    }
+    benchmarkBusTransaction<lr::NoBusDebugging>("bus_transaction_no_debugging", tracePath, cIterations, true);
+    benchmarkBusTransaction<lr::StreamBusDebugging>("bus_transaction_stream_debugging_off", tracePath, cIterations, false);
+    benchmarkBusTransaction<lr::StreamBusDebugging>("bus_transaction_stream_debugging_on", tracePath, cIterations, true);
+    std::filesystem::remove(tracePath);
+}
+
+
+/// Read measurements from a simulated bus with injected faults, using the recovery engine.
+///
+/// Besides random NACKs and CRC errors, a stuck bus and a hanging sensor are injected in
+/// regular intervals, which need to reopen the bus and to reset the sensor.
+///
+/// @return `true` if all readings succeeded.
+///
+bool benchmarkRecovery()
+{
+    constexpr uint64_t cSampleCount = 20000;
+    constexpr uint64_t cStuckInterval = 1000;
+    constexpr uint64_t cHangInterval = 2500;
+    lr::SimulatedBus simulatedBus;
+    simulatedBus.setFaultRates(0.01, 0.01);
+    lr::SGP30 sgp(0);
+    sgp.getBus()->setBackend(&simulatedBus);
+    if (hasError(sgp.openBus()) || hasError(sgp.initializeMeasurements())) {
+        gOutput << R"({ "check": "recovery", "success": false })" << std::endl;
+        return false;
+    }
+    lr::RecoveryEngine recovery;
+    recovery.setPolicy({3, std::chrono::milliseconds(0), std::chrono::milliseconds(0), true, true});
+    uint64_t failedSamples = 0;
+    const auto startTime = Clock::now();
+    for (uint64_t i = 1; i <= cSampleCount; ++i) {
+        if (i % cStuckInterval == 0) {
+            simulatedBus.injectBusStuck();
+        }
+        if (i % cHangInterval == 0) {
+            simulatedBus.injectSensorHang();
+        }
+        const auto status = recovery.run(sgp.getBus(), [&]() -> lr::CallStatus {
+            return sgp.readMeasurements().getStatus();
+        }, [&]() -> lr::CallStatus {
+            if (const auto status = sgp.softReset(); hasError(status)) {
+                return status;
+            }
+            return sgp.initializeMeasurements();
+        });
+        if (hasError(status)) {
+            failedSamples += 1;
+        }
+    }
+    const auto elapsed = std::chrono::duration<double, std::micro>(Clock::now() - startTime).count();
+    sgp.closeBus();
+    const bool success = (failedSamples == 0);
+    gOutput << R"({ "check": "recovery", "samples": )" << cSampleCount
+        << ", \"failed_samples\": " << failedSamples
+        << ", \"injected_faults\": " << simulatedBus.getStatistics().injectedFaults
+        << ", \"us_per_sample\": " << std::fixed << std::setprecision(3) << (elapsed / static_cast<double>(cSampleCount))
+        << std::defaultfloat << ", \"recovery\": ";
+    recovery.getStatistics().writeJson(gOutput);
+    gOutput << ", \"success\": " << (success ? "true" : "false") << " }" << std::endl;
+    return success;
+}
+
+
+}
+
+
+int main()
+{
+    bool success = true;
+    success &= checkAbsoluteHumidityAccuracy();
+    benchmarkAbsoluteHumidity();
+    benchmarkProtocol();
+    benchmarkFormatting();
+    benchmarkSimulatedSensor();
+    benchmarkBusDebugPolicy();
+    success &= benchmarkRecovery();
+    success &= benchmarkSimulatedDay();
+    success &= benchmarkBaselinePersistence();
+    benchmarkSampleQueue();
+    const auto loadThreadCount = std::max(1u, std::thread::hardware_concurrency());
+    benchmarkSampleQueueThreads("sample_queue_threads", 1000000, std::chrono::microseconds(0), 0);
+    benchmarkSampleQueueThreads("sample_queue_threads", 1000000, std::chrono::microseconds(0), loadThreadCount);
+    benchmarkSampleQueueThreads("sample_queue_threads_paced", 20000, std::chrono::microseconds(50), 0);
+    benchmarkSampleQueueThreads("sample_queue_threads_paced", 20000, std::chrono::microseconds(50), loadThreadCount);
+    benchmarkOutputPipeline();
+    success &= checkSlowSink(lr::OutputPipeline::Policy::DropOldest, "drop_oldest", 20000);
+    success &= checkSlowSink(lr::OutputPipeline::Policy::Block, "block", 2000);
+    success &= checkSlowSink(lr::OutputPipeline::Policy::DropOldest, "drop_oldest_oversized", 20000, 300);
+    return success ? 0 : 1;
+}
+
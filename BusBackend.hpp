@@ -0,0 +1,76 @@
+#pragma once
+//
+// (c)2020 by Lucky Resistor. See LICENSE for details.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+
+
+#include <cstdint>
+
+
+namespace lr {
+
+
+/// An interface for the transfers of a bus, which replaces the I2C bus device.
+///
+/// A backend answers the transfers without the kernel, for example from a recorded trace
+/// or from simulated devices. It also provides the timing of the devices, so the sensor
+/// classes do not wait for the results of their commands.
+///
+class BusBackend
+{
+public:
+    /// dtor
+    ///
+    virtual ~BusBackend() = default;
+
+public:
+    /// Called if the bus is opened.
+    ///
+    virtual void open() {}
+
+    /// Called at the begin of a bus transaction, instead of acquiring the cross-process bus lock.
+    ///
+    /// A backend which simulates a shared bus keeps it for the whole transaction.
+    ///
+    virtual void beginTransaction() {}
+
+    /// Called at the end of a bus transaction.
+    ///
+    virtual void endTransaction() {}
+
+    /// Write data to a device.
+    ///
+    /// @param address The chip address.
+    /// @param data The data to write.
+    /// @param size The number of bytes.
+    /// @return The error number of the transfer, zero on success.
+    ///
+    virtual int write(uint8_t address, const uint8_t *data, int size) = 0;
+
+    /// Read data from a device.
+    ///
+    /// @param address The chip address.
+    /// @param data The buffer for the read data.
+    /// @param size The number of bytes to read.
+    /// @return The error number of the transfer, zero on success.
+    ///
+    virtual int read(uint8_t address, uint8_t *data, int size) = 0;
+};
+
+
+}
+
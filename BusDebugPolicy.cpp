@@ -0,0 +1,50 @@
+//
+// (c)2020 by Lucky Resistor. See LICENSE for details.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+#include "BusDebugPolicy.hpp"
+
+
+#include <iomanip>
+#include <iostream>
+
+
+namespace lr {
+
+
+void StreamBusDebugging::writeMessage(const char *message)
+{
+    std::cout << "# " << message << std::endl;
+}
+
+
+void StreamBusDebugging::writeTransfer(BusTrace::Direction direction, uint8_t address, const uint8_t *data, int size)
+{
+    if (direction == BusTrace::Direction::Write) {
+        std::cout << "# Write " << size << " bytes to 0x";
+    } else {
+        std::cout << "# Read " << size << " bytes from 0x";
+    }
+    std::cout << std::hex << std::setfill('0') << std::setw(2) << static_cast<int>(address) << ":";
+    for (int i = 0; i < size; ++i) {
+        std::cout << (i != 0 ? ", " : " ") << "0x" << std::setw(2) << static_cast<int>(data[i]);
+    }
+    std::cout << std::dec << std::setfill(' ') << std::endl;
+}
+
+
+}
+
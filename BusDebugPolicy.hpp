@@ -0,0 +1,82 @@
+#pragma once
+//
+// (c)2020 by Lucky Resistor. See LICENSE for details.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+
+
+#include "BusTrace.hpp"
+
+#include <cstdint>
+
+
+namespace lr {
+
+
+/// The bus debugging policy which removes all debugging output.
+///
+struct NoBusDebugging {
+    /// If the policy writes any output.
+    ///
+    static constexpr bool cEnabled = false;
+
+    /// Write a debugging message.
+    ///
+    static void writeMessage(const char*) noexcept {}
+
+    /// Write a transfer on the bus.
+    ///
+    static void writeTransfer(BusTrace::Direction, uint8_t, const uint8_t*, int) noexcept {}
+};
+
+
+/// The bus debugging policy which writes the communication to `std::cout`.
+///
+struct StreamBusDebugging {
+    /// If the policy writes any output.
+    ///
+    static constexpr bool cEnabled = true;
+
+    /// Write a debugging message.
+    ///
+    /// @param message The message.
+    ///
+    static void writeMessage(const char *message);
+
+    /// Write a transfer on the bus.
+    ///
+    /// @param direction The direction of the transfer.
+    /// @param address The chip address.
+    /// @param data The transferred data.
+    /// @param size The number of bytes.
+    ///
+    static void writeTransfer(BusTrace::Direction direction, uint8_t address, const uint8_t *data, int size);
+};
+
+
+/// The debugging policy of the bus, selected at compile time.
+///
+/// Define `LR_BUS_DEBUGGING` to compile the debugging output of the bus into the tool.
+///
+#ifdef LR_BUS_DEBUGGING
+using BusDebugPolicy = StreamBusDebugging;
+#else
+using BusDebugPolicy = NoBusDebugging;
+#endif
+
+
+}
+
@@ -0,0 +1,337 @@
+//
+// (c)2020 by Lucky Resistor. See LICENSE for details.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+#include "BusDiscovery.hpp"
+
+
+#include "I2CBus.hpp"
+#include "SGP30.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <string>
+#include <tuple>
+
+
+namespace lr {
+
+
+namespace fs = std::filesystem;
+
+
+bool BusDiscovery::Location::operator==(const Location &other) const noexcept
+{
+    return bus == other.bus && muxAddress == other.muxAddress && muxChannel == other.muxChannel;
+}
+
+
+bool BusDiscovery::Location::operator<(const Location &other) const noexcept
+{
+    return std::tie(bus, muxAddress, muxChannel) < std::tie(other.bus, other.muxAddress, other.muxChannel);
+}
+
+
+BusDiscovery::BusDiscovery()
+    : _topologyCacheFile(), _muxAddresses(), _isFromCache(false)
+{
+}
+
+
+void BusDiscovery::setTopologyCacheFile(const std::filesystem::path &path)
+{
+    _topologyCacheFile = path;
+}
+
+
+void BusDiscovery::setMuxAddresses(const std::vector<uint8_t> &addresses)
+{
+    _muxAddresses = addresses;
+    std::sort(_muxAddresses.begin(), _muxAddresses.end());
+    _muxAddresses.erase(std::unique(_muxAddresses.begin(), _muxAddresses.end()), _muxAddresses.end());
+}
+
+
+BusDiscovery::SensorList BusDiscovery::discover(bool useCache)
+{
+    const auto adapters = findAdapters();
+    _isFromCache = false;
+    if (useCache) {
+        if (const auto cachedSensors = readCache(adapters); cachedSensors.has_value()) {
+            std::map<int, SensorList> sensorsPerBus;
+            for (const auto &sensor : cachedSensors.value()) {
+                sensorsPerBus[sensor.location.bus].push_back(sensor);
+            }
+            std::vector<std::future<bool>> verifications;
+            for (const auto &[bus, sensors] : sensorsPerBus) {
+                verifications.push_back(std::async(std::launch::async, &BusDiscovery::verifyBus, bus, sensors));
+            }
+            bool isVerified = true;
+            for (auto &verification : verifications) {
+                isVerified &= verification.get();
+            }
+            if (isVerified) {
+                _isFromCache = true;
+                return cachedSensors.value();
+            }
+        }
+    }
+    std::vector<std::future<SensorList>> scans;
+    for (const auto bus : adapters) {
+        scans.push_back(std::async(std::launch::async, &BusDiscovery::scanBus, bus, std::cref(_muxAddresses)));
+    }
+    SensorList result;
+    for (auto &scan : scans) {
+        const auto sensors = scan.get();
+        result.insert(result.end(), sensors.begin(), sensors.end());
+    }
+    std::sort(result.begin(), result.end(), [](const Sensor &a, const Sensor &b) {
+        return a.location < b.location;
+    });
+    writeCache(adapters, result);
+    return result;
+}
+
+
+bool BusDiscovery::isFromCache() const
+{
+    return _isFromCache;
+}
+
+
+void BusDiscovery::writeJson(std::ostream &output, const SensorList &sensors)
+{
+    output << "[";
+    for (std::size_t i = 0; i < sensors.size(); ++i) {
+        const auto &sensor = sensors[i];
+        std::stringstream arguments;
+        arguments << "-b" << sensor.location.bus;
+        output << (i > 0 ? ", " : " ") << "{ \"bus\": " << sensor.location.bus;
+        if (sensor.location.muxAddress != 0) {
+            std::stringstream muxAddress;
+            muxAddress << "0x" << std::hex << std::setw(2) << std::setfill('0') << static_cast<int>(sensor.location.muxAddress);
+            output << ", \"mux\": \"" << muxAddress.str() << "\", \"channel\": " << static_cast<int>(sensor.location.muxChannel);
+            arguments << " --mux=" << muxAddress.str() << ":" << static_cast<int>(sensor.location.muxChannel);
+        } else {
+            output << ", \"mux\": null, \"channel\": null";
+        }
+        output << ", \"serial_number\": \"" << std::hex << std::setw(12) << std::setfill('0') << sensor.serialNumber
+            << "\", \"feature_set\": \"0x" << std::setw(4) << sensor.featureSet << std::dec << std::setfill(' ')
+            << "\", \"arguments\": \"" << arguments.str() << "\" }";
+    }
+    output << (sensors.empty() ? "]" : " ]");
+}
+
+
+std::vector<int> BusDiscovery::findAdapters()
+{
+    std::vector<int> result;
+    std::error_code error;
+    for (const auto &entry : fs::directory_iterator("/dev", error)) {
+        const auto name = entry.path().filename().string();
+        if (name.rfind("i2c-", 0) != 0 || name.size() == 4) {
+            continue;
+        }
+        if (!std::all_of(name.begin() + 4, name.end(), [](char c) { return c >= '0' && c <= '9'; })) {
+            continue;
+        }
+        try {
+            result.push_back(std::stoi(name.substr(4)));
+        } catch (const std::logic_error&) {
+            // ignore invalid bus numbers.
+        }
+    }
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+
+BusDiscovery::SensorList BusDiscovery::scanBus(int bus, const std::vector<uint8_t> &muxAddresses)
+{
+    SGP30 sgp(bus);
+    if (hasError(sgp.openBus())) {
+        return {};
+    }
+    auto i2cBus = sgp.getBus();
+    SensorList result;
+    {
+        const I2CBus::Transaction transaction(i2cBus);
+        if (hasError(transaction.getStatus())) {
+            return {};
+        }
+        // Disable all channels of the configured multiplexers, so the first probe only reaches the main bus.
+        std::vector<uint8_t> foundMuxAddresses;
+        for (const auto address : muxAddresses) {
+            uint8_t controlRegister = 0;
+            if (hasError(i2cBus->readData(address, &controlRegister, 1))) {
+                continue;
+            }
+            const uint8_t noChannel = 0;
+            if (isSuccessful(i2cBus->writeData(address, &noChannel, 1))
+                && isSuccessful(i2cBus->readData(address, &controlRegister, 1))
+                && controlRegister == noChannel) {
+                foundMuxAddresses.push_back(address);
+            }
+        }
+        const auto directSensor = probeSensor(sgp, Location{bus, 0, 0});
+        if (directSensor.has_value()) {
+            result.push_back(directSensor.value());
+        }
+        for (const auto muxAddress : foundMuxAddresses) {
+            for (uint8_t channel = 0; channel < cMuxChannelCount; ++channel) {
+                const uint8_t channelMask = static_cast<uint8_t>(1u << channel);
+                if (hasError(i2cBus->writeData(muxAddress, &channelMask, 1))) {
+                    continue;
+                }
+                const auto sensor = probeSensor(sgp, Location{bus, muxAddress, channel});
+                // The sensor on the main bus also answers with each selected channel.
+                if (sensor.has_value() && (!directSensor.has_value() || sensor->serialNumber != directSensor->serialNumber)) {
+                    result.push_back(sensor.value());
+                }
+            }
+            const uint8_t noChannel = 0;
+            i2cBus->writeData(muxAddress, &noChannel, 1);
+        }
+    }
+    sgp.closeBus();
+    return result;
+}
+
+
+bool BusDiscovery::verifyBus(int bus, const SensorList &sensors)
+{
+    SGP30 sgp(bus);
+    if (hasError(sgp.openBus())) {
+        return false;
+    }
+    bool result = true;
+    for (const auto &sensor : sensors) {
+        sgp.getBus()->setMuxChannel(sensor.location.muxAddress, sensor.location.muxChannel);
+        const auto serialResult = sgp.readSerialNumberValue();
+        if (hasError(serialResult) || serialResult.getValue() != sensor.serialNumber) {
+            result = false;
+            break;
+        }
+    }
+    sgp.closeBus();
+    return result;
+}
+
+
+std::optional<BusDiscovery::Sensor> BusDiscovery::probeSensor(SGP30 &sgp, const Location &location)
+{
+    const auto serialResult = sgp.readSerialNumberValue();
+    if (hasError(serialResult)) {
+        return std::nullopt;
+    }
+    const auto featureSetResult = sgp.readFeatureSet();
+    if (hasError(featureSetResult)) {
+        return std::nullopt;
+    }
+    return Sensor{location, serialResult.getValue(), featureSetResult.getValue()};
+}
+
+
+std::optional<BusDiscovery::SensorList> BusDiscovery::readCache(const std::vector<int> &adapters) const
+{
+    if (_topologyCacheFile.empty()) {
+        return std::nullopt;
+    }
+    std::ifstream file(_topologyCacheFile);
+    if (!file.is_open()) {
+        return std::nullopt;
+    }
+    std::vector<int> cachedAdapters;
+    std::vector<uint8_t> cachedMuxAddresses;
+    SensorList sensors;
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream lineStream(line);
+        std::string type;
+        lineStream >> type;
+        if (type == "adapters") {
+            int bus;
+            while (lineStream >> bus) {
+                cachedAdapters.push_back(bus);
+            }
+        } else if (type == "muxes") {
+            int address;
+            while (lineStream >> address) {
+                cachedMuxAddresses.push_back(static_cast<uint8_t>(address));
+            }
+        } else if (type == "sensor") {
+            int bus;
+            int muxAddress;
+            int muxChannel;
+            uint64_t serialNumber;
+            uint16_t featureSet;
+            lineStream >> bus >> muxAddress >> muxChannel >> std::hex >> serialNumber >> featureSet;
+            if (lineStream.fail()) {
+                return std::nullopt;
+            }
+            sensors.push_back(Sensor{
+                Location{bus, static_cast<uint8_t>(muxAddress), static_cast<uint8_t>(muxChannel)},
+                serialNumber,
+                featureSet});
+        }
+    }
+    // Without any sensors, probing all buses is as fast as the verification.
+    if (cachedAdapters != adapters || cachedMuxAddresses != _muxAddresses || sensors.empty()) {
+        return std::nullopt;
+    }
+    return sensors;
+}
+
+
+void BusDiscovery::writeCache(const std::vector<int> &adapters, const SensorList &sensors) const
+{
+    if (_topologyCacheFile.empty()) {
+        return;
+    }
+    auto temporaryFile = _topologyCacheFile;
+    temporaryFile += ".tmp";
+    {
+        std::ofstream file(temporaryFile, std::ios::trunc);
+        if (!file.is_open()) {
+            return;
+        }
+        file << "adapters";
+        for (const auto bus : adapters) {
+            file << " " << bus;
+        }
+        file << "\nmuxes";
+        for (const auto address : _muxAddresses) {
+            file << " " << static_cast<int>(address);
+        }
+        file << "\n";
+        for (const auto &sensor : sensors) {
+            file << "sensor " << sensor.location.bus << " " << static_cast<int>(sensor.location.muxAddress)
+                << " " << static_cast<int>(sensor.location.muxChannel) << std::hex
+                << " " << sensor.serialNumber << " " << sensor.featureSet << std::dec << "\n";
+        }
+    }
+    std::error_code error;
+    fs::rename(temporaryFile, _topologyCacheFile, error);
+}
+
+
+}
+
@@ -0,0 +1,176 @@
+#pragma once
+//
+// (c)2020 by Lucky Resistor. See LICENSE for details.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <ostream>
+#include <vector>
+
+
+namespace lr {
+
+
+class SGP30;
+
+
+/// Finds the SGP30 sensors on all I2C buses of the system.
+///
+/// All `/dev/i2c-*` adapters are probed in parallel, one thread per bus. On each bus, the
+/// discovery looks for a sensor at address `0x58`. Other devices are never written to, so only
+/// the configured TCA9548 multiplexer addresses are probed. Behind each multiplexer, every channel
+/// is probed for another sensor. For each sensor, the serial number and the feature set are read.
+///
+/// The found topology is stored in a cache file. A later discovery only verifies the cached
+/// sensors, which is a lot faster than probing every address and channel. If the adapters
+/// changed or a sensor does not answer with the cached serial number, all buses are probed again.
+///
+class BusDiscovery
+{
+public:
+    /// The location of a sensor.
+    ///
+    struct Location {
+        int bus; ///< The number of the I2C bus.
+        uint8_t muxAddress; ///< The address of the multiplexer, or zero without multiplexer.
+        uint8_t muxChannel; ///< The channel of the multiplexer.
+
+        bool operator==(const Location &other) const noexcept;
+        bool operator<(const Location &other) const noexcept;
+    };
+
+    /// A found sensor.
+    ///
+    struct Sensor {
+        Location location; ///< The location of the sensor.
+        uint64_t serialNumber; ///< The 48 bit serial number.
+        uint16_t featureSet; ///< The feature set of the sensor.
+    };
+
+    /// A list of sensors, ordered by their location.
+    ///
+    using SensorList = std::vector<Sensor>;
+
+    /// The first address of a TCA9548 multiplexer.
+    ///
+    constexpr static uint8_t cFirstMuxAddress = 0x70;
+
+    /// The last address of a TCA9548 multiplexer.
+    ///
+    constexpr static uint8_t cLastMuxAddress = 0x77;
+
+    /// The number of channels of a multiplexer.
+    ///
+    constexpr static uint8_t cMuxChannelCount = 8;
+
+public:
+    /// ctor
+    ///
+    BusDiscovery();
+
+public:
+    /// Set the file to cache the topology.
+    ///
+    /// @param path The path to the cache file, or an empty path to disable the cache.
+    ///
+    void setTopologyCacheFile(const std::filesystem::path &path);
+
+    /// Set the addresses of the TCA9548 multiplexers.
+    ///
+    /// Only at these addresses, the discovery selects channels to probe for sensors.
+    ///
+    /// @param addresses The multiplexer addresses, in the range `cFirstMuxAddress` to `cLastMuxAddress`.
+    ///
+    void setMuxAddresses(const std::vector<uint8_t> &addresses);
+
+    /// Find all sensors.
+    ///
+    /// @param useCache If the cached topology shall be verified instead of probing all buses.
+    /// @return The found sensors.
+    ///
+    SensorList discover(bool useCache);
+
+    /// Check if the last discovery used the cached topology.
+    ///
+    bool isFromCache() const;
+
+    /// Write the sensors as JSON array.
+    ///
+    /// Each sensor contains the command line arguments to select it.
+    ///
+    /// @param output The output stream.
+    /// @param sensors The sensors.
+    ///
+    static void writeJson(std::ostream &output, const SensorList &sensors);
+
+    /// Find the numbers of all I2C adapters.
+    ///
+    /// @return The sorted bus numbers.
+    ///
+    static std::vector<int> findAdapters();
+
+private:
+    /// Probe the sensor address and the channels of the multiplexers on a bus.
+    ///
+    /// @param bus The bus number.
+    /// @param muxAddresses The addresses of the multiplexers.
+    /// @return The sensors on the bus.
+    ///
+    static SensorList scanBus(int bus, const std::vector<uint8_t> &muxAddresses);
+
+    /// Check if the cached sensors of a bus still answer with the same serial number.
+    ///
+    /// @param bus The bus number.
+    /// @param sensors The cached sensors of this bus.
+    /// @return `true` if all sensors were verified.
+    ///
+    static bool verifyBus(int bus, const SensorList &sensors);
+
+    /// Read the serial number and feature set of a sensor.
+    ///
+    /// @param sgp The sensor, with the multiplexer channel selected.
+    /// @param location The location of the sensor.
+    /// @return The sensor, or no value if there is no sensor.
+    ///
+    static std::optional<Sensor> probeSensor(SGP30 &sgp, const Location &location);
+
+    /// Read the cached topology.
+    ///
+    /// @param adapters The current adapters. The cache is ignored if they or the multiplexers changed.
+    /// @return The cached sensors, or no value if there is no valid cache.
+    ///
+    std::optional<SensorList> readCache(const std::vector<int> &adapters) const;
+
+    /// Write the topology into the cache.
+    ///
+    /// @param adapters The current adapters.
+    /// @param sensors The found sensors.
+    ///
+    void writeCache(const std::vector<int> &adapters, const SensorList &sensors) const;
+
+private:
+    std::filesystem::path _topologyCacheFile; ///< The topology cache file, empty if not used.
+    std::vector<uint8_t> _muxAddresses; ///< The addresses of the multiplexers, sorted.
+    bool _isFromCache; ///< If the last discovery used the cached topology.
+};
+
+
+}
+
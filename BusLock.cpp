@@ -0,0 +1,224 @@
+//
+// (c)2020 by Lucky Resistor. See LICENSE for details.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+#include "BusLock.hpp"
+
+
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <thread>
+
+
+namespace lr {
+
+
+using namespace std::chrono;
+
+
+namespace {
+constexpr auto cPollInterval = 1ms; ///< The poll interval for the fair policy and the first backoff step.
+constexpr auto cMaximumBackoff = 32ms; ///< The maximum backoff interval.
+}
+
+
+BusLock::BusLock()
+:
+    _fd(-1),
+    _waiterFd(-1),
+    _isLocked(false),
+    _hadWaiters(false),
+    _policy(Policy::Fair),
+    _timeout(2s),
+    _lastRelease(),
+    _statistics()
+{
+}
+
+
+BusLock::~BusLock()
+{
+    if (_waiterFd >= 0) {
+        ::close(_waiterFd);
+    }
+}
+
+
+void BusLock::setFileDescriptor(int fd)
+{
+    if (_waiterFd >= 0) {
+        ::close(_waiterFd);
+    }
+    _fd = fd;
+    _waiterFd = (fd >= 0) ? openWaiterFile(fd) : -1;
+    _isLocked = false;
+    _hadWaiters = false;
+}
+
+
+void BusLock::setTimeout(std::chrono::milliseconds timeout)
+{
+    _timeout = timeout;
+}
+
+
+void BusLock::setPolicy(Policy policy)
+{
+    _policy = policy;
+}
+
+
+BusLock::Status BusLock::acquire()
+{
+    if (_fd < 0) {
+        std::cerr << "Call to acquire() for a closed bus." << std::endl;
+        return Status::Error;
+    }
+    if (_isLocked) {
+        return Status::Success;
+    }
+    const auto startTime = Clock::now();
+    // If another process waited at the last release, give it a chance to get the bus first.
+    if (_policy == Policy::Fair && _hadWaiters && (startTime - _lastRelease) < cPollInterval) {
+        std::this_thread::sleep_for(cPollInterval);
+    }
+    bool contended = false;
+    auto interval = duration_cast<nanoseconds>(cPollInterval);
+    while (!tryLock()) {
+        if (errno != EWOULDBLOCK) {
+            const auto error = errno;
+            if (contended && _waiterFd >= 0) {
+                flock(_waiterFd, LOCK_UN);
+            }
+            errno = error;
+            return Status::IoError;
+        }
+        if (!contended && _waiterFd >= 0) {
+            // Announce the wait; the holder only probes the file for a moment, so this never blocks long.
+            while (flock(_waiterFd, LOCK_SH) < 0 && errno == EINTR) {
+            }
+        }
+        contended = true;
+        const auto now = Clock::now();
+        if (now - startTime >= _timeout) {
+            if (_waiterFd >= 0) {
+                flock(_waiterFd, LOCK_UN);
+            }
+            _statistics.timeouts += 1;
+            _statistics.totalWait += now - startTime;
+            return Status::Timeout;
+        }
+        std::this_thread::sleep_for(interval);
+        if (_policy == Policy::Backoff) {
+            interval = std::min(interval * 2, duration_cast<nanoseconds>(cMaximumBackoff));
+        }
+    }
+    if (contended && _waiterFd >= 0) {
+        flock(_waiterFd, LOCK_UN);
+    }
+    const auto waitTime = duration_cast<nanoseconds>(Clock::now() - startTime);
+    _isLocked = true;
+    _statistics.acquisitions += 1;
+    if (contended) {
+        _statistics.contentions += 1;
+    }
+    _statistics.totalWait += waitTime;
+    _statistics.maximumWait = std::max(_statistics.maximumWait, waitTime);
+    return Status::Success;
+}
+
+
+void BusLock::release()
+{
+    if (_isLocked) {
+        flock(_fd, LOCK_UN);
+        _isLocked = false;
+        _lastRelease = Clock::now();
+        _hadWaiters = hasWaiters();
+    }
+}
+
+
+bool BusLock::isLocked() const
+{
+    return _isLocked;
+}
+
+
+const BusLock::Statistics &BusLock::getStatistics() const
+{
+    return _statistics;
+}
+
+
+bool BusLock::tryLock()
+{
+    int result;
+    do {
+        result = flock(_fd, LOCK_EX | LOCK_NB);
+    } while (result < 0 && errno == EINTR);
+    return result == 0;
+}
+
+
+int BusLock::openWaiterFile(int deviceFd)
+{
+    struct stat deviceStatus{};
+    if (fstat(deviceFd, &deviceStatus) < 0) {
+        return -1;
+    }
+    const auto path = std::filesystem::temp_directory_path() / ("lr_read_sgp30.bus-"
+        + std::to_string(major(deviceStatus.st_rdev)) + "-" + std::to_string(minor(deviceStatus.st_rdev)) + ".waiters");
+    // `flock()` works with a read-only descriptor, so the file can be shared by all users.
+    // Open an existing file without O_CREAT, which is refused for files of other users in sticky directories.
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0 && errno == ENOENT) {
+        fd = ::open(path.c_str(), O_RDONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+        if (fd < 0 && errno == EEXIST) {
+            fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        }
+    }
+    return fd;
+}
+
+
+bool BusLock::hasWaiters() const
+{
+    if (_waiterFd < 0) {
+        return false;
+    }
+    int result;
+    do {
+        result = flock(_waiterFd, LOCK_EX | LOCK_NB);
+    } while (result < 0 && errno == EINTR);
+    if (result == 0) {
+        flock(_waiterFd, LOCK_UN);
+        return false;
+    }
+    return errno == EWOULDBLOCK;
+}
+
+
+}
+
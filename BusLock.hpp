@@ -0,0 +1,149 @@
+#pragma once
+//
+// (c)2020 by Lucky Resistor. See LICENSE for details.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+
+
+#include "StatusTools.hpp"
+
+#include <chrono>
+#include <cstdint>
+
+
+namespace lr {
+
+
+/// An advisory cross-process lock for an I2C bus.
+///
+/// The lock uses `flock()` on the file descriptor of the opened bus device. Every process which
+/// opens the same device and uses this lock will wait until the other process finished its
+/// transaction. The wait is bounded by a timeout.
+///
+/// While a process waits for the bus, it holds a shared lock on a sidecar file next to the
+/// other temporary files. After releasing the bus, the holder probes this file with an
+/// exclusive lock. If it is held, another process is waiting, and with the fair policy, the
+/// holder lets it go first.
+///
+class BusLock
+{
+public:
+    using Status = CallStatus;
+
+    /// The policy used while waiting for the lock.
+    ///
+    enum class Policy : uint8_t {
+        Fair, ///< Poll in short constant intervals and yield to waiting processes.
+        Backoff, ///< Poll with an exponential backoff, which uses less CPU but favours new processes.
+    };
+
+    /// The statistics about the lock.
+    ///
+    struct Statistics {
+        uint32_t acquisitions = 0; ///< The number of successful acquisitions.
+        uint32_t contentions = 0; ///< The number of acquisitions where the bus was locked by another process.
+        uint32_t timeouts = 0; ///< The number of acquisitions which failed with a timeout.
+        std::chrono::nanoseconds totalWait = {}; ///< The total time spent waiting for the lock.
+        std::chrono::nanoseconds maximumWait = {}; ///< The longest wait for the lock.
+    };
+
+public:
+    /// ctor
+    ///
+    BusLock();
+
+    /// dtor
+    ///
+    ~BusLock();
+
+    BusLock(const BusLock&) = delete;
+    BusLock &operator=(const BusLock&) = delete;
+
+public:
+    /// Set the file descriptor of the bus device.
+    ///
+    /// @param fd The file descriptor, or a negative value if the bus is closed.
+    ///
+    void setFileDescriptor(int fd);
+
+    /// Set the maximum time to wait for the lock.
+    ///
+    /// @param timeout The timeout.
+    ///
+    void setTimeout(std::chrono::milliseconds timeout);
+
+    /// Set the policy used while waiting for the lock.
+    ///
+    /// @param policy The policy.
+    ///
+    void setPolicy(Policy policy);
+
+    /// Acquire the lock.
+    ///
+    /// @return The call status. `Timeout` if the lock could not be acquired within the timeout,
+    ///     `IoError` if locking the device failed, with the error number in `errno`.
+    ///
+    Status acquire();
+
+    /// Release the lock.
+    ///
+    void release();
+
+    /// Check if the lock is held by this object.
+    ///
+    /// @return `true` if the lock is held.
+    ///
+    bool isLocked() const;
+
+    /// Access the collected statistics.
+    ///
+    /// @return The statistics.
+    ///
+    const Statistics &getStatistics() const;
+
+private:
+    /// Try to lock the bus without waiting.
+    ///
+    /// @return `true` if the lock was acquired.
+    ///
+    bool tryLock();
+
+    /// Open the sidecar file to announce waiting processes for the bus device.
+    ///
+    /// @return The file descriptor, or a negative value if the file can not be used.
+    ///
+    static int openWaiterFile(int deviceFd);
+
+    /// Check if another process waits for the bus.
+    ///
+    bool hasWaiters() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    int _fd; ///< The file descriptor of the bus device.
+    int _waiterFd; ///< The file descriptor of the sidecar file for waiting processes, or negative.
+    bool _isLocked; ///< If this object holds the lock.
+    bool _hadWaiters; ///< If another process waited for the bus at the last release.
+    Policy _policy; ///< The wait policy.
+    std::chrono::milliseconds _timeout; ///< The maximum wait time.
+    Clock::time_point _lastRelease; ///< The time of the last release.
+    Statistics _statistics; ///< The collected statistics.
+};
+
+
+}
+
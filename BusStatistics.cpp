@@ -0,0 +1,175 @@
+//
+// (c)2020 by Lucky Resistor. See LICENSE for details.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+#include "BusStatistics.hpp"
+
+
+#include <algorithm>
+#include <iomanip>
+
+
+namespace lr {
+
+
+LatencyHistogram::LatencyHistogram()
+    : _buckets(), _count(0), _sum(0), _minimum(UINT64_MAX), _maximum(0)
+{
+}
+
+
+void LatencyHistogram::record(std::chrono::nanoseconds duration) noexcept
+{
+    const auto value = static_cast<uint64_t>(std::max<int64_t>(duration.count(), 0));
+    _buckets[getBucketIndex(value)] += 1;
+    _count += 1;
+    _sum += value;
+    _minimum = std::min(_minimum, value);
+    _maximum = std::max(_maximum, value);
+}
+
+
+void LatencyHistogram::merge(const LatencyHistogram &other) noexcept
+{
+    for (std::size_t i = 0; i < _buckets.size(); ++i) {
+        _buckets[i] += other._buckets[i];
+    }
+    _count += other._count;
+    _sum += other._sum;
+    _minimum = std::min(_minimum, other._minimum);
+    _maximum = std::max(_maximum, other._maximum);
+}
+
+
+uint64_t LatencyHistogram::getCount() const noexcept
+{
+    return _count;
+}
+
+
+uint64_t LatencyHistogram::getPercentile(double percentile) const noexcept
+{
+    if (_count == 0) {
+        return 0;
+    }
+    const auto targetCount = static_cast<uint64_t>(std::clamp(percentile, 0.0, 100.0) / 100.0 * _count + 0.5);
+    uint64_t count = 0;
+    for (std::size_t i = 0; i < _buckets.size(); ++i) {
+        count += _buckets[i];
+        if (count >= std::max<uint64_t>(targetCount, 1)) {
+            return std::min(getBucketUpperBound(i), _maximum);
+        }
+    }
+    return _maximum;
+}
+
+
+void LatencyHistogram::writeJson(std::ostream &output) const
+{
+    output << "{ \"count\": " << _count;
+    if (_count > 0) {
+        output << ", \"min_ns\": " << _minimum
+            << ", \"mean_ns\": " << (_sum / _count)
+            << ", \"p50_ns\": " << getPercentile(50.0)
+            << ", \"p90_ns\": " << getPercentile(90.0)
+            << ", \"p99_ns\": " << getPercentile(99.0)
+            << ", \"max_ns\": " << _maximum;
+    }
+    output << " }";
+}
+
+
+std::size_t LatencyHistogram::getBucketIndex(uint64_t value) noexcept
+{
+    if (value < cLinearLimit) {
+        return static_cast<std::size_t>(value);
+    }
+    const int highestBit = 63 - __builtin_clzll(value);
+    if (highestBit >= cMaximumBit) {
+        return cBucketCount - 1;
+    }
+    const int shift = highestBit - cSubBucketBits;
+    const auto subBucket = static_cast<std::size_t>((value >> shift) & (cSubBucketCount - 1));
+    return cLinearLimit + static_cast<std::size_t>(shift - 1) * cSubBucketCount + subBucket;
+}
+
+
+uint64_t LatencyHistogram::getBucketUpperBound(std::size_t index) noexcept
+{
+    if (index < cLinearLimit) {
+        return index;
+    }
+    const auto shift = static_cast<int>((index - cLinearLimit) / cSubBucketCount) + 1;
+    const auto subBucket = static_cast<uint64_t>((index - cLinearLimit) % cSubBucketCount);
+    return ((static_cast<uint64_t>(cSubBucketCount) + subBucket + 1) << shift) - 1;
+}
+
+
+SensorStatistics::SensorStatistics()
+    : crcFailures(0), _commands()
+{
+}
+
+
+CommandStatistics &SensorStatistics::getCommand(uint16_t command)
+{
+    // There are only a few commands per sensor, a linear search is faster than a map.
+    for (auto &[code, statistics] : _commands) {
+        if (code == command) {
+            return statistics;
+        }
+    }
+    _commands.emplace_back(command, CommandStatistics());
+    return _commands.back().second;
+}
+
+
+void SensorStatistics::writeJson(std::ostream &output) const
+{
+    output << "{ \"crc_failures\": " << crcFailures << ", \"commands\": [";
+    bool isFirst = true;
+    for (const auto &[code, statistics] : _commands) {
+        if (!isFirst) {
+            output << ",";
+        }
+        isFirst = false;
+        output << " { \"command\": \"0x" << std::hex << std::setw(4) << std::setfill('0') << code
+            << std::dec << "\", \"write\": ";
+        statistics.write.writeJson(output);
+        output << ", \"wait\": ";
+        statistics.wait.writeJson(output);
+        output << ", \"read\": ";
+        statistics.read.writeJson(output);
+        output << " }";
+    }
+    output << " ] }";
+}
+
+
+void BusStatistics::writeJson(std::ostream &output) const
+{
+    output << "{ \"writes\": " << writes
+        << ", \"reads\": " << reads
+        << ", \"bytes_written\": " << bytesWritten
+        << ", \"bytes_read\": " << bytesRead
+        << ", \"ioctl_calls\": " << ioctlCalls
+        << ", \"address_switches\": " << addressSwitches
+        << ", \"errors\": " << errors << " }";
+}
+
+
+}
+
@@ -0,0 +1,166 @@
+#pragma once
+//
+// (c)2020 by Lucky Resistor. See LICENSE for details.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <utility>
+#include <vector>
+
+
+namespace lr {
+
+
+/// A latency histogram with logarithmic buckets.
+///
+/// Similar to a HDR histogram, each power of two range is split into 16 linear
+/// sub-buckets, so every recorded value is kept with a precision better than 6.25%.
+/// Recording a value is a few integer operations without any allocation.
+///
+class LatencyHistogram
+{
+public:
+    /// ctor
+    ///
+    LatencyHistogram();
+
+public:
+    /// Record a value.
+    ///
+    /// @param duration The duration to record.
+    ///
+    void record(std::chrono::nanoseconds duration) noexcept;
+
+    /// Add all values recorded by another histogram.
+    ///
+    /// @param other The other histogram.
+    ///
+    void merge(const LatencyHistogram &other) noexcept;
+
+    /// Get the number of recorded values.
+    ///
+    uint64_t getCount() const noexcept;
+
+    /// Get a percentile of the recorded values.
+    ///
+    /// @param percentile The percentile, from 0.0 to 100.0.
+    /// @return The upper bound of the bucket with the percentile, in nanoseconds.
+    ///
+    uint64_t getPercentile(double percentile) const noexcept;
+
+    /// Write the summary of the histogram as JSON object.
+    ///
+    /// @param output The output stream.
+    ///
+    void writeJson(std::ostream &output) const;
+
+private:
+    static constexpr int cSubBucketBits = 4; ///< The number of bits for the sub-buckets.
+    static constexpr int cSubBucketCount = 1 << cSubBucketBits; ///< The number of sub-buckets per power of two.
+    static constexpr int cLinearLimit = cSubBucketCount * 2; ///< The values below are stored in linear buckets.
+    static constexpr int cMaximumBit = 40; ///< Values above 2^40 ns (~18 minutes) are stored in the last bucket.
+    static constexpr int cBucketCount = cLinearLimit + (cMaximumBit - cSubBucketBits) * cSubBucketCount;
+
+    /// Get the bucket index for a value.
+    ///
+    static std::size_t getBucketIndex(uint64_t value) noexcept;
+
+    /// Get the highest value stored in a bucket.
+    ///
+    static uint64_t getBucketUpperBound(std::size_t index) noexcept;
+
+private:
+    std::array<uint32_t, cBucketCount> _buckets; ///< The buckets.
+    uint64_t _count; ///< The number of recorded values.
+    uint64_t _sum; ///< The sum of all values.
+    uint64_t _minimum; ///< The smallest value.
+    uint64_t _maximum; ///< The largest value.
+};
+
+
+/// The statistics of the transactions of one command.
+///
+struct CommandStatistics {
+    LatencyHistogram write; ///< The time to write the command.
+    LatencyHistogram wait; ///< The time waiting for the result.
+    LatencyHistogram read; ///< The time to read the result.
+};
+
+
+/// The statistics of a sensor.
+///
+class SensorStatistics
+{
+public:
+    /// The list with the statistics of each command.
+    ///
+    using CommandList = std::vector<std::pair<uint16_t, CommandStatistics>>;
+
+public:
+    /// ctor
+    ///
+    SensorStatistics();
+
+public:
+    /// Get the statistics for a command.
+    ///
+    /// The statistics are created with the first use of a command.
+    ///
+    /// @param command The command code.
+    /// @return The statistics for the command.
+    ///
+    CommandStatistics &getCommand(uint16_t command);
+
+    /// Write the statistics as JSON object.
+    ///
+    /// @param output The output stream.
+    ///
+    void writeJson(std::ostream &output) const;
+
+public:
+    uint64_t crcFailures; ///< The number of values with a CRC mismatch.
+
+private:
+    CommandList _commands; ///< The statistics for each command.
+};
+
+
+/// The statistics of a bus.
+///
+struct BusStatistics {
+    uint64_t writes = 0; ///< The number of write calls.
+    uint64_t reads = 0; ///< The number of read calls.
+    uint64_t bytesWritten = 0; ///< The number of written bytes.
+    uint64_t bytesRead = 0; ///< The number of read bytes.
+    uint64_t ioctlCalls = 0; ///< The number of ioctl calls.
+    uint64_t addressSwitches = 0; ///< The number of chip address switches.
+    uint64_t errors = 0; ///< The number of failed bus operations.
+
+    /// Write the statistics as JSON object.
+    ///
+    /// @param output The output stream.
+    ///
+    void writeJson(std::ostream &output) const;
+};
+
+
+}
+
@@ -0,0 +1,251 @@
+//
+// (c)2020 by Lucky Resistor. See LICENSE for details.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+#include "BusTrace.hpp"
+
+
+#include <sys/uio.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <thread>
+#include <utility>
+
+
+namespace lr {
+
+
+namespace {
+
+constexpr char cTraceMagic[8] = {'L', 'R', 'T', 'R', 'A', 'C', 'E', '1'}; ///< The magic at the start of a trace file.
+
+}
+
+
+BusTraceRecorder::BusTraceRecorder(std::size_t bufferSize)
+    : _fd(-1), _startTime(), _ring(std::max<std::size_t>(bufferSize, 2)), _readPosition(0), _writePosition(0),
+    _droppedCount(0)
+{
+}
+
+
+BusTraceRecorder::~BusTraceRecorder()
+{
+    close();
+}
+
+
+BusTraceRecorder::Status BusTraceRecorder::open(const std::filesystem::path &path)
+{
+    close();
+    _fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (_fd < 0) {
+        std::cerr << "Failed to create the trace file: " << path.string() << std::endl;
+        return Status::Error;
+    }
+    if (write(_fd, cTraceMagic, sizeof(cTraceMagic)) != sizeof(cTraceMagic)) {
+        std::cerr << "Failed to write the trace file. Error: " << strerror(errno) << std::endl;
+        close();
+        return Status::Error;
+    }
+    _startTime = Clock::now();
+    _readPosition = 0;
+    _writePosition = 0;
+    _droppedCount = 0;
+    return Status::Success;
+}
+
+
+void BusTraceRecorder::close()
+{
+    if (_fd >= 0) {
+        flush();
+        ::close(_fd);
+        _fd = -1;
+        if (_droppedCount > 0) {
+            std::cerr << "The bus trace is incomplete, " << _droppedCount << " records were dropped." << std::endl;
+        }
+    }
+}
+
+
+void BusTraceRecorder::record(BusTrace::Direction direction, uint8_t address, const uint8_t *data, int size, int error) noexcept
+{
+    if (_fd < 0) {
+        return;
+    }
+    if (_writePosition - _readPosition == _ring.size()) {
+        _droppedCount += 1;
+        return;
+    }
+    auto &record = _ring[_writePosition % _ring.size()];
+    record.timestamp = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        Clock::now() - _startTime).count());
+    record.address = address;
+    record.direction = direction;
+    record.size = static_cast<uint8_t>(std::clamp(size, 0, 0xff));
+    record.reserved = 0;
+    record.error = error;
+    std::memset(record.data, 0, sizeof(record.data));
+    if (size > 0) {
+        std::memcpy(record.data, data, std::min<std::size_t>(static_cast<std::size_t>(size), sizeof(record.data)));
+    }
+    _writePosition += 1;
+}
+
+
+BusTraceRecorder::Status BusTraceRecorder::flush()
+{
+    if (_fd < 0 || _readPosition == _writePosition) {
+        return Status::Success;
+    }
+    // The used part of the ring wraps at most once, so it is written in two segments.
+    const auto start = _readPosition % _ring.size();
+    const auto count = _writePosition - _readPosition;
+    const auto firstCount = std::min(count, _ring.size() - start);
+    iovec segments[2] = {
+        {&_ring[start], firstCount * sizeof(BusTrace::Record)},
+        {_ring.data(), (count - firstCount) * sizeof(BusTrace::Record)}
+    };
+    const auto size = count * sizeof(BusTrace::Record);
+    _readPosition = _writePosition;
+    if (writev(_fd, segments, (firstCount < count) ? 2 : 1) != static_cast<ssize_t>(size)) {
+        std::cerr << "Failed to write the trace file. Error: " << strerror(errno) << std::endl;
+        return Status::Error;
+    }
+    return Status::Success;
+}
+
+
+BusTraceRecorder::Status BusTraceRecorder::flushIfDue()
+{
+    if (_writePosition - _readPosition < _ring.size() / 2) {
+        return Status::Success;
+    }
+    return flush();
+}
+
+
+uint64_t BusTraceRecorder::getDroppedCount() const
+{
+    return _droppedCount;
+}
+
+
+BusTraceReplayer::BusTraceReplayer()
+    : _records(), _position(0), _speed(1.0), _startTime(), _endHandler()
+{
+}
+
+
+BusTraceReplayer::Status BusTraceReplayer::open(const std::filesystem::path &path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        std::cerr << "Failed to open the trace file: " << path.string() << std::endl;
+        return Status::Error;
+    }
+    char magic[sizeof(cTraceMagic)];
+    if (!file.read(magic, sizeof(magic)) || std::memcmp(magic, cTraceMagic, sizeof(magic)) != 0) {
+        std::cerr << "The file is no bus trace: " << path.string() << std::endl;
+        return Status::Error;
+    }
+    _records.clear();
+    BusTrace::Record record{};
+    while (file.read(reinterpret_cast<char*>(&record), sizeof(record))) {
+        _records.push_back(record);
+    }
+    _position = 0;
+    _startTime = Clock::now();
+    return Status::Success;
+}
+
+
+void BusTraceReplayer::setSpeed(double speed)
+{
+    _speed = std::max(speed, 0.0);
+}
+
+
+void BusTraceReplayer::setEndHandler(std::function<void()> handler)
+{
+    _endHandler = std::move(handler);
+}
+
+
+int BusTraceReplayer::write(uint8_t address, const uint8_t *data, int size)
+{
+    const auto record = nextRecord(BusTrace::Direction::Write, address, size);
+    if (record == nullptr) {
+        return EIO;
+    }
+    const auto comparedSize = std::min<std::size_t>(static_cast<std::size_t>(size), sizeof(record->data));
+    if (std::memcmp(record->data, data, comparedSize) != 0) {
+        std::cerr << "The written data differs from the trace at record " << (_position - 1) << "." << std::endl;
+        return EIO;
+    }
+    return record->error;
+}
+
+
+int BusTraceReplayer::read(uint8_t address, uint8_t *data, int size)
+{
+    const auto record = nextRecord(BusTrace::Direction::Read, address, size);
+    if (record == nullptr) {
+        return EIO;
+    }
+    std::memset(data, 0, static_cast<std::size_t>(size));
+    std::memcpy(data, record->data, std::min<std::size_t>(static_cast<std::size_t>(size), sizeof(record->data)));
+    return record->error;
+}
+
+
+bool BusTraceReplayer::isAtEnd() const
+{
+    return _position >= _records.size();
+}
+
+
+const BusTrace::Record *BusTraceReplayer::nextRecord(BusTrace::Direction direction, uint8_t address, int size)
+{
+    if (isAtEnd()) {
+        std::cerr << "The transfer is beyond the end of the trace." << std::endl;
+        if (_endHandler) {
+            _endHandler();
+        }
+        return nullptr;
+    }
+    const auto &record = _records[_position];
+    if (record.direction != direction || record.address != address || record.size != size) {
+        std::cerr << "The transfer does not match the trace at record " << _position << "." << std::endl;
+        return nullptr;
+    }
+    _position += 1;
+    if (_speed > 0.0) {
+        const auto offset = std::chrono::duration<double, std::nano>(static_cast<double>(record.timestamp) / _speed);
+        std::this_thread::sleep_until(_startTime + std::chrono::duration_cast<Clock::duration>(offset));
+    }
+    return &record;
+}
+
+
+}
+
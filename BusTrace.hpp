@@ -0,0 +1,216 @@
+#pragma once
+//
+// (c)2020 by Lucky Resistor. See LICENSE for details.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+
+
+#include "BusBackend.hpp"
+#include "StatusTools.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <vector>
+
+
+namespace lr {
+
+
+/// The binary trace format of bus transfers.
+///
+/// A trace file starts with the magic "LRTRACE1", followed by fixed size records. Each
+/// record stores one read or write on the bus, with the time since the start of the
+/// trace, the chip address, the transferred bytes and the error number of a failed transfer.
+///
+namespace BusTrace {
+
+/// The direction of a transfer.
+///
+enum class Direction : uint8_t {
+    Write = 0, ///< Data written to the bus.
+    Read = 1 ///< Data read from the bus.
+};
+
+/// The maximum number of bytes stored per transfer.
+///
+constexpr std::size_t cMaximumDataSize = 16;
+
+/// One transfer in the trace.
+///
+struct Record {
+    uint64_t timestamp; ///< The time since the start of the trace in nanoseconds.
+    uint8_t address; ///< The chip address.
+    Direction direction; ///< The direction of the transfer.
+    uint8_t size; ///< The number of transferred bytes.
+    uint8_t reserved; ///< Reserved, always zero.
+    int32_t error; ///< The error number of a failed transfer, zero on success.
+    uint8_t data[cMaximumDataSize]; ///< The first transferred bytes.
+};
+
+static_assert(sizeof(Record) == 32, "The trace record must be 32 bytes.");
+
+}
+
+
+/// Records all transfers on a bus into a trace file.
+///
+/// The records are collected in a preallocated ring. Recording a transfer never allocates
+/// memory or calls into the kernel, which keeps the timing of the bus communication intact.
+/// The bus drains the ring with `flushIfDue()` at the end of each transaction, after the bus
+/// lock was released, and the remaining records are written if the recorder is closed.
+/// If a single transaction overflows the ring, the excess records are dropped and counted.
+///
+class BusTraceRecorder
+{
+public:
+    using Status = CallStatus;
+    using Clock = std::chrono::steady_clock;
+
+public:
+    /// Create a new recorder.
+    ///
+    /// @param bufferSize The number of records in the ring.
+    ///
+    explicit BusTraceRecorder(std::size_t bufferSize = 1024);
+
+    /// dtor
+    ///
+    /// Writes the remaining records and closes the file.
+    ///
+    ~BusTraceRecorder();
+
+    BusTraceRecorder(const BusTraceRecorder&) = delete;
+    BusTraceRecorder &operator=(const BusTraceRecorder&) = delete;
+
+public:
+    /// Create the trace file and start the recording.
+    ///
+    /// @param path The path to the trace file. An existing file is replaced.
+    /// @return The call status.
+    ///
+    Status open(const std::filesystem::path &path);
+
+    /// Write the remaining records and close the file.
+    ///
+    void close();
+
+    /// Record one transfer.
+    ///
+    /// @param direction The direction of the transfer.
+    /// @param address The chip address.
+    /// @param data The transferred data.
+    /// @param size The number of bytes.
+    /// @param error The error number of a failed transfer, zero on success.
+    ///
+    void record(BusTrace::Direction direction, uint8_t address, const uint8_t *data, int size, int error) noexcept;
+
+    /// Write all buffered records to the file.
+    ///
+    /// @return The call status.
+    ///
+    Status flush();
+
+    /// Write the buffered records, if at least half of the ring is used.
+    ///
+    /// Call this outside of the transfers, e.g. at the end of a transaction.
+    ///
+    /// @return The call status.
+    ///
+    Status flushIfDue();
+
+    /// Get the number of records dropped because the ring was full.
+    ///
+    uint64_t getDroppedCount() const;
+
+private:
+    int _fd; ///< The file descriptor of the trace file.
+    Clock::time_point _startTime; ///< The time the recording started.
+    std::vector<BusTrace::Record> _ring; ///< The preallocated record ring.
+    std::size_t _readPosition; ///< The position of the next record to write to the file.
+    std::size_t _writePosition; ///< The position for the next recorded transfer.
+    uint64_t _droppedCount; ///< The number of records dropped because the ring was full.
+};
+
+
+/// Replays the transfers from a trace file.
+///
+/// Each write on the bus is matched with the next record in the trace, and each read
+/// returns the recorded data. Failed transfers fail again with the recorded error number.
+/// The replay waits for the recorded time of each transfer, divided by the speed factor.
+///
+class BusTraceReplayer : public BusBackend
+{
+public:
+    using Status = CallStatus;
+    using Clock = std::chrono::steady_clock;
+
+public:
+    /// ctor
+    ///
+    BusTraceReplayer();
+
+public:
+    /// Load a trace file.
+    ///
+    /// @param path The path to the trace file.
+    /// @return The call status.
+    ///
+    Status open(const std::filesystem::path &path);
+
+    /// Set the speed of the replay.
+    ///
+    /// @param speed The speed factor. 1 replays with the recorded timing, zero without any delays.
+    ///
+    void setSpeed(double speed);
+
+    /// Set a function which is called if a transfer is beyond the end of the trace.
+    ///
+    /// @param handler The handler function.
+    ///
+    void setEndHandler(std::function<void()> handler);
+
+    /// Replay a write.
+    ///
+    int write(uint8_t address, const uint8_t *data, int size) override;
+
+    /// Replay a read.
+    ///
+    int read(uint8_t address, uint8_t *data, int size) override;
+
+    /// Check if all records were replayed.
+    ///
+    bool isAtEnd() const;
+
+private:
+    /// Get the next record for a transfer and wait for its time.
+    ///
+    /// @return The record, or `nullptr` if the transfer does not match the trace.
+    ///
+    const BusTrace::Record *nextRecord(BusTrace::Direction direction, uint8_t address, int size);
+
+private:
+    std::vector<BusTrace::Record> _records; ///< The loaded records.
+    std::size_t _position; ///< The position of the next record.
+    double _speed; ///< The speed factor.
+    Clock::time_point _startTime; ///< The time the replay started.
+    std::function<void()> _endHandler; ///< The function called at the end of the trace.
+};
+
+
+}
+
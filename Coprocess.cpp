@@ -0,0 +1,252 @@
+//
+// (c)2020 by Lucky Resistor. See LICENSE for details.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+#include "Coprocess.hpp"
+
+
+#include "I2CBus.hpp"
+#include "MeasurementFormat.hpp"
+#include "StatusMessage.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+
+
+namespace lr {
+
+
+void Coprocess::AnswerBuffer::clear() noexcept
+{
+    _text.clear();
+}
+
+
+const std::string &Coprocess::AnswerBuffer::getText() const noexcept
+{
+    return _text;
+}
+
+
+int Coprocess::AnswerBuffer::overflow(int c)
+{
+    if (c != traits_type::eof()) {
+        _text.push_back(static_cast<char>(c));
+    }
+    return c;
+}
+
+
+std::streamsize Coprocess::AnswerBuffer::xsputn(const char *data, std::streamsize count)
+{
+    _text.append(data, static_cast<std::size_t>(count));
+    return count;
+}
+
+
+Coprocess::Coprocess(SGP30 &sensor, BaselineStore &baselineStore, std::istream &input, std::ostream &output)
+:
+    _sensor(sensor),
+    _baselineStore(baselineStore),
+    _input(input),
+    _output(output),
+    _answerBuffer(),
+    _answer(&_answerBuffer),
+    _line()
+{
+}
+
+
+void Coprocess::run()
+{
+    while (std::getline(_input, _line)) {
+        _answerBuffer.clear();
+        if (!handleLine(_line)) {
+            break;
+        }
+        if (_answerBuffer.getText().empty()) {
+            continue; // an empty line.
+        }
+        _answer << '\n';
+        const auto &text = _answerBuffer.getText();
+        _output.write(text.data(), static_cast<std::streamsize>(text.size()));
+        _output.flush();
+    }
+}
+
+
+bool Coprocess::handleLine(const std::string &line)
+{
+    const auto commandStart = line.find_first_not_of(" \t\r");
+    if (commandStart == std::string::npos) {
+        return true;
+    }
+    auto commandEnd = line.find_first_of(" \t\r", commandStart);
+    if (commandEnd == std::string::npos) {
+        commandEnd = line.size();
+    }
+    const auto isCommand = [&](const char *command) -> bool {
+        return line.compare(commandStart, commandEnd - commandStart, command) == 0;
+    };
+    if (isCommand("read")) {
+        handleRead();
+    } else if (isCommand("serial")) {
+        handleSerial();
+    } else if (isCommand("init")) {
+        handleInit();
+    } else if (isCommand("baseline-store")) {
+        handleStoreBaseline();
+    } else if (isCommand("baseline-restore")) {
+        handleRestoreBaseline();
+    } else if (isCommand("humidity")) {
+        handleHumidity(line.c_str() + commandEnd);
+    } else if (isCommand("quit")) {
+        return false;
+    } else {
+        writeError("run the command", "Unknown command.");
+    }
+    return true;
+}
+
+
+void Coprocess::handleInit()
+{
+    if (const auto status = _sensor.initializeMeasurements(); hasError(status)) {
+        writeError("initialize the measurements", getStatusMessage(status, _sensor.getErrorDetail(status)));
+        return;
+    }
+    writeStatus("init_success");
+}
+
+
+void Coprocess::handleRead()
+{
+    const auto readResult = _sensor.readMeasurements();
+    if (hasError(readResult)) {
+        writeError("read the measurements", getStatusMessage(readResult));
+        return;
+    }
+    const auto [co2, tvoc] = readResult.getValue();
+    writeMeasurementJson(_answer, MeasurementRecord{co2, tvoc});
+}
+
+
+void Coprocess::handleSerial()
+{
+    const auto serialResult = _sensor.readSerialNumberValue();
+    if (hasError(serialResult)) {
+        writeError("read the serial number", getStatusMessage(serialResult));
+        return;
+    }
+    _answer << R"({ "serial_number": ")" << std::hex << std::setw(12) << std::setfill('0') << serialResult.getValue()
+        << std::dec << std::setfill(' ') << "\" }";
+}
+
+
+void Coprocess::handleStoreBaseline()
+{
+    const I2CBus::Transaction transaction(_sensor.getBus());
+    if (hasError(transaction.getStatus())) {
+        writeError("lock the bus", getStatusMessage(transaction.getStatus()));
+        return;
+    }
+    const auto serialResult = _sensor.readSerialNumberValue();
+    if (hasError(serialResult)) {
+        writeError("read the serial number", getStatusMessage(serialResult));
+        return;
+    }
+    const auto baselineResult = _sensor.getIAQBaseline();
+    if (hasError(baselineResult)) {
+        writeError("read the baseline", getStatusMessage(baselineResult));
+        return;
+    }
+    if (hasError(_baselineStore.store(serialResult.getValue(), baselineResult.getValue()))
+        || hasError(_baselineStore.sync())) {
+        writeError("store the baseline", "Could not write the state journal.");
+        return;
+    }
+    writeStatus("store_successful");
+}
+
+
+void Coprocess::handleRestoreBaseline()
+{
+    const I2CBus::Transaction transaction(_sensor.getBus());
+    if (hasError(transaction.getStatus())) {
+        writeError("lock the bus", getStatusMessage(transaction.getStatus()));
+        return;
+    }
+    const auto serialResult = _sensor.readSerialNumberValue();
+    if (hasError(serialResult)) {
+        writeError("read the serial number", getStatusMessage(serialResult));
+        return;
+    }
+    const auto entryResult = _baselineStore.find(serialResult.getValue());
+    if (hasError(entryResult)) {
+        writeError("restore the baseline", "Found no stored baseline for this sensor.");
+        return;
+    }
+    const auto entry = entryResult.getValue();
+    if (const auto status = _sensor.setIAQBaseline(std::make_tuple(entry.co2Baseline, entry.tvocBaseline)); hasError(status)) {
+        writeError("set the baseline values", getStatusMessage(status, _sensor.getErrorDetail(status)));
+        return;
+    }
+    writeStatus("restore_successful");
+}
+
+
+void Coprocess::handleHumidity(const char *arguments)
+{
+    char *end = nullptr;
+    const auto temperature = std::strtod(arguments, &end);
+    const bool hasTemperature = (end != arguments);
+    const char *humidityStart = end;
+    const auto humidity = std::strtod(humidityStart, &end);
+    if (!hasTemperature || end == humidityStart) {
+        writeError("set the humidity compensation", "Expected the temperature and the relative humidity.");
+        return;
+    }
+    if (const auto status = _sensor.setHumidityCompensation(temperature, humidity); hasError(status)) {
+        writeError("set the humidity compensation", getStatusMessage(status, _sensor.getErrorDetail(status)));
+        return;
+    }
+    writeStatus("humidity_set");
+}
+
+
+void Coprocess::writeError(const char *action, const std::string &message)
+{
+    _answer << R"({ "status": "error", "message": "Failed to )" << action << ". ";
+    for (const auto c : message) {
+        if (c == '"' || c == '\\') {
+            _answer << '\\' << c;
+        } else if (static_cast<unsigned char>(c) >= 0x20) {
+            _answer << c;
+        }
+    }
+    _answer << "\" }";
+}
+
+
+void Coprocess::writeStatus(const char *status)
+{
+    _answer << R"({ "status": ")" << status << "\" }";
+}
+
+
+}
+
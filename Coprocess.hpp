@@ -0,0 +1,145 @@
+#pragma once
+//
+// (c)2020 by Lucky Resistor. See LICENSE for details.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+
+
+#include "BaselineStore.hpp"
+#include "SGP30.hpp"
+
+#include <istream>
+#include <ostream>
+#include <streambuf>
+#include <string>
+
+
+namespace lr {
+
+
+/// A command session for a supervising process, over the standard input and output.
+///
+/// The session keeps the bus and the sensor open, reads one command per line and answers
+/// each command with one JSON line. The answers are formatted into a reusable buffer and
+/// written with a single flush. The supported commands are:
+///
+/// - `init`: Initialize the measurements.
+/// - `read`: Read the measurements.
+/// - `serial`: Read the serial number.
+/// - `baseline-store`: Store the current baseline of the sensor.
+/// - `baseline-restore`: Restore the stored baseline of the sensor.
+/// - `humidity <T> <RH>`: Set the humidity compensation, in celsius and percent.
+/// - `quit`: End the session.
+///
+/// A failed command is answered with `{ "status": "error", "message": "..." }`.
+///
+class Coprocess
+{
+public:
+    /// Create a new session.
+    ///
+    /// @param sensor The sensor, with an open bus.
+    /// @param baselineStore The opened store for the baseline values.
+    /// @param input The stream with the commands.
+    /// @param output The stream for the answers.
+    ///
+    Coprocess(SGP30 &sensor, BaselineStore &baselineStore, std::istream &input, std::ostream &output);
+
+public:
+    /// Handle commands, until `quit` or the end of the input.
+    ///
+    void run();
+
+private:
+    /// A stream buffer which appends to a string, which keeps its capacity.
+    ///
+    class AnswerBuffer : public std::streambuf
+    {
+    public:
+        /// Remove the text, but keep the allocated memory.
+        ///
+        void clear() noexcept;
+
+        /// Access the text.
+        ///
+        const std::string &getText() const noexcept;
+
+    protected:
+        int overflow(int c) override;
+        std::streamsize xsputn(const char *data, std::streamsize count) override;
+
+    private:
+        std::string _text; ///< The text of the answer.
+    };
+
+private:
+    /// Handle one command line.
+    ///
+    /// @param line The command line.
+    /// @return `false` if the session shall end.
+    ///
+    bool handleLine(const std::string &line);
+
+    /// Handle the `init` command.
+    ///
+    void handleInit();
+
+    /// Handle the `read` command.
+    ///
+    void handleRead();
+
+    /// Handle the `serial` command.
+    ///
+    void handleSerial();
+
+    /// Handle the `baseline-store` command.
+    ///
+    void handleStoreBaseline();
+
+    /// Handle the `baseline-restore` command.
+    ///
+    void handleRestoreBaseline();
+
+    /// Handle the `humidity` command.
+    ///
+    /// @param arguments The arguments of the command.
+    ///
+    void handleHumidity(const char *arguments);
+
+    /// Write an error answer.
+    ///
+    /// @param action The failed action.
+    /// @param message The message with the details.
+    ///
+    void writeError(const char *action, const std::string &message);
+
+    /// Write a status answer.
+    ///
+    void writeStatus(const char *status);
+
+private:
+    SGP30 &_sensor; ///< The sensor.
+    BaselineStore &_baselineStore; ///< The store for the baseline values.
+    std::istream &_input; ///< The stream with the commands.
+    std::ostream &_output; ///< The stream for the answers.
+    AnswerBuffer _answerBuffer; ///< The reusable buffer for the answers.
+    std::ostream _answer; ///< The stream to format the answers.
+    std::string _line; ///< The reusable buffer for the command lines.
+};
+
+
+}
+
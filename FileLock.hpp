@@ -0,0 +1,46 @@
+#pragma once
+//
+// (c)2020 by Lucky Resistor. See LICENSE for details.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+
+
+#include <sys/file.h>
+#include <cerrno>
+
+
+namespace lr {
+
+
+/// Apply a `flock()` operation, retrying if it is interrupted by a signal.
+///
+/// @param fd The file descriptor.
+/// @param operation The operation, like `LOCK_EX` or `LOCK_UN`.
+/// @return `true` on success, `false` on any error, with the error number in `errno`.
+///
+inline bool applyFileLock(int fd, int operation) noexcept
+{
+    while (flock(fd, operation) < 0) {
+        if (errno != EINTR) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+}
+
@@ -0,0 +1,189 @@
+//
+// (c)2020 by Lucky Resistor. See LICENSE for details.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+#include "HumidityFeed.hpp"
+
+
+#include <poll.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+
+
+namespace lr {
+
+
+HumidityFeed::HumidityFeed()
+    : _source(), _fd(-1), _wakeupPipe{-1, -1}, _thread(), _latestValues(cNoValues)
+{
+}
+
+
+HumidityFeed::~HumidityFeed()
+{
+    stop();
+}
+
+
+HumidityFeed::Status HumidityFeed::start(const std::string &source)
+{
+    stop();
+    _source = source;
+    if (!openSource()) {
+        std::cerr << "Failed to open the humidity feed: " << source << std::endl;
+        return Status::Error;
+    }
+    if (pipe2(_wakeupPipe, O_CLOEXEC) < 0) {
+        std::cerr << "Failed to create the wakeup pipe for the humidity feed." << std::endl;
+        return Status::Error;
+    }
+    _thread = std::thread(&HumidityFeed::readLoop, this);
+    return Status::Success;
+}
+
+
+void HumidityFeed::stop()
+{
+    if (_thread.joinable()) {
+        const char wakeup = 0;
+        if (write(_wakeupPipe[1], &wakeup, 1) < 0) {
+            // the thread will stop with the next input.
+        }
+        _thread.join();
+    }
+    for (int &fd : _wakeupPipe) {
+        if (fd >= 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    if (_fd > STDIN_FILENO) {
+        close(_fd);
+    }
+    _fd = -1;
+}
+
+
+HumidityFeed::ValuesResult HumidityFeed::getLatest() const noexcept
+{
+    const auto packedValues = _latestValues.load(std::memory_order_acquire);
+    if (packedValues == cNoValues) {
+        return ValuesResult::error();
+    }
+    return ValuesResult::success(std::make_tuple(
+        static_cast<int32_t>(static_cast<uint32_t>(packedValues >> 32)),
+        static_cast<int32_t>(static_cast<uint32_t>(packedValues & 0xffffffffu))));
+}
+
+
+HumidityFeed::ValuesResult HumidityFeed::parseLine(const std::string &line)
+{
+    const char *begin = line.c_str();
+    char *end = nullptr;
+    const double temperature = std::strtod(begin, &end);
+    if (end == begin) {
+        return ValuesResult::error();
+    }
+    begin = end;
+    while (*begin == ' ' || *begin == '\t' || *begin == ',') {
+        ++begin;
+    }
+    const double humidity = std::strtod(begin, &end);
+    if (end == begin) {
+        return ValuesResult::error();
+    }
+    if (!(temperature >= -100.0 && temperature <= 100.0 && humidity >= 0.0 && humidity <= 100.0)) {
+        return ValuesResult::error();
+    }
+    return ValuesResult::success(std::make_tuple(
+        static_cast<int32_t>(std::lround(temperature * 1000.0)),
+        static_cast<int32_t>(std::lround(humidity * 1000.0))));
+}
+
+
+void HumidityFeed::readLoop()
+{
+    std::string line;
+    char buffer[256];
+    while (true) {
+        pollfd pollFds[2] = {{_fd, POLLIN, 0}, {_wakeupPipe[0], POLLIN, 0}};
+        if (poll(pollFds, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+        if (pollFds[1].revents != 0) {
+            return; // stop requested.
+        }
+        const auto size = read(_fd, buffer, sizeof(buffer));
+        if (size < 0) {
+            if (errno == EINTR || errno == EAGAIN) {
+                continue;
+            }
+            return;
+        }
+        if (size == 0) {
+            // The writer closed a named pipe, wait for the next writer.
+            if (_fd == STDIN_FILENO) {
+                return;
+            }
+            close(_fd);
+            if (!openSource()) {
+                return;
+            }
+            continue;
+        }
+        for (ssize_t i = 0; i < size; ++i) {
+            if (buffer[i] == '\n') {
+                if (const auto result = parseLine(line); isSuccessful(result)) {
+                    _latestValues.store(packValues(result.getValue()), std::memory_order_release);
+                }
+                line.clear();
+            } else if (line.size() < 128) {
+                line.push_back(buffer[i]);
+            }
+        }
+    }
+}
+
+
+bool HumidityFeed::openSource()
+{
+    if (_source == "-") {
+        _fd = STDIN_FILENO;
+    } else {
+        // Open without blocking, so a named pipe without writer does not block the start.
+        _fd = open(_source.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    }
+    return _fd >= 0;
+}
+
+
+uint64_t HumidityFeed::packValues(const Values &values) noexcept
+{
+    const auto [temperature, humidity] = values;
+    return (static_cast<uint64_t>(static_cast<uint32_t>(temperature)) << 32)
+        | static_cast<uint64_t>(static_cast<uint32_t>(humidity));
+}
+
+
+}
+
@@ -0,0 +1,121 @@
+#pragma once
+//
+// (c)2020 by Lucky Resistor. See LICENSE for details.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+
+
+#include "StatusTools.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <tuple>
+
+
+namespace lr {
+
+
+/// A continuous feed of temperature and humidity values from an external source.
+///
+/// The feed reads lines in the format `<temperature> <humidity>` from the standard input
+/// or a named pipe, in celsius and percent. A background thread parses the lines and stores
+/// the latest values in a lock-free slot. Readers never block, they always get the latest
+/// complete pair of values.
+///
+class HumidityFeed
+{
+public:
+    using Status = CallStatus;
+
+    /// The temperature in 1/1000 celsius and relative humidity in 1/1000 percent.
+    ///
+    using Values = std::tuple<int32_t, int32_t>;
+
+    /// The result with the latest values.
+    ///
+    using ValuesResult = StatusResult<Values>;
+
+public:
+    /// ctor
+    ///
+    HumidityFeed();
+
+    /// dtor
+    ///
+    /// Stops the feed.
+    ///
+    ~HumidityFeed();
+
+    HumidityFeed(const HumidityFeed&) = delete;
+    HumidityFeed &operator=(const HumidityFeed&) = delete;
+
+public:
+    /// Start reading the feed.
+    ///
+    /// @param source The path to a named pipe, or `-` for the standard input.
+    /// @return The call status.
+    ///
+    Status start(const std::string &source);
+
+    /// Stop reading the feed.
+    ///
+    void stop();
+
+    /// Get the latest values.
+    ///
+    /// @return The latest values, or an error if no values were received yet.
+    ///
+    ValuesResult getLatest() const noexcept;
+
+    /// Parse one line of the feed.
+    ///
+    /// @param line The line to parse.
+    /// @return The parsed values, or an error if the line is invalid.
+    ///
+    static ValuesResult parseLine(const std::string &line);
+
+private:
+    /// The thread function reading the feed.
+    ///
+    void readLoop();
+
+    /// Open the source of the feed.
+    ///
+    /// @return `true` on success.
+    ///
+    bool openSource();
+
+    /// Pack the values into the slot format.
+    ///
+    static uint64_t packValues(const Values &values) noexcept;
+
+private:
+    static constexpr uint64_t cNoValues = UINT64_MAX; ///< The slot value if there are no values.
+
+    std::string _source; ///< The source of the feed.
+    int _fd; ///< The file descriptor of the source.
+    int _wakeupPipe[2]; ///< The pipe to wake up the thread for stopping.
+    std::thread _thread; ///< The thread reading the feed.
+    std::atomic<uint64_t> _latestValues; ///< The latest values, packed into one word.
+
+    static_assert(std::atomic<uint64_t>::is_always_lock_free, "Lock free atomics required.");
+};
+
+
+}
+
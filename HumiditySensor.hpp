@@ -0,0 +1,57 @@
+#pragma once
+//
+// (c)2020 by Lucky Resistor. See LICENSE for details.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+
+
+#include "SensirionSensor.hpp"
+
+
+namespace lr {
+
+
+/// The shared interface of the Sensirion temperature and humidity sensors.
+///
+/// The readings of these sensors are used for the humidity compensation of the SGP30.
+///
+class HumiditySensor : public SensirionSensor
+{
+public:
+    /// The measurement values.
+    ///
+    /// The first value is the temperature in celsius, the second value the relative humidity in percent.
+    ///
+    using MeasurementResult = StatusResult<std::tuple<double, double>>;
+
+public:
+    using SensirionSensor::SensirionSensor;
+
+    /// dtor
+    ///
+    ~HumiditySensor() override = default;
+
+public:
+    /// Make a single measurement of the temperature and humidity.
+    ///
+    /// @return The temperature in celsius and the relative humidity in percent.
+    ///
+    virtual MeasurementResult readTemperatureAndHumidity() = 0;
+};
+
+
+}
+
@@ -22,33 +22,45 @@
 #include <fcntl.h>
 #include <sys/ioctl.h>
 #include <linux/i2c-dev.h>
+#include <algorithm>
+#include <cerrno>
 #include <cstring>
 #include <chrono>
 #include <thread>
 #include <cstdint>
-#include <iostream>
-#include <iomanip>
 #include <sstream>
 
 
 namespace lr {
 
 
-std::string I2CBus::_devicePathBase = "/dev/i2c-";
+template<typename DebugPolicy>
+std::string BasicI2CBus<DebugPolicy>::_devicePathBase = "/dev/i2c-";
 
 
-I2CBus::I2CBus(uint8_t chipAddress, int busId)
+template<typename DebugPolicy>
+BasicI2CBus<DebugPolicy>::BasicI2CBus(uint8_t chipAddress, int busId)
 :
     _chipAddress(chipAddress),
+    _lastChipAddress(chipAddress),
     _busId(busId),
     _isOpen(false),
     _debugging(false),
-    _i2cFd(0)
+    _i2cFd(0),
+    _transactionDepth(0),
+    _busLock(),
+    _statistics(),
+    _traceRecorder(nullptr),
+    _backend(nullptr),
+    _lastErrorDetail(0),
+    _muxAddress(0),
+    _muxChannel(0)
 {
 }
 
 
-I2CBus::~I2CBus()
+template<typename DebugPolicy>
+BasicI2CBus<DebugPolicy>::~BasicI2CBus()
 {
     if (isOpen()) {
         closeBus();
@@ -56,40 +68,93 @@ I2CBus::~I2CBus()
 }
 
 
-void I2CBus::setDebugging(bool enabled)
+template<typename DebugPolicy>
+void BasicI2CBus<DebugPolicy>::setDebugging(bool enabled)
 {
     _debugging = enabled;
 }
 
 
-I2CBus::Status I2CBus::openBus()
+template<typename DebugPolicy>
+void BasicI2CBus<DebugPolicy>::setTraceRecorder(BusTraceRecorder *recorder)
 {
-    if (_debugging) {
-        std::cout << "# Open the bus." << std::endl;
+    _traceRecorder = recorder;
+}
+
+
+template<typename DebugPolicy>
+void BasicI2CBus<DebugPolicy>::setBackend(BusBackend *backend)
+{
+    _backend = backend;
+}
+
+
+template<typename DebugPolicy>
+bool BasicI2CBus<DebugPolicy>::hasBackend() const
+{
+    return _backend != nullptr;
+}
+
+
+template<typename DebugPolicy>
+void BasicI2CBus<DebugPolicy>::setMuxChannel(uint8_t muxAddress, uint8_t channel)
+{
+    _muxAddress = muxAddress;
+    _muxChannel = channel;
+}
+
+
+template<typename DebugPolicy>
+typename BasicI2CBus<DebugPolicy>::Status BasicI2CBus<DebugPolicy>::openBus()
+{
+    if constexpr (DebugPolicy::cEnabled) {
+        if (_debugging) {
+            DebugPolicy::writeMessage("Open the bus.");
+        }
+    }
+    if (_backend != nullptr) {
+        _backend->open();
+        _lastChipAddress = _chipAddress;
+        _isOpen = true;
+        return Status::Success;
     }
     const auto devicePath = getDevicePath();
     _i2cFd = open(devicePath.c_str(), O_RDWR);
     if (_i2cFd < 0) {
-        std::cerr << "Failed to open the I2C bus device. Path: " << devicePath << std::endl;
-        return Status::Error;
+        _lastErrorDetail = toErrorDetail(errno);
+        return Status::IoError;
     }
+    _statistics.ioctlCalls += 1;
     if (ioctl(_i2cFd, I2C_SLAVE, _chipAddress) < 0) {
-        std::cerr << "Failed to configure the I2C bus device." << std::endl;
-        writeIoError();
-        return Status::Error;
+        _lastErrorDetail = toErrorDetail(errno);
+        close(_i2cFd);
+        return Status::IoError;
     }
+    _lastChipAddress = _chipAddress;
+    _busLock.setFileDescriptor(_i2cFd);
     _isOpen = true;
     return Status::Success;
 }
 
 
-I2CBus::Status I2CBus::closeBus()
+template<typename DebugPolicy>
+typename BasicI2CBus<DebugPolicy>::Status BasicI2CBus<DebugPolicy>::closeBus()
 {
     if (_isOpen) {
-        if (_debugging) {
-            std::cout << "# Close the bus." << std::endl;
+        if constexpr (DebugPolicy::cEnabled) {
+            if (_debugging) {
+                DebugPolicy::writeMessage("Close the bus.");
+            }
+        }
+        if (_backend != nullptr && _transactionDepth > 0) {
+            _backend->endTransaction();
+        }
+        _busLock.release();
+        _busLock.setFileDescriptor(-1);
+        _transactionDepth = 0;
+        if (_backend == nullptr) {
+            close(_i2cFd);
         }
-        close(_i2cFd);
         _i2cFd = 0;
         _isOpen = false;
     }
@@ -97,122 +162,262 @@ I2CBus::Status I2CBus::closeBus()
 }
 
 
-bool I2CBus::isOpen() const
+template<typename DebugPolicy>
+bool BasicI2CBus<DebugPolicy>::isOpen() const
 {
     return _isOpen;
 }
 
 
-I2CBus::Status I2CBus::readData(uint8_t *data, int size)
+template<typename DebugPolicy>
+typename BasicI2CBus<DebugPolicy>::Status BasicI2CBus<DebugPolicy>::readData(uint8_t *data, int size)
+{
+    return readData(_chipAddress, data, size);
+}
+
+
+template<typename DebugPolicy>
+typename BasicI2CBus<DebugPolicy>::Status BasicI2CBus<DebugPolicy>::writeData(const uint8_t *data, int size)
+{
+    return writeData(_chipAddress, data, size);
+}
+
+
+template<typename DebugPolicy>
+typename BasicI2CBus<DebugPolicy>::Status BasicI2CBus<DebugPolicy>::readData(uint8_t address, uint8_t *data, int size)
 {
     if (!isOpen()) {
-        std::cerr << "Call to readData() in closed state." << std::endl;
         return Status::Error;
     }
-    if (hasError(switchChipAddress(_chipAddress))) {
-        return Status::Error;
-    }
-    if (read(_i2cFd, data, size) != size) {
-        std::cerr << "Failed to read from the bus." << std::endl;
-        writeIoError();
-        return Status::Error;
+    const Transaction transaction(this);
+    if (hasError(transaction.getStatus())) {
+        return transaction.getStatus();
     }
-    if (_debugging) {
-        std::cout << "# Read " << size << " bytes from the bus: ";
-        for (int i = 0; i < size; ++i) {
-            if (i != 0) {
-                std::cout << ", ";
+    _statistics.reads += 1;
+    int error;
+    ssize_t received = -1;
+    if (_backend != nullptr) {
+        error = _backend->read(address, data, size);
+    } else {
+        error = switchChipAddress(address);
+        if (error == 0) {
+            if (received = read(_i2cFd, data, size); received != size) {
+                error = (received < 0) ? errno : EIO;
             }
-            std::cout << "0x" << std::hex << std::setfill('0') << std::setw(2) << static_cast<int>(data[i]);
         }
-        std::cout << std::endl;
+    }
+    if (_traceRecorder != nullptr) {
+        _traceRecorder->record(BusTrace::Direction::Read, address, data, size, error);
+    }
+    if (error != 0) {
+        _statistics.errors += 1;
+        if (received >= 0) {
+            _lastErrorDetail = static_cast<uint8_t>(std::min<ssize_t>(received, 0xff));
+            return Status::ShortRead;
+        }
+        return getTransferErrorStatus(error);
+    }
+    _statistics.bytesRead += static_cast<uint64_t>(size);
+    if constexpr (DebugPolicy::cEnabled) {
+        if (_debugging) {
+            DebugPolicy::writeTransfer(BusTrace::Direction::Read, address, data, size);
+        }
     }
     return Status::Success;
 }
 
 
-I2CBus::Status I2CBus::writeData(const uint8_t *data, int size)
+template<typename DebugPolicy>
+std::string BasicI2CBus<DebugPolicy>::getDevicePath() const
+{
+    std::stringstream devicePath;
+    devicePath << _devicePathBase << _busId;
+    return devicePath.str();
+}
+
+
+template<typename DebugPolicy>
+typename BasicI2CBus<DebugPolicy>::Status BasicI2CBus<DebugPolicy>::writeData(uint8_t address, const uint8_t *data, int size)
 {
     if (!isOpen()) {
-        std::cerr << "Call to writeData() in closed state." << std::endl;
         return Status::Error;
     }
-    if (_debugging) {
-        std::cout << "# Write " << size << " bytes to the bus: ";
-        for (int i = 0; i < size; ++i) {
-            if (i != 0) {
-                std::cout << ", ";
+    const Transaction transaction(this);
+    if (hasError(transaction.getStatus())) {
+        return transaction.getStatus();
+    }
+    if constexpr (DebugPolicy::cEnabled) {
+        if (_debugging) {
+            DebugPolicy::writeTransfer(BusTrace::Direction::Write, address, data, size);
+        }
+    }
+    _statistics.writes += 1;
+    int error;
+    if (_backend != nullptr) {
+        error = _backend->write(address, data, size);
+    } else {
+        error = switchChipAddress(address);
+        if (error == 0) {
+            if (const auto result = write(_i2cFd, data, size); result != size) {
+                error = (result < 0) ? errno : EIO;
             }
-            std::cout << "0x" << std::hex << std::setfill('0') << std::setw(2) << static_cast<int>(data[i]);
         }
-        std::cout << std::endl;
     }
-    if (hasError(switchChipAddress(_chipAddress))) {
-        return Status::Error;
+    if (_traceRecorder != nullptr) {
+        _traceRecorder->record(BusTrace::Direction::Write, address, data, size, error);
     }
-    if (write(_i2cFd, data, size) != size) {
-        std::cerr << "Failed to write to the bus." << std::endl;
-        writeIoError();
-        return Status::Error;
+    if (error != 0) {
+        _statistics.errors += 1;
+        return getTransferErrorStatus(error);
     }
+    _statistics.bytesWritten += static_cast<uint64_t>(size);
     return Status::Success;
 }
 
 
-std::string I2CBus::getDevicePath() const
+template<typename DebugPolicy>
+uint8_t BasicI2CBus<DebugPolicy>::getLastErrorDetail() const
 {
-    std::stringstream devicePath;
-    devicePath << _devicePathBase << _busId;
-    return devicePath.str();
+    return _lastErrorDetail;
 }
 
 
-void I2CBus::writeIoError()
+template<typename DebugPolicy>
+typename BasicI2CBus<DebugPolicy>::Status BasicI2CBus<DebugPolicy>::getTransferErrorStatus(int error)
 {
-    std::cerr << "Error: " << strerror(errno) << " (errno=" << errno << ")" << std::endl;
+    _lastErrorDetail = toErrorDetail(error);
+    switch (error) {
+    case ENXIO:
+    case EREMOTEIO:
+        return Status::Nack; // The i2c drivers report a missing acknowledge with one of these.
+    case ETIMEDOUT:
+        return Status::Timeout;
+    default:
+        return Status::IoError;
+    }
 }
 
-I2CBus::Status I2CBus::writeData(uint8_t address, const uint8_t *data, int size)
+
+template<typename DebugPolicy>
+uint8_t BasicI2CBus<DebugPolicy>::toErrorDetail(int error)
 {
-    if (!isOpen()) {
-        std::cerr << "Call to writeData() in closed state." << std::endl;
-        return Status::Error;
+    return static_cast<uint8_t>(std::clamp(error, 0, 0xff));
+}
+
+
+template<typename DebugPolicy>
+typename BasicI2CBus<DebugPolicy>::Status BasicI2CBus<DebugPolicy>::beginTransaction()
+{
+    if (_transactionDepth > 0) {
+        _transactionDepth += 1;
+        return Status::Success;
     }
-    if (_debugging) {
-        std::cout << "# Write " << size << " bytes to the bus: ";
-        for (int i = 0; i < size; ++i) {
-            if (i != 0) {
-                std::cout << ", ";
-            }
-            std::cout << "0x" << std::hex << std::setfill('0') << std::setw(2) << static_cast<int>(data[i]);
+    if (_backend != nullptr) {
+        _backend->beginTransaction();
+    } else if (const auto status = _busLock.acquire(); hasError(status)) {
+        _lastErrorDetail = (status == Status::IoError) ? toErrorDetail(errno) : 0;
+        return status;
+    }
+    _transactionDepth = 1;
+    if (_muxAddress != 0) {
+        const uint8_t channelMask = static_cast<uint8_t>(1u << _muxChannel);
+        if (const auto status = writeData(_muxAddress, &channelMask, 1); hasError(status)) {
+            endTransaction();
+            return status;
         }
-        std::cout << std::endl;
     }
-    if (hasError(switchChipAddress(address))) {
-        return Status::Error;
+    return Status::Success;
+}
+
+
+template<typename DebugPolicy>
+void BasicI2CBus<DebugPolicy>::endTransaction()
+{
+    if (_transactionDepth > 0) {
+        _transactionDepth -= 1;
+        if (_transactionDepth == 0) {
+            if (_backend != nullptr) {
+                _backend->endTransaction();
+            } else {
+                _busLock.release();
+            }
+            if (_traceRecorder != nullptr) {
+                _traceRecorder->flushIfDue();
+            }
+        }
     }
-    if (write(_i2cFd, data, size) != size) {
-        std::cerr << "Failed to write to the bus." << std::endl;
-        writeIoError();
-        return Status::Error;
+}
+
+
+template<typename DebugPolicy>
+BusLock &BasicI2CBus<DebugPolicy>::getBusLock()
+{
+    return _busLock;
+}
+
+
+template<typename DebugPolicy>
+const BusStatistics &BasicI2CBus<DebugPolicy>::getStatistics() const
+{
+    return _statistics;
+}
+
+
+template<typename DebugPolicy>
+const BusLock &BasicI2CBus<DebugPolicy>::getBusLock() const
+{
+    return _busLock;
+}
+
+
+template<typename DebugPolicy>
+int BasicI2CBus<DebugPolicy>::getBusId() const
+{
+    return _busId;
+}
+
+
+template<typename DebugPolicy>
+BasicI2CBus<DebugPolicy>::Transaction::Transaction(BasicI2CBus *bus)
+    : _bus(bus), _status(bus->beginTransaction())
+{
+}
+
+
+template<typename DebugPolicy>
+BasicI2CBus<DebugPolicy>::Transaction::~Transaction()
+{
+    if (isSuccessful(_status)) {
+        _bus->endTransaction();
     }
-    return Status::Success;
 }
 
 
-I2CBus::Status I2CBus::switchChipAddress(uint8_t chipAddress)
+template<typename DebugPolicy>
+typename BasicI2CBus<DebugPolicy>::Status BasicI2CBus<DebugPolicy>::Transaction::getStatus() const
+{
+    return _status;
+}
+
+
+template<typename DebugPolicy>
+int BasicI2CBus<DebugPolicy>::switchChipAddress(uint8_t chipAddress)
 {
     if (_lastChipAddress != chipAddress) {
         _lastChipAddress = chipAddress;
+        _statistics.addressSwitches += 1;
+        _statistics.ioctlCalls += 1;
         if (ioctl(_i2cFd, I2C_SLAVE, chipAddress) < 0) {
-            std::cerr << "Failed to configure the I2C bus device with a new chip address." << std::endl;
-            writeIoError();
-            return Status::Error;
+            return errno;
         }
     }
-    return Status::Success;
+    return 0;
 }
 
 
+template class BasicI2CBus<NoBusDebugging>;
+template class BasicI2CBus<StreamBusDebugging>;
+
+
 }
 
@@ -18,9 +18,15 @@
 //
 
 
+#include "BusBackend.hpp"
+#include "BusDebugPolicy.hpp"
+#include "BusLock.hpp"
+#include "BusStatistics.hpp"
+#include "BusTrace.hpp"
 #include "StatusTools.hpp"
 
 #include <string>
+#include <cerrno>
 #include <cstdint>
 
 
@@ -29,31 +35,103 @@ namespace lr {
 
 /// Wrapper around the quite complicated I2C bus implementation
 ///
-class I2CBus
+/// The debugging output is selected with a policy at compile time. With `NoBusDebugging`,
+/// all debugging code is removed from the bus communication.
+///
+/// @tparam DebugPolicy The debugging policy, `NoBusDebugging` or `StreamBusDebugging`.
+///
+template<typename DebugPolicy>
+class BasicI2CBus
 {
 public:
     using Status = CallStatus;
 
+    /// A scoped transaction on the bus.
+    ///
+    /// Keeps the cross-process bus lock for the lifetime of the object. Use it around
+    /// a command and the read of its response, so no other process can interleave
+    /// with the communication.
+    ///
+    class Transaction
+    {
+    public:
+        /// Begin a new transaction.
+        ///
+        /// @param bus The bus to use.
+        ///
+        explicit Transaction(BasicI2CBus *bus);
+
+        /// End the transaction.
+        ///
+        ~Transaction();
+
+        Transaction(const Transaction&) = delete;
+        Transaction &operator=(const Transaction&) = delete;
+
+        /// Get the status of the lock acquisition.
+        ///
+        /// @return The call status.
+        ///
+        Status getStatus() const;
+
+    private:
+        BasicI2CBus *_bus; ///< The bus.
+        Status _status; ///< The status from `beginTransaction()`.
+    };
+
 public:
     /// Create a new bus accessor.
     ///
-    explicit I2CBus(uint8_t chipAddress, int busId = 1);
+    explicit BasicI2CBus(uint8_t chipAddress, int busId = 1);
 
     /// dtor
     ///
     /// If the bus object is deconstructed while the bus is open, it is closed.
     ///
-    ~I2CBus();
+    ~BasicI2CBus();
 
 public:
     /// Enable or disable debugging mode.
     ///
     /// In this mode, every bus communication is dumped to the console for debugging.
+    /// Without a debugging policy, this call has no effect.
     ///
     void setDebugging(bool enabled);
 
+    /// Record all transfers into a trace.
+    ///
+    /// @param recorder The open recorder, or `nullptr` to stop recording.
+    ///
+    void setTraceRecorder(BusTraceRecorder *recorder);
+
+    /// Use a backend for the transfers instead of accessing the bus device.
+    ///
+    /// Set the backend before opening the bus. With a backend, like a trace replay or
+    /// a simulation, the bus device is not opened and the cross-process bus lock is not used.
+    /// Instead, the backend is notified about the begin and end of each transaction.
+    ///
+    /// @param backend The backend, or `nullptr` to access the bus device.
+    ///
+    void setBackend(BusBackend *backend);
+
+    /// Check if the transfers are handled by a backend.
+    ///
+    bool hasBackend() const;
+
+    /// Select a channel of a TCA9548 multiplexer for all transfers.
+    ///
+    /// The channel is written to the multiplexer at the begin of each outermost transaction,
+    /// while the bus is locked, because other processes may select different channels.
+    ///
+    /// @param muxAddress The address of the multiplexer, or zero to disable the selection.
+    /// @param channel The channel of the multiplexer, 0-7.
+    ///
+    void setMuxChannel(uint8_t muxAddress, uint8_t channel);
+
     /// Open the bus.
     ///
+    /// If the bus device can not be opened, `IoError` is returned, with the error number as detail.
+    ///
     /// @return The status of the call.
     ///
     Status openBus();
@@ -72,6 +150,9 @@ public:
 
     /// Write data to the I2C bus.
     ///
+    /// A failed transfer returns `Nack`, `Timeout`, `IoError` or `ShortRead`, or the status
+    /// of the bus lock. Use `getLastErrorDetail()` to get the detail of the error.
+    ///
     /// @param data The data to write.
     /// @param size The size of the data to write.
     /// @return The status of the call.
@@ -80,6 +161,8 @@ public:
 
     /// Read data from the I2C bus.
     ///
+    /// See `writeData()` for the status of a failed transfer.
+    ///
     /// @param data The buffer to read data into it.
     /// @param size The number of bytes to read.
     /// @return The status of the call.
@@ -95,18 +178,75 @@ public:
     ///
     Status writeData(uint8_t address, const uint8_t *data, int size);
 
+    /// Read data from a different address on the I2C bus.
+    ///
+    /// @param address The address to use.
+    /// @param data The buffer to read data into it.
+    /// @param size The number of bytes to read.
+    /// @return The status of the call.
+    ///
+    Status readData(uint8_t address, uint8_t *data, int size);
+
+    /// Get the detail of the last failed call.
+    ///
+    /// @return The error number for `Nack`, `Timeout` and `IoError`, or the number of
+    ///     received bytes for `ShortRead`.
+    ///
+    uint8_t getLastErrorDetail() const;
+
+    /// Begin a transaction.
+    ///
+    /// Acquires the cross-process bus lock and selects the multiplexer channel. Transactions
+    /// can be nested, only the outermost call locks the bus. Reads and writes outside of a transaction lock
+    /// the bus for the single call.
+    ///
+    /// @return The call status.
+    ///
+    Status beginTransaction();
+
+    /// End a transaction.
+    ///
+    void endTransaction();
+
+    /// Access the bus lock.
+    ///
+    /// Use this to configure the lock policy and timeout, and to read the statistics.
+    ///
+    BusLock &getBusLock();
+
+    /// Access the statistics of the bus.
+    ///
+    const BusStatistics &getStatistics() const;
+
+    /// Access the bus lock.
+    ///
+    const BusLock &getBusLock() const;
+
+    /// Get the bus id.
+    ///
+    int getBusId() const;
+
 private:
     /// Get the device path.
     ///
     [[nodiscard]] std::string getDevicePath() const;
 
-    /// Write an IO error to cerr
+    /// Get the status for a failed transfer and keep the error number as detail.
     ///
-    static void writeIoError();
+    /// @param error The error number.
+    /// @return The status for the error.
+    ///
+    Status getTransferErrorStatus(int error);
+
+    /// Convert an error number into an error detail.
+    ///
+    static uint8_t toErrorDetail(int error);
 
     /// Switch the device to the given address.
     ///
-    Status switchChipAddress(uint8_t chipAddress);
+    /// @return The error number, zero on success.
+    ///
+    int switchChipAddress(uint8_t chipAddress);
 
 private:
     static std::string _devicePathBase; ///< The base path for the I2C device.
@@ -116,8 +256,21 @@ private:
     bool _isOpen; ///< Flag if the bus is open.
     bool _debugging; ///< Flag if debugging the bus is enabled.
     int _i2cFd; ///< The I2C file descriptor.
+    int _transactionDepth; ///< The nesting depth of transactions.
+    BusLock _busLock; ///< The cross-process bus lock.
+    BusStatistics _statistics; ///< The statistics of the bus.
+    BusTraceRecorder *_traceRecorder; ///< The optional trace recorder.
+    BusBackend *_backend; ///< The optional backend, replacing the bus device.
+    uint8_t _lastErrorDetail; ///< The detail of the last failed call.
+    uint8_t _muxAddress; ///< The address of the multiplexer, zero if not used.
+    uint8_t _muxChannel; ///< The selected channel of the multiplexer.
 };
 
 
+/// The bus with the debugging policy selected at compile time.
+///
+using I2CBus = BasicI2CBus<BusDebugPolicy>;
+
+
 }
 
@@ -0,0 +1,397 @@
+//
+// (c)2020 by Lucky Resistor. See LICENSE for details.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+
+
+#include "BaselineStore.hpp"
+#include "BusBackend.hpp"
+#include "BusStatistics.hpp"
+#include "I2CBus.hpp"
+#include "Sampler.hpp"
+#include "SGP30.hpp"
+#include "SimulatedBus.hpp"
+
+#include <sys/resource.h>
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+/// @file LoadGenerator.cpp
+/// A load generator, which runs many simulated SGP30 sensors through the sampler.
+///
+/// The sensors are distributed over a number of simulated buses and sampled by a number
+/// of threads, each with its own sampler, baseline store and output. For each combination
+/// of sensor and thread count, the tool writes one JSON line with the throughput, the
+/// latency of the samples and the CPU time per sample to `std::cout`.
+///
+
+
+namespace {
+
+
+using Clock = std::chrono::steady_clock;
+
+
+/// The options of the load generator.
+///
+struct Options {
+    std::vector<uint32_t> sensorCounts = {1, 8, 64, 256}; ///< The numbers of sensors to test.
+    std::vector<uint32_t> threadCounts = {1, 2, 4}; ///< The numbers of threads to test.
+    uint32_t busCount = 4; ///< The number of simulated buses.
+    uint32_t busClock = 0; ///< The clock of the simulated buses in Hz, zero for instant transfers.
+    std::chrono::milliseconds duration = std::chrono::milliseconds(1000); ///< The duration of each run.
+    std::chrono::milliseconds interval = std::chrono::milliseconds(0); ///< The sampling interval.
+    std::chrono::seconds baselineInterval = std::chrono::hours(1); ///< The interval to store the baselines.
+    std::filesystem::path outputDirectory; ///< The directory for the output, empty to discard it.
+};
+
+
+/// A stream buffer which discards all output.
+///
+class NullBuffer : public std::streambuf
+{
+protected:
+    int overflow(int c) override { return c; }
+    std::streamsize xsputn(const char*, std::streamsize count) override { return count; }
+};
+
+
+/// A simulated bus, shared by several sensors.
+///
+/// Only one transaction can use the bus at a time. With a bus clock, each transfer occupies
+/// the bus for the time to send the address and the data bytes.
+///
+struct SharedBus {
+    std::mutex mutex; ///< The mutex for the arbitration of the bus, held for a whole transaction.
+    std::chrono::nanoseconds byteTime; ///< The time to transfer one byte with its acknowledge bit.
+};
+
+
+/// A simulated SGP30 on a shared bus.
+///
+/// The sensor driver does not wait for results with a backend in real time, so the virtual
+/// sensor models the duration of each command: a read waits until the result of the last
+/// command is ready. As the shared bus is kept for the whole transaction, the bus stays busy
+/// during the measurement, like with the real sensor.
+///
+class VirtualSensor : public lr::BusBackend
+{
+public:
+    /// Create a new virtual sensor.
+    ///
+    /// @param sharedBus The bus of the sensor.
+    /// @param serialNumber The serial number of the sensor.
+    ///
+    VirtualSensor(SharedBus &sharedBus, uint64_t serialNumber)
+        : _sharedBus(sharedBus), _device(static_cast<uint32_t>(serialNumber)), _sensor(0), _resultTime()
+    {
+        _device.setSerialNumber(serialNumber);
+        _device.setMeasurements(450, 25);
+        _sensor.getBus()->setBackend(this);
+    }
+
+    /// Access the sensor.
+    ///
+    lr::SGP30 &getSensor() { return _sensor; }
+
+public: // BusBackend
+    void open() override { _device.open(); }
+
+    void beginTransaction() override { _sharedBus.mutex.lock(); }
+
+    void endTransaction() override { _sharedBus.mutex.unlock(); }
+
+    int write(uint8_t address, const uint8_t *data, int size) override
+    {
+        occupyBus(size);
+        if (size >= 2) {
+            const auto command = static_cast<uint16_t>((data[0] << 8) | data[1]);
+            _resultTime = Clock::now() + getCommandDuration(command);
+        }
+        return _device.write(address, data, size);
+    }
+
+    int read(uint8_t address, uint8_t *data, int size) override
+    {
+        std::this_thread::sleep_until(_resultTime);
+        occupyBus(size);
+        return _device.read(address, data, size);
+    }
+
+private:
+    /// Get the time until the result of a command is ready, as in the data sheet.
+    ///
+    static std::chrono::microseconds getCommandDuration(uint16_t command)
+    {
+        switch (command) {
+        case 0x2008: return std::chrono::milliseconds(12); // measure_iaq
+        case 0x2050: return std::chrono::milliseconds(25); // measure_raw
+        case 0x2032: return std::chrono::milliseconds(220); // measure_test
+        case 0x3682: return std::chrono::microseconds(500); // get_serial_id
+        default: return std::chrono::milliseconds(10);
+        }
+    }
+
+    /// Occupy the bus for the time of a transfer.
+    ///
+    void occupyBus(int size)
+    {
+        if (_sharedBus.byteTime.count() > 0) {
+            std::this_thread::sleep_for(_sharedBus.byteTime * (size + 1));
+        }
+    }
+
+private:
+    SharedBus &_sharedBus; ///< The shared bus.
+    lr::SimulatedBus _device; ///< The simulated device.
+    lr::SGP30 _sensor; ///< The sensor driver.
+    Clock::time_point _resultTime; ///< The time the result of the last command is ready.
+};
+
+
+/// The result of one thread.
+///
+struct ThreadResult {
+    bool success = false; ///< If the sampler ran successfully.
+    lr::LatencyHistogram latency; ///< The latency of the samples.
+};
+
+
+/// Write the usage of the tool.
+///
+void writeUsage()
+{
+    std::cerr << "Usage: read_sgp30_load [options]\n";
+    std::cerr << " --sensors=<n>[,<n>...]       The numbers of virtual sensors. 1,8,64,256 is the default.\n";
+    std::cerr << " --threads=<n>[,<n>...]       The numbers of sampling threads. 1,2,4 is the default.\n";
+    std::cerr << " --buses=<n>                  The number of simulated buses. 4 is the default.\n";
+    std::cerr << " --bus-clock=<hz>             The clock of the simulated buses. 0, for instant transfers, is the default.\n";
+    std::cerr << " --duration=<ms>              The duration of each run. 1000 is the default.\n";
+    std::cerr << " --interval=<ms>              The sampling interval. 0, sampling as fast as possible, is the default.\n";
+    std::cerr << " --baseline-interval=<s>      The interval to store the baselines. 3600 is the default.\n";
+    std::cerr << " --output=<directory>         Write the measurements into files in this directory, instead of discarding them." << std::endl;
+}
+
+
+/// Parse a comma separated list of positive numbers.
+///
+/// @throws std::logic_error If the list is not valid.
+///
+std::vector<uint32_t> parseCounts(const std::string &text)
+{
+    std::vector<uint32_t> result;
+    std::size_t start = 0;
+    while (start <= text.size()) {
+        auto end = text.find(',', start);
+        if (end == std::string::npos) {
+            end = text.size();
+        }
+        const auto value = std::stoul(text.substr(start, end - start));
+        if (value == 0) {
+            throw std::out_of_range("zero count");
+        }
+        result.push_back(static_cast<uint32_t>(value));
+        start = end + 1;
+    }
+    return result;
+}
+
+
+/// Parse the command line.
+///
+/// @return `true` on success.
+///
+bool parseCommandLine(int argc, char **argv, Options &options)
+{
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg(argv[i]);
+        try {
+            if (arg.rfind("--sensors=", 0) == 0) {
+                options.sensorCounts = parseCounts(arg.substr(10));
+            } else if (arg.rfind("--threads=", 0) == 0) {
+                options.threadCounts = parseCounts(arg.substr(10));
+            } else if (arg.rfind("--buses=", 0) == 0) {
+                options.busCount = parseCounts(arg.substr(8)).at(0);
+            } else if (arg.rfind("--bus-clock=", 0) == 0) {
+                options.busClock = static_cast<uint32_t>(std::stoul(arg.substr(12)));
+            } else if (arg.rfind("--duration=", 0) == 0) {
+                options.duration = std::chrono::milliseconds(std::stoul(arg.substr(11)));
+            } else if (arg.rfind("--interval=", 0) == 0) {
+                options.interval = std::chrono::milliseconds(std::stoul(arg.substr(11)));
+            } else if (arg.rfind("--baseline-interval=", 0) == 0) {
+                options.baselineInterval = std::chrono::seconds(std::stoul(arg.substr(20)));
+            } else if (arg.rfind("--output=", 0) == 0) {
+                options.outputDirectory = arg.substr(9);
+            } else {
+                std::cerr << "Unknown argument: " << arg << std::endl;
+                return false;
+            }
+        } catch (const std::logic_error&) {
+            std::cerr << "Invalid value: " << arg << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+
+/// Get the CPU time used by the process.
+///
+std::chrono::microseconds getProcessCpuTime()
+{
+    rusage usage = {};
+    getrusage(RUSAGE_SELF, &usage);
+    return std::chrono::seconds(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec)
+        + std::chrono::microseconds(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec);
+}
+
+
+/// Sample a group of sensors with its own sampler, until the run duration is reached.
+///
+void runSamplerThread(const Options &options, const std::vector<VirtualSensor*> &sensors, uint32_t threadIndex,
+    ThreadResult &result)
+{
+    const auto journalPath = std::filesystem::temp_directory_path()
+        / ("read_sgp30_load." + std::to_string(threadIndex) + ".journal");
+    std::filesystem::remove(journalPath);
+    lr::BaselineStore baselineStore;
+    if (hasError(baselineStore.open(journalPath))) {
+        std::cerr << "Failed to open the baseline store: " << journalPath << std::endl;
+        return;
+    }
+    // Store a baseline for each sensor, so the sampler restores it and stores new values
+    // in the configured interval.
+    for (const auto sensor : sensors) {
+        const auto serialNumber = sensor->getSensor().readSerialNumberValue();
+        if (isSuccessful(serialNumber)) {
+            baselineStore.store(serialNumber.getValue(), lr::SGP30::BaselineValues(0x8a00, 0x8c00));
+        }
+    }
+    baselineStore.sync();
+    NullBuffer nullBuffer;
+    std::ofstream outputFile;
+    std::ostream nullOutput(&nullBuffer);
+    if (!options.outputDirectory.empty()) {
+        outputFile.open(options.outputDirectory / ("samples." + std::to_string(threadIndex) + ".jsonl"));
+    }
+    lr::Sampler sampler(baselineStore, outputFile.is_open() ? static_cast<std::ostream&>(outputFile) : nullOutput);
+    for (const auto sensor : sensors) {
+        sampler.addSensor(&sensor->getSensor());
+    }
+    sampler.setInterval(options.interval);
+    sampler.setBaselineStoreInterval(options.baselineInterval);
+    sampler.setRunDuration(options.duration);
+    result.success = isSuccessful(sampler.run());
+    result.latency = sampler.getSampleLatency();
+    baselineStore.close();
+    std::filesystem::remove(journalPath);
+}
+
+
+/// Run one configuration and write the results.
+///
+/// @return `true` on success.
+///
+bool runConfiguration(const Options &options, uint32_t sensorCount, uint32_t threadCount)
+{
+    std::vector<std::unique_ptr<SharedBus>> buses;
+    for (uint32_t i = 0; i < options.busCount; ++i) {
+        auto bus = std::make_unique<SharedBus>();
+        bus->byteTime = (options.busClock > 0)
+            ? std::chrono::nanoseconds(9'000'000'000ull / options.busClock)
+            : std::chrono::nanoseconds(0);
+        buses.push_back(std::move(bus));
+    }
+    std::vector<std::unique_ptr<VirtualSensor>> sensors;
+    std::vector<std::vector<VirtualSensor*>> sensorGroups(threadCount);
+    for (uint32_t i = 0; i < sensorCount; ++i) {
+        auto sensor = std::make_unique<VirtualSensor>(*buses[i % options.busCount], 0x000001000000ull + i);
+        if (hasError(sensor->getSensor().openBus())) {
+            return false;
+        }
+        sensorGroups[i % threadCount].push_back(sensor.get());
+        sensors.push_back(std::move(sensor));
+    }
+    std::vector<ThreadResult> results(threadCount);
+    std::vector<std::thread> threads;
+    const auto startCpuTime = getProcessCpuTime();
+    const auto startTime = Clock::now();
+    for (uint32_t i = 0; i < threadCount; ++i) {
+        threads.emplace_back(runSamplerThread, std::cref(options), std::cref(sensorGroups[i]), i, std::ref(results[i]));
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    const auto elapsed = std::chrono::duration<double>(Clock::now() - startTime).count();
+    const auto cpuTime = std::chrono::duration<double, std::micro>(getProcessCpuTime() - startCpuTime).count();
+    for (const auto &sensor : sensors) {
+        sensor->getSensor().closeBus();
+    }
+    bool success = true;
+    lr::LatencyHistogram latency;
+    for (const auto &result : results) {
+        success &= result.success;
+        latency.merge(result.latency);
+    }
+    const auto samples = latency.getCount();
+    std::cout << "{ \"sensors\": " << sensorCount
+        << ", \"buses\": " << options.busCount
+        << ", \"threads\": " << threadCount
+        << ", \"samples\": " << samples
+        << ", \"samples_per_s\": " << std::fixed << std::setprecision(0) << (static_cast<double>(samples) / elapsed)
+        << ", \"cpu_us_per_sample\": " << std::setprecision(3)
+        << ((samples > 0) ? cpuTime / static_cast<double>(samples) : 0.0)
+        << std::defaultfloat << ", \"latency\": ";
+    latency.writeJson(std::cout);
+    std::cout << ", \"success\": " << (success ? "true" : "false") << " }" << std::endl;
+    return success;
+}
+
+
+}
+
+
+int main(int argc, char **argv)
+{
+    Options options;
+    if (!parseCommandLine(argc, argv, options)) {
+        writeUsage();
+        return 1;
+    }
+    bool success = true;
+    for (const auto sensorCount : options.sensorCounts) {
+        for (const auto threadCount : options.threadCounts) {
+            if (threadCount > sensorCount) {
+                continue;
+            }
+            success &= runConfiguration(options, sensorCount, threadCount);
+        }
+    }
+    return success ? 0 : 1;
+}
+
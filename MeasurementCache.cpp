@@ -0,0 +1,162 @@
+//
+// (c)2020 by Lucky Resistor. See LICENSE for details.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+#include "MeasurementCache.hpp"
+
+
+#include "FileLock.hpp"
+
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+
+
+namespace lr {
+
+
+namespace {
+constexpr uint32_t cMagic = 0x4c524d31; ///< The magic value of the cache file ("LRM1").
+constexpr int cMaximumReadAttempts = 100; ///< The maximum attempts to read a consistent state.
+}
+
+
+MeasurementCache::MeasurementCache()
+    : _fd(-1), _data(nullptr)
+{
+}
+
+
+MeasurementCache::~MeasurementCache()
+{
+    close();
+}
+
+
+MeasurementCache::Status MeasurementCache::open(const std::filesystem::path &path)
+{
+    close();
+    _fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (_fd < 0) {
+        std::cerr << "Failed to open the cache file: " << path.string() << std::endl;
+        return Status::Error;
+    }
+    if (!applyFileLock(_fd, LOCK_EX)) {
+        std::cerr << "Failed to lock the cache file: " << path.string() << ". Error: " << std::strerror(errno) << std::endl;
+        close();
+        return Status::Error;
+    }
+    if (ftruncate(_fd, sizeof(Data)) < 0) {
+        std::cerr << "Failed to resize the cache file: " << path.string() << std::endl;
+        applyFileLock(_fd, LOCK_UN);
+        close();
+        return Status::Error;
+    }
+    void *address = mmap(nullptr, sizeof(Data), PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+    if (address == MAP_FAILED) {
+        std::cerr << "Failed to map the cache file: " << path.string() << std::endl;
+        applyFileLock(_fd, LOCK_UN);
+        close();
+        return Status::Error;
+    }
+    _data = static_cast<Data*>(address);
+    if (_data->magic.load() != cMagic) {
+        _data->sequence.store(0);
+        _data->timestamp.store(0);
+        _data->values.store(0);
+        _data->magic.store(cMagic);
+    }
+    applyFileLock(_fd, LOCK_UN);
+    return Status::Success;
+}
+
+
+void MeasurementCache::close()
+{
+    if (_data != nullptr) {
+        munmap(_data, sizeof(Data));
+        _data = nullptr;
+    }
+    if (_fd >= 0) {
+        ::close(_fd);
+        _fd = -1;
+    }
+}
+
+
+MeasurementCache::LookupResult MeasurementCache::lookup(std::chrono::milliseconds maximumAge) const
+{
+    if (_data == nullptr) {
+        return LookupResult::error();
+    }
+    for (int attempt = 0; attempt < cMaximumReadAttempts; ++attempt) {
+        const auto sequence = _data->sequence.load(std::memory_order_acquire);
+        if ((sequence & 1u) != 0) {
+            continue; // an update is in progress.
+        }
+        const auto timestamp = _data->timestamp.load(std::memory_order_relaxed);
+        const auto values = _data->values.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (_data->sequence.load(std::memory_order_relaxed) != sequence) {
+            continue;
+        }
+        const auto age = getTimestamp() - timestamp;
+        if (timestamp == 0 || age < 0 || age > std::chrono::nanoseconds(maximumAge).count()) {
+            return LookupResult::error();
+        }
+        return LookupResult::success(std::make_tuple(
+            static_cast<uint16_t>(values >> 16),
+            static_cast<uint16_t>(values & 0xffffu)));
+    }
+    return LookupResult::error();
+}
+
+
+MeasurementCache::Status MeasurementCache::update(const Values &values)
+{
+    if (_data == nullptr) {
+        return Status::Error;
+    }
+    const auto [co2, tvoc] = values;
+    if (!applyFileLock(_fd, LOCK_EX)) { // serialize writers from different processes.
+        return Status::IoError;
+    }
+    const auto sequence = _data->sequence.load(std::memory_order_relaxed);
+    _data->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    _data->timestamp.store(getTimestamp(), std::memory_order_relaxed);
+    _data->values.store((static_cast<uint32_t>(co2) << 16) | tvoc, std::memory_order_relaxed);
+    _data->sequence.store(sequence + 2, std::memory_order_release);
+    applyFileLock(_fd, LOCK_UN);
+    return Status::Success;
+}
+
+
+int64_t MeasurementCache::getTimestamp()
+{
+    // Use the real time clock, because the monotonic clock restarts with every boot.
+    timespec now{};
+    clock_gettime(CLOCK_REALTIME, &now);
+    return static_cast<int64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+}
+
+
+}
+
@@ -0,0 +1,115 @@
+#pragma once
+//
+// (c)2020 by Lucky Resistor. See LICENSE for details.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+
+
+#include "StatusTools.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <tuple>
+
+
+namespace lr {
+
+
+/// A cache for the last measurement, shared between processes.
+///
+/// The cache is a small memory mapped file. A run which happens shortly after another one
+/// can return the cached measurement, without accessing the bus. Updates are done using
+/// a sequence counter, so a reader never sees a partial update.
+///
+class MeasurementCache
+{
+public:
+    using Status = CallStatus;
+
+    /// The cached measurement values, CO2 in PPM and TVOC in PPB.
+    ///
+    using Values = std::tuple<uint16_t, uint16_t>;
+
+    /// The result of a lookup.
+    ///
+    using LookupResult = StatusResult<Values>;
+
+public:
+    /// ctor
+    ///
+    MeasurementCache();
+
+    /// dtor
+    ///
+    ~MeasurementCache();
+
+    MeasurementCache(const MeasurementCache&) = delete;
+    MeasurementCache &operator=(const MeasurementCache&) = delete;
+
+public:
+    /// Open or create the cache file.
+    ///
+    /// @param path The path to the cache file.
+    /// @return The call status.
+    ///
+    Status open(const std::filesystem::path &path);
+
+    /// Close the cache file.
+    ///
+    void close();
+
+    /// Get the cached values, if they are not older than the given age.
+    ///
+    /// @param maximumAge The maximum age of the cached values.
+    /// @return The cached values, or an error if there are no fresh values.
+    ///
+    LookupResult lookup(std::chrono::milliseconds maximumAge) const;
+
+    /// Store new values in the cache.
+    ///
+    /// @param values The values to store.
+    /// @return The call status. `IoError` if the cache file could not be locked, with the
+    ///     error number in `errno`.
+    ///
+    Status update(const Values &values);
+
+private:
+    /// The layout of the cache file.
+    ///
+    struct Data {
+        std::atomic<uint32_t> magic; ///< The magic value to identify an initialized file.
+        std::atomic<uint32_t> sequence; ///< The sequence counter, odd while an update is in progress.
+        std::atomic<int64_t> timestamp; ///< The time of the measurement in nanoseconds since the epoch.
+        std::atomic<uint32_t> values; ///< The CO2 value in the high and the TVOC value in the low 16 bits.
+    };
+
+    static_assert(std::atomic<uint32_t>::is_always_lock_free, "Lock free atomics required.");
+    static_assert(std::atomic<int64_t>::is_always_lock_free, "Lock free atomics required.");
+
+    /// Get the current time in nanoseconds since the epoch.
+    ///
+    static int64_t getTimestamp();
+
+private:
+    int _fd; ///< The file descriptor of the cache file.
+    Data *_data; ///< The mapped data.
+};
+
+
+}
+
@@ -0,0 +1,266 @@
+//
+// (c)2020 by Lucky Resistor. See LICENSE for details.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+#include "MeasurementFormat.hpp"
+
+
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+
+
+namespace lr {
+
+
+void writeMeasurementJson(std::ostream &output, const MeasurementRecord &record)
+{
+    output << "{ ";
+    if (record.serialNumber.has_value()) {
+        output << R"("serial_number": ")" << std::hex << std::setw(12) << std::setfill('0') << record.serialNumber.value()
+            << std::dec << std::setfill(' ') << "\", ";
+    }
+    output << "\"co2_ppm\": " << record.co2 << ", \"tvoc_ppb\": " << record.tvoc;
+    if (record.humidityValues.has_value()) {
+        const auto [temperature, humidity] = record.humidityValues.value();
+        output << ", \"temperature_c\": " << std::fixed << std::setprecision(2) << temperature
+            << ", \"humidity_percent\": " << humidity << std::defaultfloat;
+    }
+    if (record.rawSignals.has_value()) {
+        const auto [h2, ethanol] = record.rawSignals.value();
+        output << ", \"h2_raw\": " << h2 << ", \"ethanol_raw\": " << ethanol;
+    }
+    output << " }";
+}
+
+
+BinaryRecordWriter::BinaryRecordWriter(OutputFormat format) noexcept
+    : _format(format), _buffer(), _size(0)
+{
+}
+
+
+void BinaryRecordWriter::clear() noexcept
+{
+    _size = 0;
+}
+
+
+void BinaryRecordWriter::writeMeasurement(const MeasurementRecord &record) noexcept
+{
+    writeRecordStart("measurement", 8);
+    writeText("serial_number");
+    if (record.serialNumber.has_value()) {
+        writeUnsigned(record.serialNumber.value());
+    } else {
+        writeNull();
+    }
+    writeText("co2_ppm");
+    writeUnsigned(record.co2);
+    writeText("tvoc_ppb");
+    writeUnsigned(record.tvoc);
+    writeText("temperature_c");
+    if (record.humidityValues.has_value()) {
+        writeFloat(static_cast<float>(std::get<0>(record.humidityValues.value())));
+    } else {
+        writeNull();
+    }
+    writeText("humidity_percent");
+    if (record.humidityValues.has_value()) {
+        writeFloat(static_cast<float>(std::get<1>(record.humidityValues.value())));
+    } else {
+        writeNull();
+    }
+    writeText("h2_raw");
+    if (record.rawSignals.has_value()) {
+        writeUnsigned(std::get<0>(record.rawSignals.value()));
+    } else {
+        writeNull();
+    }
+    writeText("ethanol_raw");
+    if (record.rawSignals.has_value()) {
+        writeUnsigned(std::get<1>(record.rawSignals.value()));
+    } else {
+        writeNull();
+    }
+}
+
+
+void BinaryRecordWriter::writeBaseline(uint64_t serialNumber, const SGP30::BaselineValues &baselineValues) noexcept
+{
+    writeRecordStart("baseline", 4);
+    writeText("serial_number");
+    writeUnsigned(serialNumber);
+    writeText("co2_baseline");
+    writeUnsigned(std::get<0>(baselineValues));
+    writeText("tvoc_baseline");
+    writeUnsigned(std::get<1>(baselineValues));
+}
+
+
+void BinaryRecordWriter::writeSerialNumber(uint64_t serialNumber) noexcept
+{
+    writeRecordStart("serial", 2);
+    writeText("serial_number");
+    writeUnsigned(serialNumber);
+}
+
+
+void BinaryRecordWriter::writeStatus(std::string_view status) noexcept
+{
+    writeRecordStart("status", 2);
+    writeText("status");
+    writeText(status.substr(0, 64));
+}
+
+
+const uint8_t *BinaryRecordWriter::getData() const noexcept
+{
+    return _buffer.data();
+}
+
+
+std::size_t BinaryRecordWriter::getSize() const noexcept
+{
+    return _size;
+}
+
+
+void BinaryRecordWriter::writeTo(std::ostream &output) const
+{
+    output.write(reinterpret_cast<const char*>(_buffer.data()), static_cast<std::streamsize>(_size));
+}
+
+
+void BinaryRecordWriter::writeRecordStart(std::string_view type, uint8_t fieldCount) noexcept
+{
+    if (_format == OutputFormat::Cbor) {
+        writeCborHeader(5, fieldCount);
+    } else {
+        const uint8_t header = static_cast<uint8_t>(0x80u | fieldCount); // fixmap
+        append(&header, 1);
+    }
+    writeText("type");
+    writeText(type);
+}
+
+
+void BinaryRecordWriter::writeCborHeader(uint8_t majorType, uint64_t value) noexcept
+{
+    const auto type = static_cast<uint8_t>(majorType << 5);
+    if (value < 24) {
+        const uint8_t header = static_cast<uint8_t>(type | value);
+        append(&header, 1);
+    } else if (value <= UINT8_MAX) {
+        const uint8_t header[2] = {static_cast<uint8_t>(type | 24u), static_cast<uint8_t>(value)};
+        append(header, 2);
+    } else if (value <= UINT16_MAX) {
+        const uint8_t header = static_cast<uint8_t>(type | 25u);
+        append(&header, 1);
+        appendBigEndian(static_cast<uint16_t>(value));
+    } else if (value <= UINT32_MAX) {
+        const uint8_t header = static_cast<uint8_t>(type | 26u);
+        append(&header, 1);
+        appendBigEndian(static_cast<uint32_t>(value));
+    } else {
+        const uint8_t header = static_cast<uint8_t>(type | 27u);
+        append(&header, 1);
+        appendBigEndian(value);
+    }
+}
+
+
+void BinaryRecordWriter::writeUnsigned(uint64_t value) noexcept
+{
+    if (_format == OutputFormat::Cbor) {
+        writeCborHeader(0, value);
+    } else if (value < 0x80) {
+        const uint8_t header = static_cast<uint8_t>(value); // positive fixint
+        append(&header, 1);
+    } else if (value <= UINT8_MAX) {
+        const uint8_t header[2] = {0xcc, static_cast<uint8_t>(value)};
+        append(header, 2);
+    } else if (value <= UINT16_MAX) {
+        const uint8_t header = 0xcd;
+        append(&header, 1);
+        appendBigEndian(static_cast<uint16_t>(value));
+    } else if (value <= UINT32_MAX) {
+        const uint8_t header = 0xce;
+        append(&header, 1);
+        appendBigEndian(static_cast<uint32_t>(value));
+    } else {
+        const uint8_t header = 0xcf;
+        append(&header, 1);
+        appendBigEndian(value);
+    }
+}
+
+
+void BinaryRecordWriter::writeText(std::string_view text) noexcept
+{
+    text = text.substr(0, UINT8_MAX);
+    if (_format == OutputFormat::Cbor) {
+        writeCborHeader(3, text.size());
+    } else if (text.size() < 32) {
+        const uint8_t header = static_cast<uint8_t>(0xa0u | text.size()); // fixstr
+        append(&header, 1);
+    } else {
+        const uint8_t header[2] = {0xd9, static_cast<uint8_t>(text.size())};
+        append(header, 2);
+    }
+    append(reinterpret_cast<const uint8_t*>(text.data()), text.size());
+}
+
+
+void BinaryRecordWriter::writeFloat(float value) noexcept
+{
+    const uint8_t header = (_format == OutputFormat::Cbor) ? 0xfa : 0xca;
+    append(&header, 1);
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    appendBigEndian(bits);
+}
+
+
+void BinaryRecordWriter::writeNull() noexcept
+{
+    const uint8_t value = (_format == OutputFormat::Cbor) ? 0xf6 : 0xc0;
+    append(&value, 1);
+}
+
+
+void BinaryRecordWriter::append(const uint8_t *data, std::size_t size) noexcept
+{
+    // The records are small enough for the buffer, this only protects against a misuse.
+    const auto count = std::min(size, _buffer.size() - _size);
+    std::memcpy(_buffer.data() + _size, data, count);
+    _size += count;
+}
+
+
+template<typename Type>
+void BinaryRecordWriter::appendBigEndian(Type value) noexcept
+{
+    uint8_t bytes[sizeof(Type)];
+    for (std::size_t i = 0; i < sizeof(Type); ++i) {
+        bytes[i] = static_cast<uint8_t>(value >> ((sizeof(Type) - 1 - i) * 8));
+    }
+    append(bytes, sizeof(Type));
+}
+
+
+}
+
@@ -0,0 +1,169 @@
+#pragma once
+//
+// (c)2020 by Lucky Resistor. See LICENSE for details.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+
+
+#include "SGP30.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <ostream>
+#include <string_view>
+
+
+namespace lr {
+
+
+/// A measurement, as it is written to the output.
+///
+struct MeasurementRecord {
+    uint16_t co2; ///< The CO2 equivalent in ppm.
+    uint16_t tvoc; ///< The TVOC value in ppb.
+    std::optional<uint64_t> serialNumber = std::nullopt; ///< The serial number of the sensor, if known.
+    std::optional<SGP30::HumidityValues> humidityValues = std::nullopt; ///< The values used for the humidity compensation.
+    std::optional<SGP30::RawSignals> rawSignals = std::nullopt; ///< The raw signals, if they were read.
+};
+
+
+/// Write a measurement as JSON object, without a line break.
+///
+/// The serial number, the humidity values and the raw signals are only written if they are set.
+///
+/// @param output The output stream.
+/// @param record The measurement.
+///
+void writeMeasurementJson(std::ostream &output, const MeasurementRecord &record);
+
+
+/// The format of the results and samples.
+///
+enum class OutputFormat : uint8_t {
+    Json, ///< One JSON object per line.
+    Cbor, ///< A sequence of CBOR maps (RFC 8949).
+    MessagePack, ///< A sequence of MessagePack maps.
+};
+
+
+/// Encode records as CBOR or MessagePack maps into a fixed buffer.
+///
+/// Each record is a map with the record type as first key, followed by all fields of the
+/// type in a fixed order. Unknown values are encoded as null, so every record of a type has
+/// the same layout:
+///
+/// - `measurement`: `type`, `serial_number`, `co2_ppm`, `tvoc_ppb`, `temperature_c`, `humidity_percent`,
+///   `h2_raw`, `ethanol_raw`
+/// - `baseline`: `type`, `serial_number`, `co2_baseline`, `tvoc_baseline`
+/// - `serial`: `type`, `serial_number`
+/// - `status`: `type`, `status`
+///
+/// The serial number is an unsigned integer, the temperature and humidity are 32-bit floats.
+///
+class BinaryRecordWriter
+{
+public:
+    /// The capacity of the buffer, large enough for any record.
+    ///
+    static constexpr std::size_t cCapacity = 192;
+
+public:
+    /// Create a new writer.
+    ///
+    /// @param format The binary format, `Cbor` or `MessagePack`.
+    ///
+    explicit BinaryRecordWriter(OutputFormat format) noexcept;
+
+public:
+    /// Remove the encoded records from the buffer.
+    ///
+    void clear() noexcept;
+
+    /// Encode a measurement record.
+    ///
+    void writeMeasurement(const MeasurementRecord &record) noexcept;
+
+    /// Encode a baseline record.
+    ///
+    void writeBaseline(uint64_t serialNumber, const SGP30::BaselineValues &baselineValues) noexcept;
+
+    /// Encode a serial number record.
+    ///
+    void writeSerialNumber(uint64_t serialNumber) noexcept;
+
+    /// Encode a status record.
+    ///
+    /// @param status The status, up to 64 characters.
+    ///
+    void writeStatus(std::string_view status) noexcept;
+
+    /// Access the encoded data.
+    ///
+    const uint8_t *getData() const noexcept;
+
+    /// Get the size of the encoded data.
+    ///
+    std::size_t getSize() const noexcept;
+
+    /// Write the encoded data to a stream.
+    ///
+    void writeTo(std::ostream &output) const;
+
+private:
+    /// Start a record with the given number of fields, including the type.
+    ///
+    void writeRecordStart(std::string_view type, uint8_t fieldCount) noexcept;
+
+    /// Encode a CBOR header with major type and argument.
+    ///
+    void writeCborHeader(uint8_t majorType, uint64_t value) noexcept;
+
+    /// Encode an unsigned integer.
+    ///
+    void writeUnsigned(uint64_t value) noexcept;
+
+    /// Encode a text string.
+    ///
+    void writeText(std::string_view text) noexcept;
+
+    /// Encode a 32-bit float.
+    ///
+    void writeFloat(float value) noexcept;
+
+    /// Encode null.
+    ///
+    void writeNull() noexcept;
+
+    /// Append bytes to the buffer.
+    ///
+    void append(const uint8_t *data, std::size_t size) noexcept;
+
+    /// Append a value in big endian byte order.
+    ///
+    template<typename Type>
+    void appendBigEndian(Type value) noexcept;
+
+private:
+    OutputFormat _format; ///< The binary format.
+    std::array<uint8_t, cCapacity> _buffer; ///< The buffer for the encoded records.
+    std::size_t _size; ///< The number of used bytes in the buffer.
+};
+
+
+}
+
@@ -0,0 +1,222 @@
+//
+// (c)2020 by Lucky Resistor. See LICENSE for details.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+#include "OutputPipeline.hpp"
+
+
+namespace lr {
+
+
+OutputPipeline::RecordBuffer::RecordBuffer(OutputPipeline &pipeline)
+:
+    _pipeline(pipeline),
+    _record(),
+    _isOversized(false)
+{
+    setp(_record.data.data(), _record.data.data() + _record.data.size());
+}
+
+
+void OutputPipeline::RecordBuffer::commit()
+{
+    if (_isOversized) {
+        _isOversized = false;
+        _pipeline._droppedCount.fetch_add(1, std::memory_order_relaxed);
+        setp(_record.data.data(), _record.data.data() + _record.data.size());
+        return;
+    }
+    const auto size = static_cast<uint32_t>(pptr() - pbase());
+    if (size == 0) {
+        return;
+    }
+    _record.size = size;
+    _pipeline.push(_record);
+    setp(_record.data.data(), _record.data.data() + _record.data.size());
+}
+
+
+int OutputPipeline::RecordBuffer::overflow(int c)
+{
+    // The record is too long for one entry. Splitting it would let the queue drop a part of it,
+    // so the rest of the record is discarded, and the whole record is dropped on commit.
+    _isOversized = true;
+    setp(_record.data.data(), _record.data.data() + _record.data.size());
+    return traits_type::not_eof(c);
+}
+
+
+int OutputPipeline::RecordBuffer::sync()
+{
+    commit();
+    _pipeline._wakeupEvent.wake();
+    return 0;
+}
+
+
+OutputPipeline::OutputPipeline()
+:
+    _sinks(),
+    _policy(Policy::DropOldest),
+    _queue(std::make_unique<Queue>()),
+    _recordBuffer(*this),
+    _stream(&_recordBuffer),
+    _wakeupEvent(),
+    _sinkThread(),
+    _isStopRequested(false),
+    _batch(cBatchSize),
+    _vectors(cBatchSize),
+    _recordCount(0),
+    _droppedCount(0),
+    _batchCount(0),
+    _byteCount(0),
+    _sinkErrorCount(0)
+{
+}
+
+
+OutputPipeline::~OutputPipeline()
+{
+    stop();
+}
+
+
+void OutputPipeline::addSink(std::unique_ptr<OutputSink> sink)
+{
+    _sinks.push_back(std::move(sink));
+}
+
+
+void OutputPipeline::setPolicy(Policy policy)
+{
+    _policy = policy;
+}
+
+
+OutputPipeline::Status OutputPipeline::start()
+{
+    if (hasError(_wakeupEvent.open())) {
+        return Status::IoError;
+    }
+    _isStopRequested = false;
+    _sinkThread = std::thread([this]() { runSinkThread(); });
+    return Status::Success;
+}
+
+
+void OutputPipeline::stop()
+{
+    if (!_sinkThread.joinable()) {
+        return;
+    }
+    _recordBuffer.commit();
+    _isStopRequested.store(true, std::memory_order_release);
+    _wakeupEvent.signal();
+    _sinkThread.join();
+    _wakeupEvent.close();
+}
+
+
+std::ostream &OutputPipeline::getStream() noexcept
+{
+    return _stream;
+}
+
+
+void OutputPipeline::commitRecord()
+{
+    _recordBuffer.commit();
+    if (_queue->getSize() >= cQueueCapacity / 2) {
+        _wakeupEvent.wake();
+    }
+}
+
+
+void OutputPipeline::writeStatisticsJson(std::ostream &output) const
+{
+    output << "{ \"records\": " << _recordCount.load(std::memory_order_relaxed)
+        << ", \"dropped\": " << _droppedCount.load(std::memory_order_relaxed)
+        << ", \"batches\": " << _batchCount.load(std::memory_order_relaxed)
+        << ", \"bytes\": " << _byteCount.load(std::memory_order_relaxed)
+        << ", \"sink_errors\": " << _sinkErrorCount.load(std::memory_order_relaxed) << " }";
+}
+
+
+void OutputPipeline::push(const Record &record)
+{
+    if (_policy == Policy::DropOldest) {
+        if (_queue->pushDroppingOldest(record)) {
+            _droppedCount.fetch_add(1, std::memory_order_relaxed);
+        }
+    } else if (!_queue->tryPush(record)) {
+        _wakeupEvent.wake();
+        const auto deadline = std::chrono::steady_clock::now() + cMaximumBlockTime;
+        while (!_queue->tryPush(record)) {
+            if (std::chrono::steady_clock::now() >= deadline) {
+                _droppedCount.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+    _recordCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+
+void OutputPipeline::runSinkThread()
+{
+    while (true) {
+        // Read the flag first, so all records written before the stop are in the queue.
+        const auto isStopRequested = _isStopRequested.load(std::memory_order_acquire);
+        std::size_t count = 0;
+        while (count < cBatchSize && _queue->tryPop(_batch[count])) {
+            ++count;
+        }
+        if (count > 0) {
+            writeBatch(count);
+        } else if (isStopRequested) {
+            break;
+        } else {
+            _wakeupEvent.wait([this]() {
+                return _queue->getSize() > 0 || _isStopRequested.load(std::memory_order_relaxed);
+            });
+        }
+    }
+}
+
+
+void OutputPipeline::writeBatch(std::size_t count)
+{
+    uint64_t byteCount = 0;
+    for (std::size_t i = 0; i < count; ++i) {
+        byteCount += _batch[i].size;
+    }
+    for (auto &sink : _sinks) {
+        for (std::size_t i = 0; i < count; ++i) {
+            _vectors[i].iov_base = _batch[i].data.data();
+            _vectors[i].iov_len = _batch[i].size;
+        }
+        if (hasError(sink->write(_vectors.data(), static_cast<int>(count)))) {
+            _sinkErrorCount.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    _batchCount.fetch_add(1, std::memory_order_relaxed);
+    _byteCount.fetch_add(byteCount, std::memory_order_relaxed);
+}
+
+
+}
+
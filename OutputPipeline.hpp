@@ -0,0 +1,204 @@
+#pragma once
+//
+// (c)2020 by Lucky Resistor. See LICENSE for details.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+
+
+#include "OutputSink.hpp"
+#include "SpscQueue.hpp"
+#include "StatusTools.hpp"
+#include "WakeupEvent.hpp"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <streambuf>
+#include <thread>
+#include <vector>
+
+
+namespace lr {
+
+
+/// An output stage, which decouples the sampling thread from slow consumers.
+///
+/// The sampling thread writes into the stream of the pipeline. Each record is copied into a
+/// fixed-size entry of a lock-free queue, without a system call. A sink thread takes the
+/// records from the queue in batches, and writes each batch with a single call to every sink.
+/// Flushing the stream wakes the sink thread.
+///
+/// If the queue is full, the policy decides: `DropOldest` replaces the oldest record, and
+/// `Block` waits up to `cMaximumBlockTime` for free space, and drops the new record after it.
+/// A record longer than `cRecordCapacity` is dropped, so the sinks only get complete records.
+///
+class OutputPipeline
+{
+public:
+    using Status = CallStatus;
+
+    /// The policy if the queue is full.
+    ///
+    enum class Policy : uint8_t {
+        DropOldest, ///< Replace the oldest record in the queue.
+        Block ///< Wait for free space in the queue, up to `cMaximumBlockTime`.
+    };
+
+    /// The maximum size of a record. A longer record is never split, it is dropped as a whole.
+    ///
+    static constexpr std::size_t cRecordCapacity = 252;
+
+    /// The number of entries in the queue.
+    ///
+    static constexpr std::size_t cQueueCapacity = 256;
+
+    /// The maximum number of records written in one batch.
+    ///
+    static constexpr std::size_t cBatchSize = 64;
+
+    /// The maximum time to wait for free space with the `Block` policy.
+    ///
+    static constexpr std::chrono::milliseconds cMaximumBlockTime{100};
+
+public:
+    /// ctor
+    ///
+    OutputPipeline();
+
+    /// dtor
+    ///
+    /// Stops the sink thread, after writing all records.
+    ///
+    ~OutputPipeline();
+
+    OutputPipeline(const OutputPipeline&) = delete;
+    OutputPipeline &operator=(const OutputPipeline&) = delete;
+
+public:
+    /// Add a sink. All sinks must be added before `start()`.
+    ///
+    /// @param sink The sink.
+    ///
+    void addSink(std::unique_ptr<OutputSink> sink);
+
+    /// Set the policy if the queue is full.
+    ///
+    /// @param policy The policy. `DropOldest` is the default.
+    ///
+    void setPolicy(Policy policy);
+
+    /// Start the sink thread.
+    ///
+    /// @return The call status. `IoError` if the event to wake the thread can not be created.
+    ///
+    Status start();
+
+    /// Write all records and stop the sink thread.
+    ///
+    /// Must be called from the thread which writes into the stream.
+    ///
+    void stop();
+
+    /// Access the stream to write the records.
+    ///
+    /// The stream must only be used from one thread.
+    ///
+    std::ostream &getStream() noexcept;
+
+    /// Add the text written since the last record to the queue, as one record.
+    ///
+    /// Unlike flushing the stream, this only wakes the sink thread if the queue is half full.
+    ///
+    void commitRecord();
+
+    /// Write the statistics of the pipeline as JSON object.
+    ///
+    /// @param output The output stream.
+    ///
+    void writeStatisticsJson(std::ostream &output) const;
+
+private:
+    /// One entry of the queue.
+    ///
+    struct Record {
+        uint32_t size; ///< The number of used bytes.
+        std::array<char, cRecordCapacity> data; ///< The bytes of the record.
+    };
+
+    /// The stream buffer, which collects the bytes of the current record.
+    ///
+    class RecordBuffer : public std::streambuf
+    {
+    public:
+        /// Create a buffer, which adds the records to the given pipeline.
+        ///
+        explicit RecordBuffer(OutputPipeline &pipeline);
+
+        /// Add the collected bytes as record, if there are any.
+        ///
+        /// A record which did not fit into one entry is counted as dropped instead.
+        ///
+        void commit();
+
+    protected:
+        int overflow(int c) override;
+        int sync() override;
+
+    private:
+        OutputPipeline &_pipeline; ///< The pipeline.
+        Record _record; ///< The current record.
+        bool _isOversized; ///< If the current record is longer than one entry.
+    };
+
+    using Queue = SpscQueue<Record, cQueueCapacity>;
+
+private:
+    /// Add a record to the queue, using the policy.
+    ///
+    void push(const Record &record);
+
+    /// The loop of the sink thread.
+    ///
+    void runSinkThread();
+
+    /// Write the first records of the batch to all sinks.
+    ///
+    void writeBatch(std::size_t count);
+
+private:
+    std::vector<std::unique_ptr<OutputSink>> _sinks; ///< The sinks.
+    Policy _policy; ///< The policy if the queue is full.
+    std::unique_ptr<Queue> _queue; ///< The queue to the sink thread.
+    RecordBuffer _recordBuffer; ///< The buffer of the stream.
+    std::ostream _stream; ///< The stream to write the records.
+    WakeupEvent _wakeupEvent; ///< The event to wake the sink thread.
+    std::thread _sinkThread; ///< The sink thread.
+    std::atomic<bool> _isStopRequested; ///< If the sink thread shall stop, once the queue is empty.
+    std::vector<Record> _batch; ///< The records of the current batch, used by the sink thread.
+    std::vector<iovec> _vectors; ///< The vectors of the current batch, used by the sink thread.
+    std::atomic<uint64_t> _recordCount; ///< The number of records added to the queue.
+    std::atomic<uint64_t> _droppedCount; ///< The number of dropped records.
+    std::atomic<uint64_t> _batchCount; ///< The number of written batches.
+    std::atomic<uint64_t> _byteCount; ///< The number of written bytes.
+    std::atomic<uint64_t> _sinkErrorCount; ///< The number of failed writes to a sink.
+};
+
+
+}
+
@@ -0,0 +1,278 @@
+//
+// (c)2020 by Lucky Resistor. See LICENSE for details.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+#include "OutputSink.hpp"
+
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <new>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+
+namespace lr {
+
+
+namespace {
+
+/// Write all vectors, and continue after partial writes.
+///
+/// @param vectors The vectors to write. They are modified by the call.
+/// @param count The number of vectors.
+/// @param writeVectors The function to write vectors, returning the number of written bytes or -1.
+/// @return `true` on success, `false` on an error, with the error number in `errno`.
+///
+template<typename WriteVectors>
+bool writeAllVectors(iovec *vectors, int count, WriteVectors writeVectors)
+{
+    while (count > 0) {
+        const auto written = writeVectors(vectors, count);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        auto remaining = static_cast<std::size_t>(written);
+        while (count > 0 && remaining >= vectors->iov_len) {
+            remaining -= vectors->iov_len;
+            ++vectors;
+            --count;
+        }
+        if (count > 0) {
+            vectors->iov_base = static_cast<uint8_t*>(vectors->iov_base) + remaining;
+            vectors->iov_len -= remaining;
+        }
+    }
+    return true;
+}
+
+}
+
+
+FileSink::FileSink()
+:
+    _fd(-1)
+{
+}
+
+
+FileSink::~FileSink()
+{
+    if (_fd >= 0) {
+        ::close(_fd);
+    }
+}
+
+
+FileSink::Status FileSink::open(const std::filesystem::path &path)
+{
+    _fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (_fd < 0) {
+        return Status::IoError;
+    }
+    return Status::Success;
+}
+
+
+FileSink::Status FileSink::openStandardOutput()
+{
+    _fd = fcntl(STDOUT_FILENO, F_DUPFD_CLOEXEC, 0);
+    if (_fd < 0) {
+        return Status::IoError;
+    }
+    return Status::Success;
+}
+
+
+FileSink::Status FileSink::write(iovec *vectors, int count)
+{
+    const auto success = writeAllVectors(vectors, count, [this](const iovec *v, int n) -> ssize_t {
+        return ::writev(_fd, v, n);
+    });
+    return success ? Status::Success : Status::IoError;
+}
+
+
+SocketSink::SocketSink()
+:
+    _path(),
+    _fd(-1)
+{
+}
+
+
+SocketSink::~SocketSink()
+{
+    closeSocket();
+}
+
+
+SocketSink::Status SocketSink::open(const std::filesystem::path &path)
+{
+    if (path.native().size() >= sizeof(sockaddr_un::sun_path)) {
+        return Status::BadParameter;
+    }
+    _path = path;
+    return connectSocket();
+}
+
+
+SocketSink::Status SocketSink::write(iovec *vectors, int count)
+{
+    if (_fd < 0 && hasError(connectSocket())) {
+        return Status::IoError;
+    }
+    const auto success = writeAllVectors(vectors, count, [this](iovec *v, int n) -> ssize_t {
+        msghdr message{};
+        message.msg_iov = v;
+        message.msg_iovlen = static_cast<std::size_t>(n);
+        return ::sendmsg(_fd, &message, MSG_NOSIGNAL);
+    });
+    if (!success) {
+        const auto error = errno;
+        closeSocket();
+        errno = error;
+        return Status::IoError;
+    }
+    return Status::Success;
+}
+
+
+SocketSink::Status SocketSink::connectSocket()
+{
+    _fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (_fd < 0) {
+        return Status::IoError;
+    }
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    std::strncpy(address.sun_path, _path.c_str(), sizeof(address.sun_path) - 1);
+    if (::connect(_fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+        const auto error = errno;
+        closeSocket();
+        errno = error;
+        return Status::IoError;
+    }
+    return Status::Success;
+}
+
+
+void SocketSink::closeSocket()
+{
+    if (_fd >= 0) {
+        ::close(_fd);
+        _fd = -1;
+    }
+}
+
+
+SharedMemorySink::SharedMemorySink()
+:
+    _header(nullptr),
+    _ring(nullptr),
+    _mappedSize(0)
+{
+}
+
+
+SharedMemorySink::~SharedMemorySink()
+{
+    close();
+}
+
+
+SharedMemorySink::Status SharedMemorySink::open(const std::string &name, std::size_t capacity)
+{
+    const int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return Status::IoError;
+    }
+    const auto size = sizeof(Header) + capacity;
+    if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+        const auto error = errno;
+        ::close(fd);
+        errno = error;
+        return Status::IoError;
+    }
+    void *memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    const auto error = errno;
+    ::close(fd);
+    if (memory == MAP_FAILED) {
+        errno = error;
+        return Status::IoError;
+    }
+    _mappedSize = size;
+    _header = new (memory) Header();
+    _ring = static_cast<uint8_t*>(memory) + sizeof(Header);
+    _header->version = 1;
+    _header->capacity = capacity;
+    _header->reservePosition.store(0, std::memory_order_relaxed);
+    _header->writePosition.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    _header->magic = cMagic;
+    return Status::Success;
+}
+
+
+SharedMemorySink::Status SharedMemorySink::write(iovec *vectors, int count)
+{
+    const auto capacity = static_cast<std::size_t>(_header->capacity);
+    auto position = _header->writePosition.load(std::memory_order_relaxed);
+    uint64_t totalSize = 0;
+    for (int i = 0; i < count; ++i) {
+        totalSize += vectors[i].iov_len;
+    }
+    // Readers which copied bytes the following writes overwrite, detect it with the reserved position.
+    _header->reservePosition.store(position + totalSize, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (int i = 0; i < count; ++i) {
+        auto bytes = static_cast<const uint8_t*>(vectors[i].iov_base);
+        auto size = vectors[i].iov_len;
+        while (size > 0) {
+            const auto offset = static_cast<std::size_t>(position % capacity);
+            const auto chunkSize = std::min(size, capacity - offset);
+            std::memcpy(_ring + offset, bytes, chunkSize);
+            bytes += chunkSize;
+            size -= chunkSize;
+            position += chunkSize;
+        }
+    }
+    _header->writePosition.store(position, std::memory_order_release);
+    return Status::Success;
+}
+
+
+void SharedMemorySink::close()
+{
+    if (_header != nullptr) {
+        munmap(_header, _mappedSize);
+        _header = nullptr;
+        _ring = nullptr;
+        _mappedSize = 0;
+    }
+}
+
+
+}
+
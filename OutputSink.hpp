@@ -0,0 +1,203 @@
+#pragma once
+//
+// (c)2020 by Lucky Resistor. See LICENSE for details.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+
+
+#include "StatusTools.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+
+#include <sys/uio.h>
+
+
+namespace lr {
+
+
+/// A destination for the batches of the output pipeline.
+///
+class OutputSink
+{
+public:
+    using Status = CallStatus;
+
+public:
+    /// dtor
+    ///
+    virtual ~OutputSink() = default;
+
+public:
+    /// Write one batch of records.
+    ///
+    /// @param vectors The records of the batch. The vectors are modified by the call.
+    /// @param count The number of vectors.
+    /// @return The call status. `IoError` if the batch could not be written completely,
+    ///     with the error number in `errno`.
+    ///
+    virtual Status write(iovec *vectors, int count) = 0;
+};
+
+
+/// A sink which appends the records to a file, or writes them to the standard output.
+///
+class FileSink : public OutputSink
+{
+public:
+    /// ctor
+    ///
+    FileSink();
+
+    /// dtor
+    ///
+    ~FileSink() override;
+
+    FileSink(const FileSink&) = delete;
+    FileSink &operator=(const FileSink&) = delete;
+
+public:
+    /// Open a file to append the records. The file is created if it does not exist.
+    ///
+    /// @param path The path of the file.
+    /// @return The call status. `IoError` if the file can not be opened, with the error number in `errno`.
+    ///
+    Status open(const std::filesystem::path &path);
+
+    /// Use the standard output.
+    ///
+    /// @return The call status. `IoError` if the standard output can not be duplicated.
+    ///
+    Status openStandardOutput();
+
+    Status write(iovec *vectors, int count) override;
+
+private:
+    int _fd; ///< The file descriptor, or -1 if closed.
+};
+
+
+/// A sink which sends the records to a listening Unix stream socket.
+///
+/// If the connection fails, the batch is lost and the sink connects again for the next batch.
+///
+class SocketSink : public OutputSink
+{
+public:
+    /// ctor
+    ///
+    SocketSink();
+
+    /// dtor
+    ///
+    ~SocketSink() override;
+
+    SocketSink(const SocketSink&) = delete;
+    SocketSink &operator=(const SocketSink&) = delete;
+
+public:
+    /// Connect to a socket.
+    ///
+    /// @param path The path of the socket.
+    /// @return The call status. `BadParameter` if the path is too long, `IoError` if the
+    ///     connection failed, with the error number in `errno`.
+    ///
+    Status open(const std::filesystem::path &path);
+
+    Status write(iovec *vectors, int count) override;
+
+private:
+    /// Connect to the socket at the stored path.
+    ///
+    Status connectSocket();
+
+    /// Close the connection.
+    ///
+    void closeSocket();
+
+private:
+    std::filesystem::path _path; ///< The path of the socket.
+    int _fd; ///< The file descriptor of the connection, or -1 if not connected.
+};
+
+
+/// A sink which copies the records into a ring buffer in shared memory.
+///
+/// The shared memory object starts with a header of one cache line, followed by the ring of
+/// bytes. Readers poll `writePosition`, which counts the written bytes. After copying the
+/// bytes, a reader checks with `reservePosition`, if the writer has overwritten them.
+///
+class SharedMemorySink : public OutputSink
+{
+public:
+    /// The default size of the ring in bytes.
+    ///
+    static constexpr std::size_t cDefaultCapacity = 0x10000;
+
+    /// The header in front of the ring.
+    ///
+    struct alignas(64) Header {
+        uint32_t magic; ///< The magic value `cMagic`.
+        uint32_t version; ///< The version of the layout, 1.
+        uint64_t capacity; ///< The size of the ring in bytes.
+        std::atomic<uint64_t> reservePosition; ///< The end of the bytes which are written or being written.
+        std::atomic<uint64_t> writePosition; ///< The end of the completely written bytes.
+    };
+
+    /// The magic value at the start of the header, "LRSG" in little endian.
+    ///
+    static constexpr uint32_t cMagic = 0x4753524cu;
+
+public:
+    /// ctor
+    ///
+    SharedMemorySink();
+
+    /// dtor
+    ///
+    ~SharedMemorySink() override;
+
+    SharedMemorySink(const SharedMemorySink&) = delete;
+    SharedMemorySink &operator=(const SharedMemorySink&) = delete;
+
+public:
+    /// Create or open a shared memory object and reset the ring.
+    ///
+    /// @param name The name of the object, starting with a slash.
+    /// @param capacity The size of the ring in bytes.
+    /// @return The call status. `IoError` if the object can not be created or mapped, with the
+    ///     error number in `errno`.
+    ///
+    Status open(const std::string &name, std::size_t capacity = cDefaultCapacity);
+
+    Status write(iovec *vectors, int count) override;
+
+private:
+    /// Unmap the memory.
+    ///
+    void close();
+
+private:
+    Header *_header; ///< The mapped header, or `nullptr`.
+    uint8_t *_ring; ///< The mapped ring.
+    std::size_t _mappedSize; ///< The size of the mapping.
+};
+
+
+}
+
@@ -0,0 +1,189 @@
+//
+// (c)2020 by Lucky Resistor. See LICENSE for details.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+#include "PerfCounters.hpp"
+
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cerrno>
+
+
+namespace lr {
+
+
+void PerfCounters::Values::writeJson(std::ostream &output) const
+{
+    output << "{";
+    const char *separator = " ";
+    const auto writeValue = [&](const char *name, const std::optional<uint64_t> &value) {
+        if (value.has_value()) {
+            output << separator << '"' << name << "\": " << value.value();
+            separator = ", ";
+        }
+    };
+    writeValue("cycles", cycles);
+    writeValue("instructions", instructions);
+    writeValue("context_switches", contextSwitches);
+    writeValue("page_faults", pageFaults);
+    output << " }";
+}
+
+
+PerfCounters::PerfCounters()
+    : _fds(), _hasUsageContextSwitches(false), _startContextSwitches(0)
+{
+    _fds.fill(-1);
+}
+
+
+PerfCounters::~PerfCounters()
+{
+    close();
+}
+
+
+PerfCounters::Status PerfCounters::open()
+{
+    close();
+    // Counting kernel events requires privileges with the usual `perf_event_paranoid`
+    // setting, so fall back to the events in user space.
+    bool excludeKernel = false;
+    int lastError = 0;
+    bool anyOpened = false;
+    for (std::size_t i = 0; i < EventCount; ++i) {
+        const auto event = static_cast<Event>(i);
+        auto fd = excludeKernel ? -1 : openEvent(event, false);
+        if (fd < 0 && !excludeKernel && (errno == EACCES || errno == EPERM)) {
+            excludeKernel = true;
+        }
+        if (fd < 0 && excludeKernel) {
+            if (event == ContextSwitches) {
+                // Without the kernel, the counter would always report zero context switches.
+                _hasUsageContextSwitches = true;
+                anyOpened = true;
+                continue;
+            }
+            fd = openEvent(event, true);
+        }
+        if (fd < 0) {
+            lastError = errno;
+            continue;
+        }
+        _fds[i] = fd;
+        anyOpened = true;
+    }
+    if (!anyOpened) {
+        errno = lastError;
+        return Status::IoError;
+    }
+    return Status::Success;
+}
+
+
+void PerfCounters::close()
+{
+    for (auto &fd : _fds) {
+        if (fd >= 0) {
+            ::close(fd);
+            fd = -1;
+        }
+    }
+    _hasUsageContextSwitches = false;
+}
+
+
+void PerfCounters::start() noexcept
+{
+    for (const auto fd : _fds) {
+        if (fd >= 0) {
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+    if (_hasUsageContextSwitches) {
+        _startContextSwitches = readThreadContextSwitches();
+    }
+}
+
+
+PerfCounters::Values PerfCounters::stop() noexcept
+{
+    std::array<std::optional<uint64_t>, EventCount> values;
+    for (std::size_t i = 0; i < EventCount; ++i) {
+        if (_fds[i] < 0) {
+            continue;
+        }
+        ioctl(_fds[i], PERF_EVENT_IOC_DISABLE, 0);
+        uint64_t value = 0;
+        if (read(_fds[i], &value, sizeof(value)) == sizeof(value)) {
+            values[i] = value;
+        }
+    }
+    if (_hasUsageContextSwitches) {
+        values[ContextSwitches] = readThreadContextSwitches() - _startContextSwitches;
+    }
+    return Values{values[Cycles], values[Instructions], values[ContextSwitches], values[PageFaults]};
+}
+
+
+int PerfCounters::openEvent(Event event, bool excludeKernel)
+{
+    perf_event_attr attributes = {};
+    attributes.size = sizeof(attributes);
+    switch (event) {
+    case Cycles:
+        attributes.type = PERF_TYPE_HARDWARE;
+        attributes.config = PERF_COUNT_HW_CPU_CYCLES;
+        break;
+    case Instructions:
+        attributes.type = PERF_TYPE_HARDWARE;
+        attributes.config = PERF_COUNT_HW_INSTRUCTIONS;
+        break;
+    case ContextSwitches:
+        attributes.type = PERF_TYPE_SOFTWARE;
+        attributes.config = PERF_COUNT_SW_CONTEXT_SWITCHES;
+        break;
+    case PageFaults:
+    default:
+        attributes.type = PERF_TYPE_SOFTWARE;
+        attributes.config = PERF_COUNT_SW_PAGE_FAULTS;
+        break;
+    }
+    attributes.disabled = 1;
+    attributes.exclude_kernel = excludeKernel ? 1 : 0;
+    attributes.exclude_hv = 1;
+    return static_cast<int>(syscall(SYS_perf_event_open, &attributes, 0, -1, -1, PERF_FLAG_FD_CLOEXEC));
+}
+
+
+uint64_t PerfCounters::readThreadContextSwitches() noexcept
+{
+    rusage usage = {};
+    if (getrusage(RUSAGE_THREAD, &usage) < 0) {
+        return 0;
+    }
+    return static_cast<uint64_t>(usage.ru_nvcsw) + static_cast<uint64_t>(usage.ru_nivcsw);
+}
+
+
+}
+
@@ -0,0 +1,125 @@
+#pragma once
+//
+// (c)2020 by Lucky Resistor. See LICENSE for details.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+
+
+#include "StatusTools.hpp"
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <ostream>
+
+
+namespace lr {
+
+
+/// Hardware and software performance counters of the calling thread.
+///
+/// The counters are read with `perf_event_open`. If the kernel does not allow to count
+/// events in the kernel, only the events in user space are counted. Context switches only
+/// happen in the kernel, so in this case they are read from `getrusage()` instead. Counters
+/// which are not supported, for example the hardware counters in most virtual machines, are
+/// left out.
+///
+class PerfCounters
+{
+public:
+    using Status = CallStatus;
+
+    /// The counted values of one measured section.
+    ///
+    struct Values {
+        std::optional<uint64_t> cycles; ///< The CPU cycles.
+        std::optional<uint64_t> instructions; ///< The retired instructions.
+        std::optional<uint64_t> contextSwitches; ///< The context switches.
+        std::optional<uint64_t> pageFaults; ///< The page faults.
+
+        /// Write the values as JSON object.
+        ///
+        /// @param output The output stream.
+        ///
+        void writeJson(std::ostream &output) const;
+    };
+
+public:
+    /// ctor
+    ///
+    PerfCounters();
+
+    /// dtor
+    ///
+    /// Closes the counters.
+    ///
+    ~PerfCounters();
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters &operator=(const PerfCounters&) = delete;
+
+public:
+    /// Open the counters for the calling thread.
+    ///
+    /// @return The call status. `IoError` if no counter could be opened, with the error
+    ///     number of the last attempt in `errno`.
+    ///
+    Status open();
+
+    /// Close all counters.
+    ///
+    void close();
+
+    /// Reset and start the counters.
+    ///
+    void start() noexcept;
+
+    /// Stop the counters and read the values.
+    ///
+    /// @return The values counted since the last call of `start()`.
+    ///
+    Values stop() noexcept;
+
+private:
+    /// The counted events.
+    ///
+    enum Event : std::size_t {
+        Cycles,
+        Instructions,
+        ContextSwitches,
+        PageFaults,
+        EventCount
+    };
+
+    /// Open the counter for one event.
+    ///
+    /// @return The file descriptor, or a negative value on error.
+    ///
+    static int openEvent(Event event, bool excludeKernel);
+
+    /// Get the voluntary and involuntary context switches of the calling thread from `getrusage()`.
+    ///
+    static uint64_t readThreadContextSwitches() noexcept;
+
+private:
+    std::array<int, EventCount> _fds; ///< The file descriptors of the counters, negative if not available.
+    bool _hasUsageContextSwitches; ///< If the context switches are read from `getrusage()`.
+    uint64_t _startContextSwitches; ///< The context switches from `getrusage()` at the start.
+};
+
+
+}
+
@@ -0,0 +1,142 @@
+//
+// (c)2020 by Lucky Resistor. See LICENSE for details.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+#include "RecoveryEngine.hpp"
+
+
+#include "I2CBus.hpp"
+
+#include <algorithm>
+
+
+namespace lr {
+
+
+using namespace std::chrono;
+
+
+const RecoveryEngine::Policy RecoveryEngine::cDefaultPolicy = {3, 10ms, 200ms, true, true};
+
+
+void RecoveryEngine::Statistics::writeJson(std::ostream &output) const
+{
+    output << "{ \"failures\": " << failures
+        << ", \"retries\": " << retries
+        << ", \"reopens\": " << reopens
+        << ", \"resets\": " << resets
+        << ", \"recoveries\": " << recoveries
+        << ", \"unrecovered\": " << unrecovered
+        << ", \"time_to_recovery\": ";
+    recoveryTime.writeJson(output);
+    output << " }";
+}
+
+
+RecoveryEngine::RecoveryEngine()
+    : _policy(cDefaultPolicy), _statistics(), _timeSource(&getRealTimeSource())
+{
+}
+
+
+void RecoveryEngine::setPolicy(const Policy &policy)
+{
+    _policy = policy;
+}
+
+
+void RecoveryEngine::setTimeSource(TimeSource *timeSource)
+{
+    _timeSource = (timeSource != nullptr) ? timeSource : &getRealTimeSource();
+}
+
+
+RecoveryEngine::Status RecoveryEngine::run(I2CBus *bus, Operation operation, Operation reset)
+{
+    auto status = operation();
+    if (isSuccessful(status)) {
+        return status;
+    }
+    _statistics.failures += 1;
+    const auto startTime = _timeSource->now();
+    auto backoff = _policy.initialBackoff;
+    for (uint32_t i = 0; i < _policy.retryCount && isTransient(status); ++i) {
+        if (backoff.count() > 0) {
+            _timeSource->sleepFor(backoff);
+            backoff = std::min(backoff * 2, _policy.maximumBackoff);
+        }
+        _statistics.retries += 1;
+        status = operation();
+        if (isSuccessful(status)) {
+            recordRecovery(startTime);
+            return status;
+        }
+    }
+    if (_policy.reopenBus && isTransient(status)) {
+        _statistics.reopens += 1;
+        bus->closeBus();
+        status = bus->openBus();
+        if (isSuccessful(status)) {
+            status = operation();
+            if (isSuccessful(status)) {
+                recordRecovery(startTime);
+                return status;
+            }
+        }
+    }
+    if (_policy.resetSensor && reset && isTransient(status)) {
+        _statistics.resets += 1;
+        status = reset();
+        if (isSuccessful(status)) {
+            status = operation();
+            if (isSuccessful(status)) {
+                recordRecovery(startTime);
+                return status;
+            }
+        }
+    }
+    _statistics.unrecovered += 1;
+    return status;
+}
+
+
+const RecoveryEngine::Statistics &RecoveryEngine::getStatistics() const
+{
+    return _statistics;
+}
+
+
+bool RecoveryEngine::isTransient(Status status) noexcept
+{
+    switch (status) {
+    case Status::Success:
+    case Status::BadParameter:
+        return false;
+    default:
+        return true;
+    }
+}
+
+
+void RecoveryEngine::recordRecovery(Clock::time_point startTime)
+{
+    _statistics.recoveries += 1;
+    _statistics.recoveryTime.record(_timeSource->now() - startTime);
+}
+
+
+}
+
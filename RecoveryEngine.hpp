@@ -0,0 +1,180 @@
+#pragma once
+//
+// (c)2020 by Lucky Resistor. See LICENSE for details.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+
+
+#include "BusStatistics.hpp"
+#include "SensirionSensor.hpp"
+#include "StatusTools.hpp"
+#include "TimeSource.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <type_traits>
+
+
+namespace lr {
+
+
+/// Recovers the communication with a sensor after failed operations.
+///
+/// If an operation fails with a transient error, the engine escalates in steps, until
+/// the operation succeeds again:
+///
+/// 1. Retry the operation, with an exponential backoff between the attempts.
+/// 2. Close and open the bus again.
+/// 3. Reset the sensor and restore its state, using a function of the caller.
+///
+/// The time from the first failure until the successful operation is recorded as
+/// time-to-recovery.
+///
+class RecoveryEngine
+{
+public:
+    using Status = CallStatus;
+    using Clock = std::chrono::steady_clock;
+
+    /// A non-owning reference to an operation or a reset function, returning the call status.
+    ///
+    /// Unlike `std::function`, the reference never allocates memory. The referenced callable
+    /// must outlive the reference, which is the case for a lambda passed to `run()`.
+    ///
+    class Operation
+    {
+    public:
+        /// Create an empty reference.
+        ///
+        Operation() noexcept = default;
+
+        /// Create a reference to a callable.
+        ///
+        /// @param callable The callable, returning the call status.
+        ///
+        template<typename Callable, typename = std::enable_if_t<!std::is_same_v<std::decay_t<Callable>, Operation>>>
+        Operation(Callable &&callable) noexcept
+            : _callable(const_cast<void*>(static_cast<const void*>(std::addressof(callable)))),
+            _invoke([](void *callable) -> Status {
+                return (*static_cast<std::remove_reference_t<Callable>*>(callable))();
+            })
+        {
+        }
+
+        /// Call the referenced callable.
+        ///
+        Status operator()() const { return _invoke(_callable); }
+
+        /// Check if the reference is not empty.
+        ///
+        explicit operator bool() const noexcept { return _invoke != nullptr; }
+
+    private:
+        void *_callable = nullptr; ///< The referenced callable.
+        Status (*_invoke)(void*) = nullptr; ///< The function to call the callable.
+    };
+
+    /// The policy for the recovery.
+    ///
+    struct Policy {
+        uint32_t retryCount; ///< The number of retries of a failed operation.
+        std::chrono::milliseconds initialBackoff; ///< The wait before the first retry.
+        std::chrono::milliseconds maximumBackoff; ///< The maximum wait before a retry.
+        bool reopenBus; ///< If the bus is opened again, after all retries failed.
+        bool resetSensor; ///< If the sensor is reset, after opening the bus did not help.
+    };
+
+    /// The statistics of the recovery.
+    ///
+    struct Statistics {
+        uint64_t failures; ///< The number of failed operations.
+        uint64_t retries; ///< The number of retries.
+        uint64_t reopens; ///< The number of times the bus was opened again.
+        uint64_t resets; ///< The number of sensor resets.
+        uint64_t recoveries; ///< The number of failed operations which succeeded after a recovery.
+        uint64_t unrecovered; ///< The number of failed operations without recovery.
+        LatencyHistogram recoveryTime; ///< The time from the first failure to the successful operation.
+
+        /// Write the statistics as JSON object.
+        ///
+        /// @param output The output stream.
+        ///
+        void writeJson(std::ostream &output) const;
+    };
+
+    /// The default policy.
+    ///
+    static const Policy cDefaultPolicy;
+
+public:
+    /// ctor
+    ///
+    RecoveryEngine();
+
+public:
+    /// Set the recovery policy.
+    ///
+    /// @param policy The policy.
+    ///
+    void setPolicy(const Policy &policy);
+
+    /// Set the source of time for the backoff and the time-to-recovery.
+    ///
+    /// @param timeSource The time source, or `nullptr` for the real time.
+    ///
+    void setTimeSource(TimeSource *timeSource);
+
+    /// Run an operation and recover from failures.
+    ///
+    /// The operation must not be called while the bus is in a transaction, because the
+    /// bus may be closed and opened during the recovery.
+    ///
+    /// @param bus The bus used by the operation.
+    /// @param operation The operation.
+    /// @param reset The function to reset the sensor and restore its state.
+    /// @return The status of the last attempt of the operation.
+    ///
+    Status run(I2CBus *bus, Operation operation, Operation reset);
+
+    /// Access the statistics.
+    ///
+    const Statistics &getStatistics() const;
+
+    /// Check if a failure may disappear with a retry.
+    ///
+    /// @param status The status of the failed call.
+    /// @return `true` for errors of the communication.
+    ///
+    static bool isTransient(Status status) noexcept;
+
+private:
+    /// Record a recovery.
+    ///
+    /// @param startTime The time of the first failure.
+    ///
+    void recordRecovery(Clock::time_point startTime);
+
+private:
+    Policy _policy; ///< The recovery policy.
+    Statistics _statistics; ///< The statistics.
+    TimeSource *_timeSource; ///< The source of time.
+};
+
+
+}
+
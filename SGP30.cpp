@@ -18,11 +18,10 @@
 #include "SGP30.hpp"
 
 
+#include "AbsoluteHumidity.hpp"
 #include "I2CBus.hpp"
 
-#include <iostream>
 #include <chrono>
-#include <thread>
 #include <cmath>
 #include <iomanip>
 #include <sstream>
@@ -42,59 +41,119 @@ SGP30::SGP30(int i2cBus, bool debuggingEnabled)
 
 SGP30::Status SGP30::initializeMeasurements()
 {
+    const I2CBus::Transaction transaction(_bus);
+    if (hasError(transaction.getStatus())) {
+        return transaction.getStatus();
+    }
     const auto result = sendCommand(Command::sgp30_iaq_init);
-    std::this_thread::sleep_for(10ms);
+    waitForResult(10ms);
     return result;
 }
 
 
 SGP30::MeasurentResult SGP30::readMeasurements()
 {
-    if (hasError(sendCommand(Command::sgp30_measure_iaq))) {
-        return MeasurentResult::error();
+    const I2CBus::Transaction transaction(_bus);
+    if (hasError(transaction.getStatus())) {
+        return MeasurentResult::error(transaction.getStatus(), getErrorDetail(transaction.getStatus()));
+    }
+    if (const auto status = sendCommand(Command::sgp30_measure_iaq); hasError(status)) {
+        return MeasurentResult::error(status, getErrorDetail(status));
     }
-    std::this_thread::sleep_for(12ms);
+    waitForResult(12ms);
     auto result = readTwoValuesResult();
     if (hasError(result)) {
-        return MeasurentResult::error();
+        return MeasurentResult::error(result);
     }
     return MeasurentResult::success(result.getValue());
 }
 
 
+SGP30::Status SGP30::startMeasurement()
+{
+    const I2CBus::Transaction transaction(_bus);
+    if (hasError(transaction.getStatus())) {
+        return transaction.getStatus();
+    }
+    return sendCommand(Command::sgp30_measure_iaq);
+}
+
+
+SGP30::MeasurentResult SGP30::readMeasurementResult()
+{
+    const I2CBus::Transaction transaction(_bus);
+    if (hasError(transaction.getStatus())) {
+        return MeasurentResult::error(transaction.getStatus(), getErrorDetail(transaction.getStatus()));
+    }
+    auto result = readTwoValuesResult();
+    if (hasError(result)) {
+        return MeasurentResult::error(result);
+    }
+    return MeasurentResult::success(result.getValue());
+}
+
+
+SGP30::RawSignalsResult SGP30::readRawSignals()
+{
+    const I2CBus::Transaction transaction(_bus);
+    if (hasError(transaction.getStatus())) {
+        return RawSignalsResult::error(transaction.getStatus(), getErrorDetail(transaction.getStatus()));
+    }
+    if (const auto status = sendCommand(Command::sgp30_measure_raw); hasError(status)) {
+        return RawSignalsResult::error(status, getErrorDetail(status));
+    }
+    waitForResult(25ms);
+    auto result = readTwoValuesResult();
+    if (hasError(result)) {
+        return RawSignalsResult::error(result);
+    }
+    return RawSignalsResult::success(result.getValue());
+}
+
+
 SGP30::Status SGP30::setHumidityCompensation(double temperatureCelsius, double relativeHumidity)
 {
     if (temperatureCelsius < -100.0 || temperatureCelsius > 100.0) {
-        std::cerr << "Temperature out of range.";
-        return Status::Error;
+        return Status::BadParameter;
     }
     if (relativeHumidity < 0.0 || relativeHumidity > 100.0) {
-        std::cerr << "Relative humidity out of range.";
-        return Status::Error;
+        return Status::BadParameter;
     }
     // Calculate g/m3 water from rel. humidity and temperature.
-    // This formula is from the datasheet of the sensor.
-    const double humidityFactor = (relativeHumidity / 100);
-    const double temperatureFactor = std::exp((17.62 * temperatureCelsius)/(243.12 + temperatureCelsius));
-    const double absoluteHumidity = 216.7 * ((humidityFactor * 6.112 * temperatureFactor) / (273.15 + temperatureCelsius));
-    const auto fixedPointValue = static_cast<uint16_t>(absoluteHumidity * 256.0);
-    if (hasError(sendCommand(Command::sgp30_set_absolute_humidity, fixedPointValue))) {
-        return Status::Error;
-    }
-    std::this_thread::sleep_for(10ms);
+    const auto fixedPointValue = getAbsoluteHumidity(
+        static_cast<int32_t>(std::lround(temperatureCelsius * 1000.0)),
+        static_cast<int32_t>(std::lround(relativeHumidity * 1000.0)));
+    return setAbsoluteHumidity(fixedPointValue);
+}
+
+
+SGP30::Status SGP30::setAbsoluteHumidity(uint16_t absoluteHumidity)
+{
+    const I2CBus::Transaction transaction(_bus);
+    if (hasError(transaction.getStatus())) {
+        return transaction.getStatus();
+    }
+    if (const auto status = sendCommand(Command::sgp30_set_absolute_humidity, absoluteHumidity); hasError(status)) {
+        return status;
+    }
+    waitForResult(10ms);
     return Status::Success;
 }
 
 
 SGP30::BaselineResult SGP30::getIAQBaseline()
 {
-    if (hasError(sendCommand(Command::sgp30_get_iaq_baseline))) {
-        return BaselineResult::error();
+    const I2CBus::Transaction transaction(_bus);
+    if (hasError(transaction.getStatus())) {
+        return BaselineResult::error(transaction.getStatus(), getErrorDetail(transaction.getStatus()));
     }
-    std::this_thread::sleep_for(10ms);
+    if (const auto status = sendCommand(Command::sgp30_get_iaq_baseline); hasError(status)) {
+        return BaselineResult::error(status, getErrorDetail(status));
+    }
+    waitForResult(10ms);
     auto result = readTwoValuesResult();
     if (hasError(result)) {
-        return BaselineResult::error();
+        return BaselineResult::error(result);
     }
     return BaselineResult::success(result.getValue());
 }
@@ -102,56 +161,155 @@ SGP30::BaselineResult SGP30::getIAQBaseline()
 
 SGP30::Status SGP30::setIAQBaseline(const SGP30::BaselineValues &baselineValues)
 {
-    if (hasError(sendCommand(Command::sgp30_set_iaq_baseline, std::get<0>(baselineValues), std::get<1>(baselineValues)))) {
-        return Status::Error;
+    const I2CBus::Transaction transaction(_bus);
+    if (hasError(transaction.getStatus())) {
+        return transaction.getStatus();
+    }
+    if (const auto status = sendCommand(Command::sgp30_set_iaq_baseline, std::get<0>(baselineValues), std::get<1>(baselineValues)); hasError(status)) {
+        return status;
     }
-    std::this_thread::sleep_for(10ms);
+    waitForResult(10ms);
     return Status::Success;
 }
 
 
-SensirionSensor::Status SGP30::makeMeasurementTest()
+SGP30::TVOCBaselineResult SGP30::getTVOCInceptiveBaseline()
 {
-    if (hasError(sendCommand(Command::sgp30_measure_test))) {
-        return Status::Success;
+    const I2CBus::Transaction transaction(_bus);
+    if (hasError(transaction.getStatus())) {
+        return TVOCBaselineResult::error(transaction.getStatus(), getErrorDetail(transaction.getStatus()));
     }
-    std::this_thread::sleep_for(220ms);
+    if (const auto status = sendCommand(Command::sgp30_get_tvoc_inceptive_baseline); hasError(status)) {
+        return TVOCBaselineResult::error(status, getErrorDetail(status));
+    }
+    waitForResult(10ms);
     auto result = readOneValueResult();
     if (hasError(result)) {
-        return Status::Error;
+        return TVOCBaselineResult::error(result);
+    }
+    return TVOCBaselineResult::success(result.getValue());
+}
+
+
+SGP30::Status SGP30::setTVOCBaseline(uint16_t baselineValue)
+{
+    const I2CBus::Transaction transaction(_bus);
+    if (hasError(transaction.getStatus())) {
+        return transaction.getStatus();
     }
-    if (result.getValue() != 0xd400) {
-        std::cerr << "The measurement test returned: ";
-        std::cerr << std::hex << std::setw(4) << std::setfill('0') << result.getValue();
-        std::cerr << " expected 0xd400" << std::endl;
-        return Status::Error;
+    if (const auto status = sendCommand(Command::sgp30_set_tvoc_baseline, baselineValue); hasError(status)) {
+        return status;
     }
-    return CallStatus::Success;
+    waitForResult(10ms);
+    return Status::Success;
+}
+
+
+SGP30::WarmStartResult SGP30::warmStart(
+    const std::optional<BaselineValues> &baselineValues,
+    const std::optional<HumidityValues> &humidityValues)
+{
+    const I2CBus::Transaction transaction(_bus);
+    if (hasError(transaction.getStatus())) {
+        return WarmStartResult::error(transaction.getStatus(), getErrorDetail(transaction.getStatus()));
+    }
+    if (const auto status = initializeMeasurements(); hasError(status)) {
+        return WarmStartResult::error(status, getErrorDetail(status));
+    }
+    auto baselineSource = BaselineSource::None;
+    if (baselineValues.has_value()) {
+        if (const auto status = setIAQBaseline(baselineValues.value()); hasError(status)) {
+            return WarmStartResult::error(status, getErrorDetail(status));
+        }
+        baselineSource = BaselineSource::IAQBaseline;
+    } else {
+        // Older sensors do not support the inceptive baseline, so errors are not fatal here.
+        const auto inceptiveResult = getTVOCInceptiveBaseline();
+        if (isSuccessful(inceptiveResult) && isSuccessful(setTVOCBaseline(inceptiveResult.getValue()))) {
+            baselineSource = BaselineSource::TVOCInceptiveBaseline;
+        }
+    }
+    if (humidityValues.has_value()) {
+        const auto [temperature, humidity] = humidityValues.value();
+        if (const auto status = setHumidityCompensation(temperature, humidity); hasError(status)) {
+            return WarmStartResult::error(status, getErrorDetail(status));
+        }
+    }
+    return WarmStartResult::success(baselineSource);
+}
+
+
+SGP30::MeasurementTestResult SGP30::makeMeasurementTest()
+{
+    const I2CBus::Transaction transaction(_bus);
+    if (hasError(transaction.getStatus())) {
+        return MeasurementTestResult::error(transaction.getStatus());
+    }
+    if (const auto status = sendCommand(Command::sgp30_measure_test); hasError(status)) {
+        return MeasurementTestResult::error(status);
+    }
+    waitForResult(220ms);
+    return readOneValueResult();
 }
 
 
 SGP30::SerialNumberResult SGP30::readSerialNumber()
 {
-    if (hasError(sendCommand(Command::sgp30_read_serial_number))) {
-        return SerialNumberResult::error();
+    const auto result = readSerialNumberValue();
+    if (hasError(result)) {
+        return SerialNumberResult::error(result);
     }
-    std::this_thread::sleep_for(10ms);
+    std::stringstream serialString;
+    serialString << std::hex << std::setw(12) << std::setfill('0') << result.getValue();
+    return SerialNumberResult::success(serialString.str());
+}
+
+
+SGP30::SerialNumberValueResult SGP30::readSerialNumberValue()
+{
+    const I2CBus::Transaction transaction(_bus);
+    if (hasError(transaction.getStatus())) {
+        return SerialNumberValueResult::error(transaction.getStatus(), getErrorDetail(transaction.getStatus()));
+    }
+    if (const auto status = sendCommand(Command::sgp30_read_serial_number); hasError(status)) {
+        return SerialNumberValueResult::error(status, getErrorDetail(status));
+    }
+    waitForResult(10ms);
     auto result = readThreeValuesResult();
     if (hasError(result)) {
-        return SerialNumberResult::error();
+        return SerialNumberValueResult::error(result);
     }
     auto [value0, value1, value2] = result.getValue();
-    std::stringstream serialString;
-    serialString << std::hex << std::setw(4) << std::setfill('0') << value0 << value1 << value2;
-    return SerialNumberResult::success(serialString.str());
+    const uint64_t serialNumber = (static_cast<uint64_t>(value0) << 32)
+        | (static_cast<uint64_t>(value1) << 16)
+        | static_cast<uint64_t>(value2);
+    return SerialNumberValueResult::success(serialNumber);
+}
+
+
+SGP30::FeatureSetResult SGP30::readFeatureSet()
+{
+    const I2CBus::Transaction transaction(_bus);
+    if (hasError(transaction.getStatus())) {
+        return FeatureSetResult::error(transaction.getStatus(), getErrorDetail(transaction.getStatus()));
+    }
+    if (const auto status = sendCommand(Command::sgp30_get_feature_set); hasError(status)) {
+        return FeatureSetResult::error(status, getErrorDetail(status));
+    }
+    waitForResult(10ms);
+    auto result = readOneValueResult();
+    if (hasError(result)) {
+        return FeatureSetResult::error(result);
+    }
+    return FeatureSetResult::success(result.getValue());
 }
 
 
 SensirionSensor::Status SGP30::softReset()
 {
     const uint8_t data[1] = {0x06};
-    if (hasError(_bus->writeData(0x00, data, 1))) {
-        return Status::Error;
+    if (const auto status = _bus->writeData(0x00, data, 1); hasError(status)) {
+        return status;
     }
     return Status::Success;
 }
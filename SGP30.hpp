@@ -20,6 +20,10 @@
 
 #include "SensirionSensor.hpp"
 
+#include <chrono>
+#include <optional>
+#include <string>
+
 
 namespace lr {
 
@@ -33,6 +37,14 @@ public:
     ///
     using MeasurentResult = StatusResult<std::tuple<uint16_t, uint16_t>>;
 
+    /// The raw signals of the H2 and the ethanol sensing element.
+    ///
+    using RawSignals = std::tuple<uint16_t, uint16_t>;
+
+    /// The read raw signals result.
+    ///
+    using RawSignalsResult = StatusResult<RawSignals>;
+
     /// The baseline values.
     ///
     using BaselineValues = std::tuple<uint16_t, uint16_t>;
@@ -45,6 +57,46 @@ public:
     ///
     using SerialNumberResult = StatusResult<std::string>;
 
+    /// The serial number as a numeric value.
+    ///
+    using SerialNumberValueResult = StatusResult<uint64_t>;
+
+    /// The TVOC baseline result.
+    ///
+    using TVOCBaselineResult = StatusResult<uint16_t>;
+
+    /// The feature set result.
+    ///
+    using FeatureSetResult = StatusResult<uint16_t>;
+
+    /// The measurement test result, the test word returned by the sensor.
+    ///
+    using MeasurementTestResult = StatusResult<uint16_t>;
+
+    /// The source of the baseline used for a warm start.
+    ///
+    enum class BaselineSource : uint8_t {
+        None, ///< No baseline was set, the baseline is calculated from scratch.
+        IAQBaseline, ///< The stored iAQ baseline was restored.
+        TVOCInceptiveBaseline, ///< The TVOC inceptive baseline of the sensor was used.
+    };
+
+    /// The warm start result.
+    ///
+    using WarmStartResult = StatusResult<BaselineSource>;
+
+    /// The temperature in celsius and relative humidity in percent for the compensation.
+    ///
+    using HumidityValues = std::tuple<double, double>;
+
+    /// The time after initializing the measurements, until the sensor returns valid values.
+    ///
+    static constexpr auto cInitializationTime = std::chrono::seconds(15);
+
+    /// The test word returned by a successful measurement test.
+    ///
+    static constexpr uint16_t cMeasurementTestPassed = 0xd400;
+
 public:
     /// Create a new access object for the SHT32 sensor.
     ///
@@ -75,6 +127,30 @@ public:
     ///
     MeasurentResult readMeasurements();
 
+    /// Start a measurement, without waiting for the result.
+    ///
+    /// Read the result with `readMeasurementResult()`, at least 12ms later. No other command
+    /// must be sent to the sensor in between, or the result is lost.
+    ///
+    /// @return The call status.
+    ///
+    Status startMeasurement();
+
+    /// Read the result of a measurement started with `startMeasurement()`.
+    ///
+    /// @return The first value is the CO2 equivalent in PPM, the second value is TVOC in PPB.
+    ///
+    MeasurentResult readMeasurementResult();
+
+    /// Read the raw signals of the sensing elements.
+    ///
+    /// The measurement takes up to 25ms. It does not disturb the baseline compensation, if
+    /// the measurements are still read every second.
+    ///
+    /// @return The first value is the H2 signal, the second value is the ethanol signal.
+    ///
+    RawSignalsResult readRawSignals();
+
     /// Get the iAQ baseline.
     ///
     /// Use this function to read the current iAQ baseline. The idea is to store these values
@@ -95,26 +171,80 @@ public:
     ///
     Status setIAQBaseline(const BaselineValues &baselineValues);
 
+    /// Get the TVOC inceptive baseline.
+    ///
+    /// The sensor provides a factory calibrated TVOC baseline, which can be used if
+    /// there is no stored iAQ baseline. It has to be read after initializing the
+    /// measurements. See sensor datasheet for details.
+    ///
+    /// @return The TVOC inceptive baseline.
+    ///
+    TVOCBaselineResult getTVOCInceptiveBaseline();
+
+    /// Set the TVOC baseline.
+    ///
+    /// @param baselineValue The TVOC baseline value.
+    /// @return The call status.
+    ///
+    Status setTVOCBaseline(uint16_t baselineValue);
+
+    /// Initialize the measurements and restore the fastest available baseline.
+    ///
+    /// This runs the whole sequence in one bus transaction. After initializing the measurements,
+    /// the given iAQ baseline is restored. Without an iAQ baseline, the TVOC inceptive baseline
+    /// of the sensor is used. If humidity values are given, the humidity compensation is set.
+    /// The sensor will return valid values after `cInitializationTime`.
+    ///
+    /// @param baselineValues The stored iAQ baseline, if there is a usable one.
+    /// @param humidityValues The humidity values for the compensation, if any.
+    /// @return The source of the baseline which was restored.
+    ///
+    WarmStartResult warmStart(
+        const std::optional<BaselineValues> &baselineValues,
+        const std::optional<HumidityValues> &humidityValues);
+
     /// Set humidity compensation.
     ///
     /// This will set the humidity compensation for the chip.
     ///
     /// @param temperatureCelsius The temperature in celsius.
     /// @param relativeHumidity The relative humidity in percent.
-    /// @return The call status.
+    /// @return The call status. `BadParameter` if a value is out of range.
     ///
     Status setHumidityCompensation(double temperatureCelsius, double relativeHumidity);
 
+    /// Set the absolute humidity for the humidity compensation.
+    ///
+    /// @param absoluteHumidity The absolute humidity in g/m3 as 8.8 fixed-point value.
+    ///     A value of zero disables the humidity compensation.
+    /// @return The call status.
+    ///
+    Status setAbsoluteHumidity(uint16_t absoluteHumidity);
+
     /// Make a measure test.
     ///
-    /// @return Success if the test was successful.
+    /// The test passed, if the returned test word is `cMeasurementTestPassed`.
     ///
-    Status makeMeasurementTest();
+    /// @return The test word, or an error if the communication failed.
+    ///
+    MeasurementTestResult makeMeasurementTest();
 
     /// Read the serial number.
     ///
     SerialNumberResult readSerialNumber();
 
+    /// Read the serial number as numeric value.
+    ///
+    /// @return The 48 bit serial number.
+    ///
+    SerialNumberValueResult readSerialNumberValue();
+
+    /// Read the feature set.
+    ///
+    /// @return The product type in the upper four bits and the product version in the lower byte.
+    ///
+    FeatureSetResult readFeatureSet();
+
     /// Make a soft reset.
     ///
     /// This will affect all sensors on the bus.
@@ -0,0 +1,236 @@
+//
+// (c)2020 by Lucky Resistor. See LICENSE for details.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+#include "SGP30Model.hpp"
+
+
+#include <algorithm>
+#include <cmath>
+
+
+namespace lr {
+
+
+namespace {
+
+using Days = std::chrono::duration<double, std::ratio<86400>>; ///< A duration in days.
+
+constexpr double cCleanAirCo2Baseline = 0x8a00; ///< The clean air CO2eq baseline of a new sensor.
+constexpr double cCleanAirTvocBaseline = 0x8c00; ///< The clean air TVOC baseline of a new sensor.
+constexpr double cInitialCo2Offset = -600.0; ///< The offset of the CO2eq baseline after `iaq_init`.
+constexpr double cInitialTvocOffset = -400.0; ///< The offset of the TVOC baseline after `iaq_init`.
+constexpr double cInceptiveTvocOffset = -100.0; ///< The offset of the inceptive TVOC baseline.
+constexpr double cCo2PerBaselineUnit = 0.5; ///< The CO2eq error in ppm per baseline unit.
+constexpr double cTvocPerBaselineUnit = 0.25; ///< The TVOC error in ppb per baseline unit.
+constexpr double cReferenceHumidity = 10.0; ///< The humidity without compensation, in g/m³.
+constexpr double cTvocPerHumidity = 8.0; ///< The TVOC error in ppb per g/m³ humidity difference.
+constexpr double cCo2PerHumidity = 4.0; ///< The CO2eq error in ppm per g/m³ humidity difference.
+constexpr double cMinimumCo2 = 400.0; ///< The lowest CO2eq value reported by the sensor.
+constexpr double cMaximumValue = 60000.0; ///< The highest value reported by the sensor.
+constexpr double cPi = 3.14159265358979323846; ///< The constant pi.
+
+}
+
+
+const SGP30Model::Environment SGP30Model::cDefaultEnvironment = {600.0, 200.0, 120.0, 80.0, 14.0};
+
+
+SGP30Model::SGP30Model(TimeSource &timeSource)
+:
+    _timeSource(timeSource),
+    _startTime(timeSource.now()),
+    _lastUpdate(_startTime),
+    _initTime(_startTime),
+    _environment(cDefaultEnvironment),
+    _co2Drift(-15.0),
+    _tvocDrift(-10.0),
+    _isInitialized(false),
+    _co2Baseline(cCleanAirCo2Baseline),
+    _tvocBaseline(cCleanAirTvocBaseline),
+    _compensationHumidity(cReferenceHumidity),
+    _measurements(0),
+    _initPhaseMeasurements(0),
+    _co2ErrorSum(0.0),
+    _co2MaximumError(0.0),
+    _tvocErrorSum(0.0),
+    _tvocMaximumError(0.0)
+{
+}
+
+
+void SGP30Model::setEnvironment(const Environment &environment)
+{
+    _environment = environment;
+}
+
+
+void SGP30Model::setBaselineDrift(double co2PerDay, double tvocPerDay)
+{
+    update();
+    _co2Drift = co2PerDay;
+    _tvocDrift = tvocPerDay;
+}
+
+
+void SGP30Model::reset()
+{
+    update();
+    _isInitialized = false;
+    _compensationHumidity = cReferenceHumidity;
+}
+
+
+void SGP30Model::initialize()
+{
+    update();
+    const auto [co2CleanAir, tvocCleanAir] = getCleanAirBaseline();
+    _isInitialized = true;
+    _initTime = _timeSource.now();
+    _co2Baseline = co2CleanAir + cInitialCo2Offset;
+    _tvocBaseline = tvocCleanAir + cInitialTvocOffset;
+}
+
+
+bool SGP30Model::isInitialized() const
+{
+    return _isInitialized;
+}
+
+
+std::tuple<uint16_t, uint16_t> SGP30Model::measure()
+{
+    update();
+    if (_timeSource.now() - _initTime < cInitPhase) {
+        _initPhaseMeasurements += 1;
+        return {static_cast<uint16_t>(cMinimumCo2), 0};
+    }
+    const auto [co2CleanAir, tvocCleanAir] = getCleanAirBaseline();
+    const auto dayPhase = std::fmod(Days(_timeSource.now() - _startTime).count(), 1.0);
+    const auto cycle = std::sin(2.0 * cPi * dayPhase);
+    const auto co2 = std::max(cMinimumCo2, _environment.co2 + _environment.co2DailyAmplitude * cycle);
+    const auto tvoc = std::max(0.0, _environment.tvoc + _environment.tvocDailyAmplitude * cycle);
+    const auto humidityError = _environment.absoluteHumidity - _compensationHumidity;
+    const auto co2Reading = std::clamp(
+        std::round(co2 + (co2CleanAir - _co2Baseline) * cCo2PerBaselineUnit + humidityError * cCo2PerHumidity),
+        cMinimumCo2, cMaximumValue);
+    const auto tvocReading = std::clamp(
+        std::round(tvoc + (tvocCleanAir - _tvocBaseline) * cTvocPerBaselineUnit + humidityError * cTvocPerHumidity),
+        0.0, cMaximumValue);
+    const auto co2Error = std::abs(co2Reading - co2);
+    const auto tvocError = std::abs(tvocReading - tvoc);
+    _measurements += 1;
+    _co2ErrorSum += co2Error;
+    _co2MaximumError = std::max(_co2MaximumError, co2Error);
+    _tvocErrorSum += tvocError;
+    _tvocMaximumError = std::max(_tvocMaximumError, tvocError);
+    return {static_cast<uint16_t>(co2Reading), static_cast<uint16_t>(tvocReading)};
+}
+
+
+std::tuple<uint16_t, uint16_t> SGP30Model::getBaseline()
+{
+    update();
+    return {static_cast<uint16_t>(std::lround(_co2Baseline)), static_cast<uint16_t>(std::lround(_tvocBaseline))};
+}
+
+
+void SGP30Model::setBaseline(uint16_t co2Baseline, uint16_t tvocBaseline)
+{
+    update();
+    _co2Baseline = co2Baseline;
+    _tvocBaseline = tvocBaseline;
+}
+
+
+uint16_t SGP30Model::getTvocInceptiveBaseline()
+{
+    const auto tvocCleanAir = std::get<1>(getCleanAirBaseline());
+    return static_cast<uint16_t>(std::lround(tvocCleanAir + cInceptiveTvocOffset));
+}
+
+
+void SGP30Model::setTvocBaseline(uint16_t tvocBaseline)
+{
+    update();
+    _tvocBaseline = tvocBaseline;
+}
+
+
+void SGP30Model::setAbsoluteHumidity(uint16_t absoluteHumidity)
+{
+    update();
+    if (absoluteHumidity == 0) {
+        _compensationHumidity = cReferenceHumidity;
+    } else {
+        _compensationHumidity = static_cast<double>(absoluteHumidity) / 256.0;
+    }
+}
+
+
+SGP30Model::Accuracy SGP30Model::getAccuracy() const
+{
+    Accuracy result = {};
+    result.measurements = _measurements;
+    result.initPhaseMeasurements = _initPhaseMeasurements;
+    if (_measurements > 0) {
+        result.co2MeanError = _co2ErrorSum / static_cast<double>(_measurements);
+        result.tvocMeanError = _tvocErrorSum / static_cast<double>(_measurements);
+    }
+    result.co2MaximumError = _co2MaximumError;
+    result.tvocMaximumError = _tvocMaximumError;
+    return result;
+}
+
+
+void SGP30Model::resetAccuracy()
+{
+    _measurements = 0;
+    _initPhaseMeasurements = 0;
+    _co2ErrorSum = 0.0;
+    _co2MaximumError = 0.0;
+    _tvocErrorSum = 0.0;
+    _tvocMaximumError = 0.0;
+}
+
+
+void SGP30Model::update()
+{
+    const auto now = _timeSource.now();
+    if (now <= _lastUpdate) {
+        return;
+    }
+    if (_isInitialized) {
+        // The baseline compensation only works while the sensor is measuring.
+        const auto [co2CleanAir, tvocCleanAir] = getCleanAirBaseline();
+        const auto factor = 1.0 - std::exp(-std::chrono::duration<double>(now - _lastUpdate).count() /
+            std::chrono::duration<double>(cBaselineTimeConstant).count());
+        _co2Baseline += (co2CleanAir - _co2Baseline) * factor;
+        _tvocBaseline += (tvocCleanAir - _tvocBaseline) * factor;
+    }
+    _lastUpdate = now;
+}
+
+
+std::tuple<double, double> SGP30Model::getCleanAirBaseline() const
+{
+    const auto age = Days(_timeSource.now() - _startTime).count();
+    return {cCleanAirCo2Baseline + _co2Drift * age, cCleanAirTvocBaseline + _tvocDrift * age};
+}
+
+
+}
+
@@ -0,0 +1,187 @@
+#pragma once
+//
+// (c)2020 by Lucky Resistor. See LICENSE for details.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+
+
+#include "TimeSource.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <tuple>
+
+
+namespace lr {
+
+
+/// A behavioural model of the SGP30, running on a time source.
+///
+/// The model is a simplified version of the behaviour described in the datasheet, detailed
+/// enough to compare strategies for the warm start and the baseline persistence:
+///
+/// - For 15 seconds after `iaq_init`, the sensor returns fixed values of 400 ppm and 0 ppb.
+/// - The sensor compares the signal with a baseline. After `iaq_init`, the baseline starts
+///   with an offset, and converges to the real clean air signal with a time constant of
+///   12 hours, as long as the sensor is measuring. `set_iaq_baseline` replaces the baseline.
+/// - The real clean air signal drifts over the lifetime of the sensor, so a restored baseline
+///   gets less accurate with its age.
+/// - The TVOC signal depends on the humidity. The sensor compensates a difference between
+///   the ambient humidity and the value set with `set_absolute_humidity`. Without a value,
+///   the model assumes a reference humidity of 10 g/m³.
+///
+/// The environment changes in a daily cycle. The model compares each reading with the real
+/// values of the environment and collects the errors.
+///
+class SGP30Model
+{
+public:
+    /// The environment of the sensor.
+    ///
+    struct Environment {
+        double co2; ///< The mean CO2eq value in ppm.
+        double co2DailyAmplitude; ///< The amplitude of the daily cycle of the CO2eq value.
+        double tvoc; ///< The mean TVOC value in ppb.
+        double tvocDailyAmplitude; ///< The amplitude of the daily cycle of the TVOC value.
+        double absoluteHumidity; ///< The absolute humidity in g/m³.
+    };
+
+    /// The accuracy of the readings.
+    ///
+    struct Accuracy {
+        uint64_t measurements; ///< The number of measurements after the initialization phase.
+        uint64_t initPhaseMeasurements; ///< The number of measurements in the initialization phase.
+        double co2MeanError; ///< The mean absolute CO2eq error in ppm.
+        double co2MaximumError; ///< The maximum absolute CO2eq error in ppm.
+        double tvocMeanError; ///< The mean absolute TVOC error in ppb.
+        double tvocMaximumError; ///< The maximum absolute TVOC error in ppb.
+    };
+
+    /// The time after `iaq_init` with fixed values.
+    ///
+    static constexpr auto cInitPhase = std::chrono::seconds(15);
+
+    /// The time constant of the baseline compensation.
+    ///
+    static constexpr auto cBaselineTimeConstant = std::chrono::hours(12);
+
+    /// The default environment, an office with a daily cycle.
+    ///
+    static const Environment cDefaultEnvironment;
+
+public:
+    /// Create a new model.
+    ///
+    /// @param timeSource The time source, usually a simulated time.
+    ///
+    explicit SGP30Model(TimeSource &timeSource);
+
+public:
+    /// Set the environment.
+    ///
+    /// @param environment The environment.
+    ///
+    void setEnvironment(const Environment &environment);
+
+    /// Set the drift of the clean air signal.
+    ///
+    /// @param co2PerDay The drift of the CO2eq baseline per day, in baseline units.
+    /// @param tvocPerDay The drift of the TVOC baseline per day, in baseline units.
+    ///
+    void setBaselineDrift(double co2PerDay, double tvocPerDay);
+
+    /// Simulate a power cycle or soft reset, which stops the measurements.
+    ///
+    void reset();
+
+    /// Handle `iaq_init`.
+    ///
+    void initialize();
+
+    /// Check if the measurements are initialized.
+    ///
+    bool isInitialized() const;
+
+    /// Handle `measure_iaq`.
+    ///
+    /// @return The CO2eq value in ppm and the TVOC value in ppb.
+    ///
+    std::tuple<uint16_t, uint16_t> measure();
+
+    /// Handle `get_iaq_baseline`.
+    ///
+    /// @return The CO2eq and the TVOC baseline.
+    ///
+    std::tuple<uint16_t, uint16_t> getBaseline();
+
+    /// Handle `set_iaq_baseline`.
+    ///
+    void setBaseline(uint16_t co2Baseline, uint16_t tvocBaseline);
+
+    /// Handle `get_tvoc_inceptive_baseline`.
+    ///
+    uint16_t getTvocInceptiveBaseline();
+
+    /// Handle `set_tvoc_baseline`.
+    ///
+    void setTvocBaseline(uint16_t tvocBaseline);
+
+    /// Handle `set_absolute_humidity`.
+    ///
+    /// @param absoluteHumidity The absolute humidity in g/m³ as 8.8 fixed-point value, zero to disable.
+    ///
+    void setAbsoluteHumidity(uint16_t absoluteHumidity);
+
+    /// Get the accuracy of all readings since the last call of `resetAccuracy()`.
+    ///
+    Accuracy getAccuracy() const;
+
+    /// Reset the collected accuracy.
+    ///
+    void resetAccuracy();
+
+private:
+    /// Update the drift and the baseline compensation up to the current time.
+    ///
+    void update();
+
+    /// Get the real clean air baseline at the current time.
+    ///
+    std::tuple<double, double> getCleanAirBaseline() const;
+
+private:
+    TimeSource &_timeSource; ///< The time source.
+    TimeSource::TimePoint _startTime; ///< The time of the creation of the model.
+    TimeSource::TimePoint _lastUpdate; ///< The time of the last update.
+    TimeSource::TimePoint _initTime; ///< The time of the last `iaq_init`.
+    Environment _environment; ///< The environment.
+    double _co2Drift; ///< The drift of the CO2eq baseline per day.
+    double _tvocDrift; ///< The drift of the TVOC baseline per day.
+    bool _isInitialized; ///< If the measurements are initialized.
+    double _co2Baseline; ///< The current CO2eq baseline of the sensor.
+    double _tvocBaseline; ///< The current TVOC baseline of the sensor.
+    double _compensationHumidity; ///< The humidity used for the compensation, in g/m³.
+    uint64_t _measurements; ///< The number of rated measurements.
+    uint64_t _initPhaseMeasurements; ///< The number of measurements in the initialization phase.
+    double _co2ErrorSum; ///< The sum of the absolute CO2eq errors.
+    double _co2MaximumError; ///< The maximum absolute CO2eq error.
+    double _tvocErrorSum; ///< The sum of the absolute TVOC errors.
+    double _tvocMaximumError; ///< The maximum absolute TVOC error.
+};
+
+
+}
+
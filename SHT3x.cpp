@@ -0,0 +1,73 @@
+//
+// (c)2020 by Lucky Resistor. See LICENSE for details.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+#include "SHT3x.hpp"
+
+
+#include "I2CBus.hpp"
+
+#include <chrono>
+
+
+namespace lr {
+
+
+using namespace std::chrono;
+
+
+namespace {
+/// Single shot measurement, high repeatability, without clock stretching.
+constexpr uint16_t cMeasureHighRepeatability = 0x2400;
+}
+
+
+SHT3x::SHT3x(int i2cBus, bool debuggingEnabled, uint8_t chipAddress)
+    : HumiditySensor(chipAddress, i2cBus, debuggingEnabled)
+{
+}
+
+
+SHT3x::SHT3x(I2CBus *bus, uint8_t chipAddress)
+    : HumiditySensor(bus, chipAddress)
+{
+}
+
+
+SHT3x::MeasurementResult SHT3x::readTemperatureAndHumidity()
+{
+    const I2CBus::Transaction transaction(_bus);
+    if (hasError(transaction.getStatus())) {
+        return MeasurementResult::error(transaction.getStatus(), getErrorDetail(transaction.getStatus()));
+    }
+    if (const auto status = sendRawCommand(cMeasureHighRepeatability); hasError(status)) {
+        return MeasurementResult::error(status, getErrorDetail(status));
+    }
+    waitForResult(16ms);
+    const auto result = readTwoValuesResult();
+    if (hasError(result)) {
+        return MeasurementResult::error(result);
+    }
+    // The conversion formulas are from the datasheet of the sensor.
+    const auto [rawTemperature, rawHumidity] = result.getValue();
+    const double temperature = -45.0 + 175.0 * (static_cast<double>(rawTemperature) / 65535.0);
+    const double humidity = 100.0 * (static_cast<double>(rawHumidity) / 65535.0);
+    return MeasurementResult::success(std::make_tuple(temperature, humidity));
+}
+
+
+}
+
@@ -0,0 +1,62 @@
+#pragma once
+//
+// (c)2020 by Lucky Resistor. See LICENSE for details.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+
+
+#include "HumiditySensor.hpp"
+
+
+namespace lr {
+
+
+/// A class to access the SHT3x (SHT30, SHT31, SHT35) sensors.
+///
+class SHT3x : public HumiditySensor
+{
+public:
+    /// The default address of the sensor.
+    ///
+    static constexpr uint8_t cDefaultAddress = 0x44;
+
+public:
+    /// Create a new access object for the SHT3x sensor.
+    ///
+    /// @param i2cBus The I2C bus to use.
+    /// @param debuggingEnabled If debugging messages shall be enabled.
+    /// @param chipAddress The address of the sensor, 0x44 or 0x45.
+    ///
+    explicit SHT3x(int i2cBus = 1, bool debuggingEnabled = false, uint8_t chipAddress = cDefaultAddress);
+
+    /// Create a new access object for a SHT3x sensor on a shared bus.
+    ///
+    /// @param bus The bus to use.
+    /// @param chipAddress The address of the sensor, 0x44 or 0x45.
+    ///
+    explicit SHT3x(I2CBus *bus, uint8_t chipAddress = cDefaultAddress);
+
+    /// dtor
+    ///
+    ~SHT3x() override = default;
+
+public: // Implement HumiditySensor
+    MeasurementResult readTemperatureAndHumidity() override;
+};
+
+
+}
+
@@ -0,0 +1,65 @@
+#pragma once
+//
+// (c)2020 by Lucky Resistor. See LICENSE for details.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+
+
+#include "SpscQueue.hpp"
+#include "StatusTools.hpp"
+
+#include <cstdint>
+
+
+namespace lr {
+
+
+/// One reading of a sensor, as passed from the sensor thread to the processing thread.
+///
+/// The record has a fixed size and is trivially copyable, so it fits into a single cache line
+/// of the sample queue.
+///
+struct SampleRecord {
+    /// The flags for the optional values.
+    ///
+    enum Flags : uint8_t {
+        HasHumidity = 0x01u, ///< `temperature` and `humidity` are set.
+        HasRawSignals = 0x02u, ///< `rawH2` and `rawEthanol` are set.
+    };
+
+    int64_t timestamp; ///< The time of the reading, in nanoseconds of the time source.
+    uint64_t serialNumber; ///< The serial number of the sensor.
+    uint16_t sensorId; ///< The index of the sensor in the sampler.
+    uint16_t co2; ///< The CO2 equivalent in ppm.
+    uint16_t tvoc; ///< The TVOC value in ppb.
+    uint16_t rawH2; ///< The raw H2 signal.
+    uint16_t rawEthanol; ///< The raw ethanol signal.
+    CallStatus status; ///< The status of the reading. The values are only valid on success.
+    uint8_t flags; ///< A combination of `Flags`.
+    float temperature; ///< The temperature used for the humidity compensation, in celsius.
+    float humidity; ///< The relative humidity used for the humidity compensation, in percent.
+};
+
+static_assert(sizeof(SampleRecord) <= cCacheLineSize, "A sample record must fit into one cache line.");
+
+
+/// The queue of samples from the sensor thread to the processing thread.
+///
+using SampleQueue = SpscQueue<SampleRecord, 256>;
+
+
+}
+
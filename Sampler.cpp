@@ -0,0 +1,645 @@
+//
+// (c)2020 by Lucky Resistor. See LICENSE for details.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+#include "Sampler.hpp"
+
+
+#include "AbsoluteHumidity.hpp"
+#include "I2CBus.hpp"
+#include "MeasurementFormat.hpp"
+#include "StatusMessage.hpp"
+
+#include <sys/prctl.h>
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+
+
+namespace lr {
+
+
+using namespace std::chrono;
+
+
+namespace {
+/// The time the sensor needs after initializing without a baseline, before the baseline is valid.
+constexpr auto cFirstBaselineWithoutRestore = 12h;
+
+/// The timer slack in the low-power mode.
+constexpr auto cLowPowerTimerSlack = 50ms;
+
+/// The number of cycles between two flushes of the output in the low-power mode.
+constexpr uint64_t cLowPowerFlushCycles = 10;
+
+/// Write the error of a failed call to `std::cerr`.
+///
+void writeError(const char *action, const std::string &message)
+{
+    std::cerr << "Failed to " << action << ". " << message << std::endl;
+}
+}
+
+
+std::atomic<bool> Sampler::_stopRequested(false);
+std::atomic<bool> Sampler::_statisticsRequested(false);
+
+
+Sampler::Sampler(BaselineStore &baselineStore, std::ostream &output)
+:
+    _baselineStore(baselineStore),
+    _output(&output),
+    _outputPipeline(nullptr),
+    _sensors(),
+    _interval(1s),
+    _baselineStoreInterval(1h),
+    _humidityInterval(60s),
+    _humidityFeed(nullptr),
+    _recovery(),
+    _timeSource(&getRealTimeSource()),
+    _runDuration(0),
+    _sampleLatency(),
+    _perfCounters(nullptr),
+    _isLowPower(false),
+    _outputFormat(OutputFormat::Json),
+    _recordWriter(OutputFormat::Cbor),
+    _isRawSignalsEnabled(false),
+    _isProcessingThreadEnabled(false),
+    _sampleQueue(),
+    _sampleEvent(),
+    _processingThread(),
+    _isProcessingStopRequested(false),
+    _queuedSampleCount(0),
+    _droppedSampleCount(0),
+    _runStart(),
+    _cycleCount(0),
+    _startUsage()
+{
+}
+
+
+void Sampler::addSensor(SGP30 *sensor, HumiditySensor *humiditySensor)
+{
+    _sensors.push_back(SensorState{sensor, humiditySensor, 0, false, {}, {}, std::nullopt, std::nullopt, false});
+}
+
+
+void Sampler::setInterval(std::chrono::milliseconds interval)
+{
+    _interval = interval;
+}
+
+
+void Sampler::setOutputFormat(OutputFormat format)
+{
+    _outputFormat = format;
+    _recordWriter = BinaryRecordWriter(format);
+}
+
+
+void Sampler::setOutputPipeline(OutputPipeline *pipeline)
+{
+    _outputPipeline = pipeline;
+    _output = &pipeline->getStream();
+}
+
+
+void Sampler::setLowPower(bool enabled)
+{
+    _isLowPower = enabled;
+}
+
+
+void Sampler::setProcessingThread(bool enabled)
+{
+    _isProcessingThreadEnabled = enabled;
+}
+
+
+void Sampler::setRawSignals(bool enabled)
+{
+    _isRawSignalsEnabled = enabled;
+}
+
+
+void Sampler::setBaselineStoreInterval(std::chrono::seconds interval)
+{
+    _baselineStoreInterval = interval;
+}
+
+
+void Sampler::setHumidityInterval(std::chrono::seconds interval)
+{
+    _humidityInterval = interval;
+}
+
+
+void Sampler::setHumidityFeed(HumidityFeed *humidityFeed)
+{
+    _humidityFeed = humidityFeed;
+}
+
+
+void Sampler::setRecoveryPolicy(const RecoveryEngine::Policy &policy)
+{
+    _recovery.setPolicy(policy);
+}
+
+
+void Sampler::setTimeSource(TimeSource *timeSource)
+{
+    _timeSource = (timeSource != nullptr) ? timeSource : &getRealTimeSource();
+    _recovery.setTimeSource(_timeSource);
+}
+
+
+void Sampler::setPerfCounters(PerfCounters *perfCounters)
+{
+    _perfCounters = perfCounters;
+}
+
+
+void Sampler::setRunDuration(Clock::duration duration)
+{
+    _runDuration = duration;
+}
+
+
+Sampler::Status Sampler::run()
+{
+    _stopRequested = false;
+    bool anySensorRunning = false;
+    for (auto &state : _sensors) {
+        state.sensor->setTimeSource(_timeSource);
+        if (state.humiditySensor != nullptr) {
+            state.humiditySensor->setTimeSource(_timeSource);
+        }
+        if (isSuccessful(startSensor(state))) {
+            anySensorRunning = true;
+        }
+    }
+    if (!anySensorRunning) {
+        return Status::Error;
+    }
+    if (const auto status = startProcessingThread(); hasError(status)) {
+        return status;
+    }
+    int previousTimerSlack = -1;
+    if (_isLowPower) {
+        previousTimerSlack = prctl(PR_GET_TIMERSLACK, 0, 0, 0, 0);
+        prctl(PR_SET_TIMERSLACK, static_cast<unsigned long>(nanoseconds(cLowPowerTimerSlack).count()), 0, 0, 0);
+    }
+    _cycleCount = 0;
+    _startUsage = getActivityUsage();
+    _runStart = _timeSource->now();
+    auto nextSample = _runStart;
+    const auto endTime = nextSample + _runDuration;
+    while (!_stopRequested && (_runDuration.count() == 0 || _timeSource->now() < endTime)) {
+        auto now = _timeSource->now();
+        if (_perfCounters != nullptr) {
+            _perfCounters->start();
+        }
+        for (auto &state : _sensors) {
+            if (state.isRunning) {
+                sampleSensor(state, now);
+            }
+        }
+        _cycleCount += 1;
+        if (!_isLowPower) {
+            flushOutput();
+        }
+        now = _timeSource->now();
+        bool anyBaselineStored = false;
+        for (auto &state : _sensors) {
+            if (state.isRunning && storeBaselineIfDue(state, now)) {
+                anyBaselineStored = true;
+            }
+        }
+        if (anyBaselineStored) {
+            _baselineStore.sync();
+        }
+        if (_isLowPower) {
+            startMeasurements();
+        }
+        if (_perfCounters != nullptr) {
+            const bool isOutputUsable = (_outputFormat == OutputFormat::Json && !_isProcessingThreadEnabled);
+            auto &perfOutput = isOutputUsable ? *_output : std::cerr;
+            perfOutput << "{ \"perf\": ";
+            _perfCounters->stop().writeJson(perfOutput);
+            perfOutput << " }\n";
+            if (isOutputUsable) {
+                commitRecord();
+            }
+            if (!_isLowPower) {
+                perfOutput.flush();
+            }
+        }
+        if (_isLowPower && _cycleCount % cLowPowerFlushCycles == 0) {
+            flushOutput();
+        }
+        if (_statisticsRequested.exchange(false)) {
+            writeStatistics(std::cerr);
+        }
+        nextSample += _interval;
+        _timeSource->sleepUntil(nextSample);
+    }
+    stopProcessingThread();
+    _output->flush();
+    _baselineStore.sync();
+    if (previousTimerSlack >= 0) {
+        prctl(PR_SET_TIMERSLACK, static_cast<unsigned long>(previousTimerSlack), 0, 0, 0);
+    }
+    return Status::Success;
+}
+
+
+void Sampler::requestStop()
+{
+    _stopRequested = true;
+}
+
+
+void Sampler::requestStatistics()
+{
+    _statisticsRequested = true;
+}
+
+
+void Sampler::writeStatistics(std::ostream &output) const
+{
+    std::vector<const SensirionSensor*> sensors;
+    for (const auto &state : _sensors) {
+        sensors.push_back(state.sensor);
+        if (state.humiditySensor != nullptr) {
+            sensors.push_back(state.humiditySensor);
+        }
+    }
+    SensirionSensor::writeStatisticsJson(output, sensors);
+    output << "\n{ \"recovery\": ";
+    _recovery.getStatistics().writeJson(output);
+    output << ", \"sample_latency\": ";
+    _sampleLatency.writeJson(output);
+    const auto usage = getActivityUsage();
+    const auto elapsed = duration<double>(_timeSource->now() - _runStart).count();
+    const auto wakeups = usage.wakeups - _startUsage.wakeups;
+    const auto cpuTime = duration<double, std::milli>(usage.cpuTime - _startUsage.cpuTime).count();
+    output << ", \"activity\": { \"elapsed_s\": " << std::fixed << std::setprecision(3) << elapsed
+        << ", \"cycles\": " << _cycleCount
+        << ", \"wakeups\": " << wakeups
+        << ", \"wakeups_per_s\": " << ((elapsed > 0.0) ? static_cast<double>(wakeups) / elapsed : 0.0)
+        << ", \"cpu_ms\": " << cpuTime
+        << ", \"cpu_us_per_cycle\": " << ((_cycleCount > 0) ? cpuTime * 1000.0 / static_cast<double>(_cycleCount) : 0.0)
+        << std::defaultfloat << " }";
+    if (_isProcessingThreadEnabled) {
+        output << ", \"sample_queue\": { \"samples\": " << _queuedSampleCount
+            << ", \"dropped\": " << _droppedSampleCount << " }";
+    }
+    if (_outputPipeline != nullptr) {
+        output << ", \"output\": ";
+        _outputPipeline->writeStatisticsJson(output);
+    }
+    output << " }" << std::endl;
+}
+
+
+const LatencyHistogram &Sampler::getSampleLatency() const
+{
+    return _sampleLatency;
+}
+
+
+Sampler::Status Sampler::startSensor(SensorState &state)
+{
+    const auto serialResult = state.sensor->readSerialNumberValue();
+    if (hasError(serialResult)) {
+        writeError("read the serial number of the sensor", getStatusMessage(serialResult));
+        return serialResult.getStatus();
+    }
+    state.serialNumber = serialResult.getValue();
+    if (const auto status = warmStartSensor(state); hasError(status)) {
+        return status;
+    }
+    state.nextHumidityUpdate = _timeSource->now() + _humidityInterval;
+    state.isRunning = true;
+    return Status::Success;
+}
+
+
+Sampler::Status Sampler::warmStartSensor(SensorState &state)
+{
+    const I2CBus::Transaction transaction(state.sensor->getBus());
+    if (hasError(transaction.getStatus())) {
+        writeError("lock the bus", getStatusMessage(transaction.getStatus()));
+        return transaction.getStatus();
+    }
+    std::optional<SGP30::BaselineValues> baselineValues;
+    if (const auto baselineResult = _baselineStore.findRestorable(state.serialNumber); isSuccessful(baselineResult)) {
+        baselineValues = baselineResult.getValue();
+    }
+    const auto warmStartResult = state.sensor->warmStart(baselineValues, std::nullopt);
+    if (hasError(warmStartResult)) {
+        writeError("initialize the measurements of the sensor", getStatusMessage(warmStartResult));
+        return warmStartResult.getStatus();
+    }
+    if (_humidityFeed == nullptr && state.humiditySensor != nullptr) {
+        updateHumidityCompensation(state);
+    }
+    // The datasheet recommends to store the first baseline after one hour of operation
+    // with a restored baseline, and after twelve hours without one.
+    if (warmStartResult.getValue() == SGP30::BaselineSource::IAQBaseline) {
+        state.nextBaselineStore = _timeSource->now() + _baselineStoreInterval;
+    } else {
+        state.nextBaselineStore = _timeSource->now() + std::max<Clock::duration>(_baselineStoreInterval, cFirstBaselineWithoutRestore);
+    }
+    state.isMeasurementPending = false;
+    return Status::Success;
+}
+
+
+Sampler::Status Sampler::restartSensor(SensorState &state)
+{
+    if (const auto status = state.sensor->softReset(); hasError(status)) {
+        return status;
+    }
+    state.absoluteHumidity.reset(); // the reset cleared the humidity compensation.
+    return warmStartSensor(state);
+}
+
+
+void Sampler::sampleSensor(SensorState &state, Clock::time_point now)
+{
+    const auto startTime = Clock::now();
+    auto readResult = SGP30::MeasurentResult::error();
+    auto rawSignalsResult = SGP30::RawSignalsResult::error();
+    const auto status = _recovery.run(state.sensor->getBus(), [&]() -> Status {
+        const I2CBus::Transaction transaction(state.sensor->getBus());
+        if (hasError(transaction.getStatus())) {
+            readResult = SGP30::MeasurentResult::error(transaction.getStatus());
+            return transaction.getStatus();
+        }
+        if (state.isMeasurementPending) {
+            // The result must be read before any other command is sent to the sensor.
+            state.isMeasurementPending = false;
+            readResult = state.sensor->readMeasurementResult();
+            if (isSuccessful(readResult)) {
+                updateHumidityIfDue(state, now);
+            }
+        } else {
+            updateHumidityIfDue(state, now);
+            readResult = state.sensor->readMeasurements();
+        }
+        if (isSuccessful(readResult) && _isRawSignalsEnabled) {
+            rawSignalsResult = state.sensor->readRawSignals();
+            return rawSignalsResult.getStatus();
+        }
+        return readResult.getStatus();
+    }, [&]() -> Status {
+        return restartSensor(state);
+    });
+    if (hasError(status)) {
+        if (hasError(readResult)) {
+            writeError("read the measurements", getStatusMessage(readResult));
+        } else {
+            writeError("read the raw signals", getStatusMessage(rawSignalsResult));
+        }
+        if (_isProcessingThreadEnabled) {
+            queueSample(state, status, MeasurementRecord{});
+        }
+        return;
+    }
+    const auto [co2, tvoc] = readResult.getValue();
+    MeasurementRecord record{co2, tvoc, state.serialNumber, state.humidityValues};
+    if (_isRawSignalsEnabled) {
+        record.rawSignals = rawSignalsResult.getValue();
+    }
+    if (_isProcessingThreadEnabled) {
+        queueSample(state, status, record);
+    } else {
+        writeSample(record);
+    }
+    _sampleLatency.record(Clock::now() - startTime);
+}
+
+
+void Sampler::updateHumidityIfDue(SensorState &state, Clock::time_point now)
+{
+    if (_humidityFeed != nullptr) {
+        if (const auto feedResult = _humidityFeed->getLatest(); isSuccessful(feedResult)) {
+            applyHumidityCompensation(state, feedResult.getValue());
+        }
+    } else if (state.humiditySensor != nullptr && now >= state.nextHumidityUpdate) {
+        state.nextHumidityUpdate = now + _humidityInterval;
+        updateHumidityCompensation(state);
+    }
+}
+
+
+void Sampler::startMeasurements()
+{
+    for (auto &state : _sensors) {
+        if (state.isRunning) {
+            // A failed start is recovered by a complete reading in the next cycle.
+            state.isMeasurementPending = isSuccessful(state.sensor->startMeasurement());
+        }
+    }
+}
+
+
+void Sampler::commitRecord()
+{
+    if (_outputPipeline != nullptr) {
+        _outputPipeline->commitRecord();
+    }
+}
+
+
+void Sampler::flushOutput()
+{
+    if (_isProcessingThreadEnabled) {
+        _sampleEvent.wake();
+    } else {
+        _output->flush();
+    }
+}
+
+
+void Sampler::writeSample(const MeasurementRecord &record)
+{
+    if (_outputFormat == OutputFormat::Json) {
+        writeMeasurementJson(*_output, record);
+        *_output << '\n';
+    } else {
+        _recordWriter.clear();
+        _recordWriter.writeMeasurement(record);
+        _recordWriter.writeTo(*_output);
+    }
+    commitRecord();
+}
+
+
+void Sampler::queueSample(const SensorState &state, Status status, const MeasurementRecord &record)
+{
+    SampleRecord sample{};
+    sample.timestamp = duration_cast<nanoseconds>(_timeSource->now().time_since_epoch()).count();
+    sample.serialNumber = state.serialNumber;
+    sample.sensorId = static_cast<uint16_t>(&state - _sensors.data());
+    sample.co2 = record.co2;
+    sample.tvoc = record.tvoc;
+    sample.status = status;
+    if (record.humidityValues.has_value()) {
+        sample.flags |= SampleRecord::HasHumidity;
+        sample.temperature = static_cast<float>(std::get<0>(record.humidityValues.value()));
+        sample.humidity = static_cast<float>(std::get<1>(record.humidityValues.value()));
+    }
+    if (record.rawSignals.has_value()) {
+        sample.flags |= SampleRecord::HasRawSignals;
+        std::tie(sample.rawH2, sample.rawEthanol) = record.rawSignals.value();
+    }
+    if (_sampleQueue->pushDroppingOldest(sample)) {
+        _droppedSampleCount += 1;
+    }
+    _queuedSampleCount += 1;
+}
+
+
+Sampler::Status Sampler::startProcessingThread()
+{
+    if (!_isProcessingThreadEnabled) {
+        return Status::Success;
+    }
+    if (_sampleQueue == nullptr) {
+        _sampleQueue = std::make_unique<SampleQueue>();
+    }
+    if (hasError(_sampleEvent.open())) {
+        writeError("start the processing thread", std::strerror(errno));
+        return Status::IoError;
+    }
+    _isProcessingStopRequested = false;
+    _processingThread = std::thread([this]() { runProcessingThread(); });
+    return Status::Success;
+}
+
+
+void Sampler::stopProcessingThread()
+{
+    if (!_processingThread.joinable()) {
+        return;
+    }
+    _isProcessingStopRequested.store(true, std::memory_order_release);
+    _sampleEvent.signal();
+    _processingThread.join();
+    _sampleEvent.close();
+}
+
+
+void Sampler::runProcessingThread()
+{
+    SampleRecord sample;
+    while (true) {
+        // Read the flag first, so all samples queued before the stop are seen.
+        const auto isStopRequested = _isProcessingStopRequested.load(std::memory_order_acquire);
+        bool hasSamples = false;
+        while (_sampleQueue->tryPop(sample)) {
+            hasSamples = true;
+            if (hasError(sample.status)) {
+                continue;
+            }
+            MeasurementRecord record{sample.co2, sample.tvoc, sample.serialNumber};
+            if ((sample.flags & SampleRecord::HasHumidity) != 0) {
+                record.humidityValues = std::make_tuple(static_cast<double>(sample.temperature),
+                    static_cast<double>(sample.humidity));
+            }
+            if ((sample.flags & SampleRecord::HasRawSignals) != 0) {
+                record.rawSignals = std::make_tuple(sample.rawH2, sample.rawEthanol);
+            }
+            writeSample(record);
+        }
+        if (hasSamples) {
+            _output->flush();
+        }
+        if (isStopRequested) {
+            break;
+        }
+        _sampleEvent.wait([this]() {
+            return _sampleQueue->getSize() > 0 || _isProcessingStopRequested.load(std::memory_order_relaxed);
+        });
+    }
+}
+
+
+Sampler::ActivityUsage Sampler::getActivityUsage()
+{
+    rusage usage = {};
+    getrusage(RUSAGE_THREAD, &usage);
+    return ActivityUsage{
+        static_cast<uint64_t>(usage.ru_nvcsw),
+        seconds(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec)
+            + microseconds(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec)};
+}
+
+
+Sampler::Status Sampler::updateHumidityCompensation(SensorState &state)
+{
+    const auto humidityResult = state.humiditySensor->readTemperatureAndHumidity();
+    if (hasError(humidityResult)) {
+        writeError("read the humidity sensor", getStatusMessage(humidityResult));
+        return humidityResult.getStatus();
+    }
+    const auto [temperature, humidity] = humidityResult.getValue();
+    return applyHumidityCompensation(state, std::make_tuple(
+        static_cast<int32_t>(std::lround(temperature * 1000.0)),
+        static_cast<int32_t>(std::lround(humidity * 1000.0))));
+}
+
+
+Sampler::Status Sampler::applyHumidityCompensation(SensorState &state, const HumidityFeed::Values &values)
+{
+    const auto [temperature, humidity] = values;
+    state.humidityValues = std::make_tuple(temperature / 1000.0, humidity / 1000.0);
+    const auto absoluteHumidity = getAbsoluteHumidity(temperature, humidity);
+    if (state.absoluteHumidity == absoluteHumidity) {
+        return Status::Success; // skip redundant writes.
+    }
+    if (const auto status = state.sensor->setAbsoluteHumidity(absoluteHumidity); hasError(status)) {
+        writeError("set the humidity compensation", getStatusMessage(status, state.sensor->getErrorDetail(status)));
+        return status;
+    }
+    state.absoluteHumidity = absoluteHumidity;
+    return Status::Success;
+}
+
+
+bool Sampler::storeBaselineIfDue(SensorState &state, Clock::time_point now)
+{
+    if (now < state.nextBaselineStore) {
+        return false;
+    }
+    state.nextBaselineStore = now + _baselineStoreInterval;
+    const auto baselineResult = state.sensor->getIAQBaseline();
+    if (hasError(baselineResult)) {
+        writeError("read the baseline", getStatusMessage(baselineResult));
+        return false;
+    }
+    return isSuccessful(_baselineStore.store(state.serialNumber, baselineResult.getValue()));
+}
+
+
+}
+
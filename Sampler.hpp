@@ -0,0 +1,366 @@
+#pragma once
+//
+// (c)2020 by Lucky Resistor. See LICENSE for details.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+
+
+#include "BaselineStore.hpp"
+#include "BusStatistics.hpp"
+#include "HumidityFeed.hpp"
+#include "HumiditySensor.hpp"
+#include "MeasurementFormat.hpp"
+#include "OutputPipeline.hpp"
+#include "PerfCounters.hpp"
+#include "RecoveryEngine.hpp"
+#include "SampleRecord.hpp"
+#include "SGP30.hpp"
+#include "TimeSource.hpp"
+#include "WakeupEvent.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+
+namespace lr {
+
+
+/// Continuous sampling of one or more sensors.
+///
+/// At the start, the sampler makes a warm start of each sensor, using the stored baseline
+/// which matches the serial number of the sensor. Then it reads the
+/// measurements in regular intervals and writes one JSON line per reading. The baseline of
+/// each sensor is stored every hour.
+///
+/// A sensor can have a companion humidity sensor on the same bus. Its readings are used to
+/// update the humidity compensation of the SGP30 at a lower rate, in the same bus transaction
+/// as the measurement. Alternatively, the values are taken from an external humidity feed.
+/// The compensation is only written to the sensor if its value changes.
+///
+/// Failed readings are retried by a recovery engine, which reopens the bus and resets the
+/// sensor if retrying does not help.
+///
+/// In the low-power mode, all work of a cycle is done in a single wakeup: the result of the
+/// measurement started in the previous cycle is read, the baseline is stored if due, and the
+/// next measurement is started, instead of waiting 12ms for its result. The output is flushed
+/// every ten cycles, and the sleeps use a timer slack, so the kernel can merge the wakeups
+/// with other timers.
+///
+/// With a processing thread, the thread calling `run()` only does the bus I/O and stores the
+/// baseline. It passes each reading as fixed-size record through a lock-free queue to the
+/// processing thread, which formats and writes the output.
+///
+class Sampler
+{
+public:
+    using Status = CallStatus;
+    using Clock = std::chrono::steady_clock;
+
+public:
+    /// Create a new sampler.
+    ///
+    /// @param baselineStore The opened store for the baseline values.
+    /// @param output The stream for the JSON output.
+    ///
+    Sampler(BaselineStore &baselineStore, std::ostream &output);
+
+public:
+    /// Add a sensor to sample.
+    ///
+    /// @param sensor The sensor, with an open bus.
+    /// @param humiditySensor An optional humidity sensor on the same bus, for the humidity compensation.
+    ///
+    void addSensor(SGP30 *sensor, HumiditySensor *humiditySensor = nullptr);
+
+    /// Set the interval between two readings.
+    ///
+    /// @param interval The interval. The sensor requires readings every second.
+    ///
+    void setInterval(std::chrono::milliseconds interval);
+
+    /// Set the format of the samples.
+    ///
+    /// With a binary format, each sample is written as measurement record, and the values of
+    /// the performance counters are written as JSON lines to `std::cerr`.
+    ///
+    /// @param format The output format.
+    ///
+    void setOutputFormat(OutputFormat format);
+
+    /// Write the output into a pipeline, instead of the stream passed to the constructor.
+    ///
+    /// Each sample and each line of performance counters is committed as one record. The
+    /// pipeline is flushed with the same frequency as the stream would be.
+    ///
+    /// @param pipeline The started pipeline.
+    ///
+    void setOutputPipeline(OutputPipeline *pipeline);
+
+    /// Enable or disable the low-power mode.
+    ///
+    /// @param enabled `true` to do all work of a cycle in a single wakeup.
+    ///
+    void setLowPower(bool enabled);
+
+    /// Enable or disable the processing thread.
+    ///
+    /// If enabled, the values of the performance counters are written to `std::cerr`, as the
+    /// output belongs to the processing thread.
+    ///
+    /// @param enabled `true` to format and write the samples in a separate thread.
+    ///
+    void setProcessingThread(bool enabled);
+
+    /// Enable or disable reading the raw signals with each measurement.
+    ///
+    /// @param enabled `true` to read the raw signals, which adds up to 25ms to each reading.
+    ///
+    void setRawSignals(bool enabled);
+
+    /// Set the interval to store the baseline values.
+    ///
+    /// @param interval The interval.
+    ///
+    void setBaselineStoreInterval(std::chrono::seconds interval);
+
+    /// Set the interval to update the humidity compensation.
+    ///
+    /// @param interval The interval.
+    ///
+    void setHumidityInterval(std::chrono::seconds interval);
+
+    /// Set an external feed for the humidity compensation of all sensors.
+    ///
+    /// The feed replaces the readings of the humidity sensors. The latest values of
+    /// the feed are checked with every reading.
+    ///
+    /// @param humidityFeed The started feed, or `nullptr` to use the humidity sensors.
+    ///
+    void setHumidityFeed(HumidityFeed *humidityFeed);
+
+    /// Set the policy to recover from failed readings.
+    ///
+    /// @param policy The recovery policy.
+    ///
+    void setRecoveryPolicy(const RecoveryEngine::Policy &policy);
+
+    /// Set the source of time for the schedule.
+    ///
+    /// The time source is also used for the waits of all sensors and for the recovery.
+    /// Set the same time source for the baseline store.
+    ///
+    /// @param timeSource The time source, or `nullptr` for the real time.
+    ///
+    void setTimeSource(TimeSource *timeSource);
+
+    /// Measure each sampling cycle with performance counters.
+    ///
+    /// The counted values are written as JSON line after the measurements of the cycle.
+    ///
+    /// @param perfCounters The opened counters, or `nullptr` to disable the measurement.
+    ///
+    void setPerfCounters(PerfCounters *perfCounters);
+
+    /// Stop the sampler after the given duration.
+    ///
+    /// @param duration The duration, or zero to run until `requestStop()` is called.
+    ///
+    void setRunDuration(Clock::duration duration);
+
+    /// Run the sampler until `requestStop()` is called or the run duration is reached.
+    ///
+    /// @return The call status. `Error` if no sensor could be started.
+    ///
+    Status run();
+
+    /// Request the running sampler to stop.
+    ///
+    /// This method is safe to call from a signal handler.
+    ///
+    static void requestStop();
+
+    /// Request the running sampler to write the statistics of all sensors to `std::cerr`.
+    ///
+    /// This method is safe to call from a signal handler.
+    ///
+    static void requestStatistics();
+
+    /// Write the statistics of all sensors as JSON line.
+    ///
+    /// @param output The output stream.
+    ///
+    void writeStatistics(std::ostream &output) const;
+
+    /// Access the latency of the samples.
+    ///
+    /// The latency is the wall time to read, format and write one measurement, including
+    /// the recovery from failures.
+    ///
+    const LatencyHistogram &getSampleLatency() const;
+
+private:
+    /// The state of one sensor.
+    ///
+    struct SensorState {
+        SGP30 *sensor; ///< The sensor.
+        HumiditySensor *humiditySensor; ///< The optional humidity sensor.
+        uint64_t serialNumber; ///< The serial number of the sensor.
+        bool isRunning; ///< If the sensor was started successfully.
+        Clock::time_point nextBaselineStore; ///< The time for the next baseline store.
+        Clock::time_point nextHumidityUpdate; ///< The time for the next humidity compensation update.
+        std::optional<SGP30::HumidityValues> humidityValues; ///< The last humidity values.
+        std::optional<uint16_t> absoluteHumidity; ///< The last absolute humidity written to the sensor.
+        bool isMeasurementPending; ///< If a measurement was started in the low-power mode.
+    };
+
+    /// Read the serial number of a sensor and start it.
+    ///
+    Status startSensor(SensorState &state);
+
+    /// Initialize the measurements of a sensor and restore its baseline.
+    ///
+    Status warmStartSensor(SensorState &state);
+
+    /// Reset a sensor and initialize it again, to recover from a failure.
+    ///
+    Status restartSensor(SensorState &state);
+
+    /// The resource usage of the sampling thread.
+    ///
+    struct ActivityUsage {
+        uint64_t wakeups; ///< The number of voluntary context switches, one for each sleep.
+        std::chrono::microseconds cpuTime; ///< The used user and system CPU time.
+    };
+
+    /// Get the resource usage of the calling thread.
+    ///
+    static ActivityUsage getActivityUsage();
+
+    /// Read and write one measurement.
+    ///
+    /// @param state The sensor state.
+    /// @param now The current time.
+    ///
+    void sampleSensor(SensorState &state, Clock::time_point now);
+
+    /// Update the humidity compensation from the feed or the humidity sensor, if due.
+    ///
+    /// @param state The sensor state.
+    /// @param now The current time.
+    ///
+    void updateHumidityIfDue(SensorState &state, Clock::time_point now);
+
+    /// Start the next measurement of all running sensors, for the low-power mode.
+    ///
+    void startMeasurements();
+
+    /// End a record of the output, if the output is written into a pipeline.
+    ///
+    void commitRecord();
+
+    /// Flush the output, or wake the processing thread to write and flush it.
+    ///
+    void flushOutput();
+
+    /// Write a sample to the output.
+    ///
+    /// @param record The sample.
+    ///
+    void writeSample(const MeasurementRecord &record);
+
+    /// Add a reading to the sample queue of the processing thread.
+    ///
+    /// If the queue is full, the oldest sample is dropped, so the readings never wait.
+    ///
+    /// @param state The sensor state.
+    /// @param status The status of the reading.
+    /// @param record The sample, only used on success.
+    ///
+    void queueSample(const SensorState &state, Status status, const MeasurementRecord &record);
+
+    /// Start the processing thread, if it is enabled.
+    ///
+    Status startProcessingThread();
+
+    /// Write all queued samples and stop the processing thread.
+    ///
+    void stopProcessingThread();
+
+    /// The loop of the processing thread.
+    ///
+    void runProcessingThread();
+
+    /// Read the humidity sensor and update the humidity compensation.
+    ///
+    /// @param state The sensor state.
+    /// @return The call status.
+    ///
+    Status updateHumidityCompensation(SensorState &state);
+
+    /// Update the humidity compensation, if the absolute humidity changed.
+    ///
+    /// @param state The sensor state.
+    /// @param values The temperature and humidity values.
+    /// @return The call status.
+    ///
+    Status applyHumidityCompensation(SensorState &state, const HumidityFeed::Values &values);
+
+    /// Store the baseline of a sensor, if it is due.
+    ///
+    /// @return `true` if a value was stored.
+    ///
+    bool storeBaselineIfDue(SensorState &state, Clock::time_point now);
+
+private:
+    static std::atomic<bool> _stopRequested; ///< Flag if the sampler shall stop.
+    static std::atomic<bool> _statisticsRequested; ///< Flag if the sampler shall write the statistics.
+    BaselineStore &_baselineStore; ///< The store for the baseline values.
+    std::ostream *_output; ///< The stream for the output.
+    OutputPipeline *_outputPipeline; ///< The optional pipeline for the output.
+    std::vector<SensorState> _sensors; ///< The sampled sensors.
+    std::chrono::milliseconds _interval; ///< The interval between readings.
+    std::chrono::seconds _baselineStoreInterval; ///< The interval to store the baseline.
+    std::chrono::seconds _humidityInterval; ///< The interval to update the humidity compensation.
+    HumidityFeed *_humidityFeed; ///< The optional external humidity feed.
+    RecoveryEngine _recovery; ///< The recovery from failed readings.
+    TimeSource *_timeSource; ///< The source of time.
+    Clock::duration _runDuration; ///< The duration to run, zero for no limit.
+    LatencyHistogram _sampleLatency; ///< The latency of the samples.
+    PerfCounters *_perfCounters; ///< The optional performance counters for each cycle.
+    bool _isLowPower; ///< If the low-power mode is enabled.
+    OutputFormat _outputFormat; ///< The format of the samples.
+    BinaryRecordWriter _recordWriter; ///< The encoder for the binary formats.
+    bool _isRawSignalsEnabled; ///< If the raw signals are read with each measurement.
+    bool _isProcessingThreadEnabled; ///< If the samples are written by the processing thread.
+    std::unique_ptr<SampleQueue> _sampleQueue; ///< The queue to the processing thread.
+    WakeupEvent _sampleEvent; ///< The event to wake the processing thread.
+    std::thread _processingThread; ///< The processing thread.
+    std::atomic<bool> _isProcessingStopRequested; ///< If the processing thread shall stop, once the queue is empty.
+    uint64_t _queuedSampleCount; ///< The number of samples added to the queue.
+    uint64_t _droppedSampleCount; ///< The number of samples dropped from the full queue.
+    TimeSource::TimePoint _runStart; ///< The start time of the last run.
+    uint64_t _cycleCount; ///< The number of sampling cycles of the last run.
+    ActivityUsage _startUsage; ///< The resource usage at the start of the last run.
+};
+
+
+}
+
@@ -20,6 +20,8 @@
 
 #include "I2CBus.hpp"
 
+#include <algorithm>
+#include <iomanip>
 #include <iostream>
 #include <cmath>
 
@@ -28,25 +30,35 @@ namespace lr {
 
 
 SensirionSensor::SensirionSensor(uint8_t chipAddress, int i2cBus, bool debuggingEnabled)
+    : _bus(new I2CBus(chipAddress, i2cBus)), _chipAddress(chipAddress), _ownsBus(true),
+    _statistics(), _currentCommand(nullptr), _timeSource(&getRealTimeSource())
 {
-    _bus = new I2CBus(chipAddress, i2cBus);
     _bus->setDebugging(debuggingEnabled);
 }
 
 
+SensirionSensor::SensirionSensor(I2CBus *bus, uint8_t chipAddress)
+    : _bus(bus), _chipAddress(chipAddress), _ownsBus(false),
+    _statistics(), _currentCommand(nullptr), _timeSource(&getRealTimeSource())
+{
+}
+
+
 SensirionSensor::~SensirionSensor()
 {
-    if (_bus) { // forgot to close the bus?
-        _bus->closeBus();
+    if (_ownsBus) {
+        if (_bus) { // forgot to close the bus?
+            _bus->closeBus();
+        }
+        delete _bus;
     }
-    delete _bus;
 }
 
 
 SensirionSensor::Status SensirionSensor::openBus()
 {
-    if (hasError(_bus->openBus())) {
-        return Status::Error;
+    if (!_bus->isOpen()) {
+        return _bus->openBus();
     }
     return CallStatus::Success;
 }
@@ -55,25 +67,43 @@ SensirionSensor::Status SensirionSensor::openBus()
 SensirionSensor::Status SensirionSensor::closeBus()
 {
     if (_bus != nullptr) {
-        if (hasError(_bus->closeBus())) {
-            return Status::Error;
+        if (_ownsBus) {
+            if (hasError(_bus->closeBus())) {
+                return Status::Error;
+            }
+            delete _bus;
         }
-        delete _bus;
         _bus = nullptr;
     }
     return CallStatus::Success;
 }
 
 
+BusLock &SensirionSensor::getBusLock()
+{
+    return _bus->getBusLock();
+}
+
+
+I2CBus *SensirionSensor::getBus() const
+{
+    return _bus;
+}
+
+
 SensirionSensor::Status SensirionSensor::sendRawCommand(uint16_t command)
 {
     const uint8_t data[] = {
             static_cast<uint8_t>(command >> 8),
             static_cast<uint8_t>(command & 0x00ffu)};
-    if (hasError(_bus->writeData(data, 2))) {
-        return Status::Error;
-    }
-    return Status::Success;
+    return writeCommand(command, data, 2);
+}
+
+
+SensirionSensor::Status SensirionSensor::sendRawByteCommand(uint8_t command)
+{
+    const uint8_t data[] = {command};
+    return writeCommand(command, data, 1);
 }
 
 
@@ -82,13 +112,8 @@ SensirionSensor::Status SensirionSensor::sendRawCommand(uint16_t command, uint16
     uint8_t data[5];
     data[0] = static_cast<uint8_t>(command >> 8);
     data[1] = static_cast<uint8_t>(command & 0x00ffu);
-    data[2] = static_cast<uint8_t>(value >> 8);
-    data[3] = static_cast<uint8_t>(value & 0x00ffu);
-    data[4] = getCrc8(&data[2], 2);
-    if (hasError(_bus->writeData(data, 5))) {
-        return Status::Error;
-    }
-    return CallStatus::Success;
+    encodeValue(value, &data[2]);
+    return writeCommand(command, data, 5);
 }
 
 
@@ -97,41 +122,120 @@ SensirionSensor::Status SensirionSensor::sendRawCommand(uint16_t command, uint16
     uint8_t data[8];
     data[0] = static_cast<uint8_t>(command >> 8);
     data[1] = static_cast<uint8_t>(command & 0x00ffu);
-    data[2] = static_cast<uint8_t>(value1 >> 8);
-    data[3] = static_cast<uint8_t>(value1 & 0x00ffu);
-    data[4] = getCrc8(&data[2], 2);
-    data[5] = static_cast<uint8_t>(value2 >> 8);
-    data[6] = static_cast<uint8_t>(value2 & 0x00ffu);
-    data[7] = getCrc8(&data[5], 2);
-    if (hasError(_bus->writeData(data, 8))) {
-        return Status::Error;
+    encodeValue(value1, &data[2]);
+    encodeValue(value2, &data[5]);
+    return writeCommand(command, data, 8);
+}
+
+
+uint8_t SensirionSensor::getErrorDetail(Status status) const
+{
+    switch (status) {
+    case Status::Nack:
+    case Status::ShortRead:
+    case Status::Timeout:
+    case Status::IoError:
+        return _bus->getLastErrorDetail();
+    default:
+        return 0;
     }
-    return CallStatus::Success;
+}
+
+
+void SensirionSensor::waitForResult(std::chrono::milliseconds duration)
+{
+    const auto startTime = _timeSource->now();
+    if (!_bus->hasBackend() || !_timeSource->isRealTime()) { // A backend in real time provides the timing.
+        _timeSource->sleepFor(duration);
+    }
+    if (_currentCommand != nullptr) {
+        _currentCommand->wait.record(_timeSource->now() - startTime);
+    }
+}
+
+
+const SensorStatistics &SensirionSensor::getStatistics() const
+{
+    return _statistics;
+}
+
+
+void SensirionSensor::setTimeSource(TimeSource *timeSource)
+{
+    _timeSource = (timeSource != nullptr) ? timeSource : &getRealTimeSource();
+}
+
+
+void SensirionSensor::writeStatisticsJson(std::ostream &output, const std::vector<const SensirionSensor*> &sensors)
+{
+    std::vector<const I2CBus*> buses;
+    for (const auto sensor : sensors) {
+        if (sensor->_bus != nullptr && std::find(buses.begin(), buses.end(), sensor->_bus) == buses.end()) {
+            buses.push_back(sensor->_bus);
+        }
+    }
+    output << "{ \"buses\": [";
+    for (std::size_t i = 0; i < buses.size(); ++i) {
+        const auto &lockStatistics = buses[i]->getBusLock().getStatistics();
+        output << (i > 0 ? ", " : " ") << "{ \"bus\": " << buses[i]->getBusId() << ", \"transfers\": ";
+        buses[i]->getStatistics().writeJson(output);
+        output << ", \"lock\": { \"acquisitions\": " << lockStatistics.acquisitions
+            << ", \"contentions\": " << lockStatistics.contentions
+            << ", \"timeouts\": " << lockStatistics.timeouts
+            << ", \"total_wait_ns\": " << lockStatistics.totalWait.count()
+            << ", \"max_wait_ns\": " << lockStatistics.maximumWait.count() << " } }";
+    }
+    output << " ], \"sensors\": [";
+    for (std::size_t i = 0; i < sensors.size(); ++i) {
+        output << (i > 0 ? ", " : " ") << "{ \"address\": \"0x" << std::hex << std::setw(2) << std::setfill('0')
+            << static_cast<int>(sensors[i]->_chipAddress) << std::dec << std::setfill(' ') << "\", \"statistics\": ";
+        sensors[i]->_statistics.writeJson(output);
+        output << " }";
+    }
+    output << " ] }";
+}
+
+
+SensirionSensor::Status SensirionSensor::writeCommand(uint16_t command, const uint8_t *data, int size)
+{
+    _currentCommand = &_statistics.getCommand(command);
+    const auto startTime = std::chrono::steady_clock::now();
+    const auto status = _bus->writeData(_chipAddress, data, size);
+    _currentCommand->write.record(std::chrono::steady_clock::now() - startTime);
+    return status;
+}
+
+
+SensirionSensor::Status SensirionSensor::readResult(uint8_t *data, int size)
+{
+    const auto startTime = std::chrono::steady_clock::now();
+    const auto status = _bus->readData(_chipAddress, data, size);
+    if (_currentCommand != nullptr) {
+        _currentCommand->read.record(std::chrono::steady_clock::now() - startTime);
+    }
+    return status;
 }
 
 
 StatusResult<uint16_t> SensirionSensor::readAndCheck(const uint8_t *data, int valueIndex)
 {
-    const auto expectedCrc = getCrc8(data, 2);
-    const auto actualCrc = data[2];
-    if (expectedCrc != actualCrc) {
-        std::cerr << "CRC value " << valueIndex << " does not match." << std::endl;
-        return StatusResult<uint16_t>::error();
+    const auto result = decodeValue(data, valueIndex);
+    if (hasError(result)) {
+        _statistics.crcFailures += 1;
     }
-    const uint16_t value = (static_cast<uint16_t>(data[0]) << 8) | static_cast<uint16_t>(data[1]);
-    return StatusResult<uint16_t>::success(value);
+    return result;
 }
 
 
 SensirionSensor::OneValueResult SensirionSensor::readOneValueResult()
 {
     uint8_t data[3];
-    if (hasError(_bus->readData(data, 3))) {
-        return OneValueResult::error();
+    if (const auto status = readResult(data, 3); hasError(status)) {
+        return OneValueResult::error(status, getErrorDetail(status));
     }
     const auto result = readAndCheck(data, 1);
     if (hasError(result)) {
-        return OneValueResult::error();
+        return OneValueResult::error(result);
     }
     return OneValueResult::success(result.getValue());
 }
@@ -141,14 +245,14 @@ SensirionSensor::TwoValuesResult SensirionSensor::readTwoValuesResult()
 {
     const int numberOfValues = 2;
     uint8_t data[numberOfValues * 3];
-    if (hasError(_bus->readData(data, numberOfValues * 3))) {
-        return TwoValuesResult::error();
+    if (const auto status = readResult(data, numberOfValues * 3); hasError(status)) {
+        return TwoValuesResult::error(status, getErrorDetail(status));
     }
     uint16_t values[numberOfValues];
     for (int i = 0; i < numberOfValues; ++i) {
         const auto result = readAndCheck(data + (i * 3), i + 1);
         if (hasError(result)) {
-            return TwoValuesResult::error();
+            return TwoValuesResult::error(result);
         }
         values[i] = result.getValue();
     }
@@ -160,14 +264,14 @@ SensirionSensor::ThreeValuesResult SensirionSensor::readThreeValuesResult()
 {
     const int numberOfValues = 3;
     uint8_t data[numberOfValues * 3];
-    if (hasError(_bus->readData(data, numberOfValues * 3))) {
-        return ThreeValuesResult::error();
+    if (const auto status = readResult(data, numberOfValues * 3); hasError(status)) {
+        return ThreeValuesResult::error(status, getErrorDetail(status));
     }
     uint16_t values[numberOfValues];
     for (int i = 0; i < numberOfValues; ++i) {
         const auto result = readAndCheck(data + (i * 3), i + 1);
         if (hasError(result)) {
-            return ThreeValuesResult::error();
+            return ThreeValuesResult::error(result);
         }
         values[i] = result.getValue();
     }
@@ -189,6 +293,24 @@ uint8_t SensirionSensor::getCrc8(const uint8_t *data, int size)
 }
 
 
+void SensirionSensor::encodeValue(uint16_t value, uint8_t *data) noexcept
+{
+    data[0] = static_cast<uint8_t>(value >> 8);
+    data[1] = static_cast<uint8_t>(value & 0x00ffu);
+    data[2] = getCrc8(data, 2);
+}
+
+
+StatusResult<uint16_t> SensirionSensor::decodeValue(const uint8_t *data, int valueIndex) noexcept
+{
+    if (getCrc8(data, 2) != data[2]) {
+        return StatusResult<uint16_t>::error(Status::CrcMismatch, static_cast<uint8_t>(valueIndex));
+    }
+    const uint16_t value = (static_cast<uint16_t>(data[0]) << 8) | static_cast<uint16_t>(data[1]);
+    return StatusResult<uint16_t>::success(value);
+}
+
+
 }
 
 
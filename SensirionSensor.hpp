@@ -18,16 +18,24 @@
 //
 
 
+#include "BusDebugPolicy.hpp"
+#include "BusLock.hpp"
+#include "BusStatistics.hpp"
 #include "StatusTools.hpp"
+#include "TimeSource.hpp"
 
+#include <chrono>
+#include <ostream>
 #include <tuple>
+#include <vector>
 #include <cstdint>
 
 
 namespace lr {
 
 
-class I2CBus;
+template<typename DebugPolicy> class BasicI2CBus;
+using I2CBus = BasicI2CBus<BusDebugPolicy>;
 
 
 /// A class with shared functions for Sensirion sensors.
@@ -44,6 +52,15 @@ public:
     ///
     SensirionSensor(uint8_t chipAddress, int i2cBus = 1, bool debuggingEnabled = false);
 
+    /// Create a sensor which shares the bus of another sensor.
+    ///
+    /// The bus is not owned by this sensor, and has to stay valid while the sensor is used.
+    ///
+    /// @param bus The bus to use.
+    /// @param chipAddress The address of this sensor.
+    ///
+    SensirionSensor(I2CBus *bus, uint8_t chipAddress);
+
     /// dtor
     ///
     virtual ~SensirionSensor();
@@ -65,6 +82,72 @@ public:
     ///
     Status closeBus();
 
+    /// Access the cross-process lock of the bus.
+    ///
+    /// Use this to configure the lock policy and timeout, and to read the statistics.
+    /// The lock is only accessible while the bus is not closed.
+    ///
+    BusLock &getBusLock();
+
+    /// Access the bus of this sensor.
+    ///
+    /// Use this to share the bus with another sensor, or to run a transaction over
+    /// commands to several sensors on the same bus.
+    ///
+    I2CBus *getBus() const;
+
+    /// Access the statistics of this sensor.
+    ///
+    /// The statistics contain latency histograms for each used command, separated into
+    /// the write, wait and read phase of the command.
+    ///
+    const SensorStatistics &getStatistics() const;
+
+    /// Set the source of time for the waits of the commands.
+    ///
+    /// @param timeSource The time source, or `nullptr` for the real time.
+    ///
+    void setTimeSource(TimeSource *timeSource);
+
+    /// Get the detail for the status of a failed call.
+    ///
+    /// @param status The status of the failed call.
+    /// @return The detail of the last bus error for a bus related status, zero otherwise.
+    ///
+    uint8_t getErrorDetail(Status status) const;
+
+    /// Write the statistics of sensors and their buses as JSON object.
+    ///
+    /// The statistics of a bus shared by several sensors are written once.
+    ///
+    /// @param output The output stream.
+    /// @param sensors The sensors.
+    ///
+    static void writeStatisticsJson(std::ostream &output, const std::vector<const SensirionSensor*> &sensors);
+
+    /// Calculate CRC-8 as specified in the datasheet.
+    ///
+    /// @param data A pointer to the data to use.
+    /// @param size The number of bytes to use.
+    /// @return The CRC for the given data.
+    ///
+    static uint8_t getCrc8(const uint8_t *data, int size);
+
+    /// Encode a value as it is sent to the sensor.
+    ///
+    /// @param value The value.
+    /// @param data The buffer for the two bytes of the value, followed by the CRC.
+    ///
+    static void encodeValue(uint16_t value, uint8_t *data) noexcept;
+
+    /// Decode and verify a value as it is received from the sensor.
+    ///
+    /// @param data The two bytes of the value, followed by the CRC.
+    /// @param valueIndex The index of the value, reported as detail of a `CrcMismatch`.
+    /// @return The value or `CrcMismatch`.
+    ///
+    static StatusResult<uint16_t> decodeValue(const uint8_t *data, int valueIndex) noexcept;
+
 protected:
     /// A result with one value.
     ///
@@ -85,6 +168,13 @@ protected:
     ///
     Status sendRawCommand(uint16_t command);
 
+    /// Send a command with a single byte.
+    ///
+    /// @param command The command code to send.
+    /// @return The call status.
+    ///
+    Status sendRawByteCommand(uint8_t command);
+
     /// Send a command.
     ///
     /// @param command The command code to send.
@@ -102,6 +192,15 @@ protected:
     ///
     Status sendRawCommand(uint16_t command, uint16_t value1, uint16_t value2);
 
+    /// Wait for the result of the last command.
+    ///
+    /// If the bus uses a backend in real time, the backend provides the timing and this call
+    /// does not wait. A simulated time advances by the duration.
+    ///
+    /// @param duration The time the sensor needs to process the command.
+    ///
+    void waitForResult(std::chrono::milliseconds duration);
+
     /// Read a one value result and check the CRC.
     ///
     /// @return The verified read value.
@@ -120,25 +219,41 @@ protected:
     ///
     ThreeValuesResult readThreeValuesResult();
 
-    /// Calculate CRC-8 as specified in the datasheet.
+private:
+    /// Write a command to the sensor and record its latency.
     ///
-    /// @param data A pointer to the data to use.
-    /// @param size The number of bytes to use.
-    /// @return The CRC for the given data.
+    /// @param command The command code, for the statistics.
+    /// @param data The data to write.
+    /// @param size The number of bytes to write.
+    /// @return The call status.
     ///
-    static uint8_t getCrc8(const uint8_t *data, int size);
+    Status writeCommand(uint16_t command, const uint8_t *data, int size);
+
+    /// Read the result of the last command and record its latency.
+    ///
+    /// @param data The buffer for the result.
+    /// @param size The number of bytes to read.
+    /// @return The call status.
+    ///
+    Status readResult(uint8_t *data, int size);
 
-private:
     /// Read and check a value from the given array.
     ///
     /// @param data A pointer to the data array to use.
-    /// @param valueIndex The value index used for error messages.
+    /// @param valueIndex The index of the value, reported as detail of a `CrcMismatch`.
     /// @return The verified read value.
     ///
-    static StatusResult<uint16_t> readAndCheck(const uint8_t *data, int valueIndex);
+    StatusResult<uint16_t> readAndCheck(const uint8_t *data, int valueIndex);
 
 protected:
     I2CBus *_bus; ///< The I2C bus used to access the sensor.
+    uint8_t _chipAddress; ///< The address of the sensor.
+    bool _ownsBus; ///< If the bus is owned by this sensor.
+
+private:
+    SensorStatistics _statistics; ///< The statistics of this sensor.
+    CommandStatistics *_currentCommand; ///< The statistics of the last sent command.
+    TimeSource *_timeSource; ///< The source of time for the waits.
 };
 
 
@@ -0,0 +1,322 @@
+//
+// (c)2020 by Lucky Resistor. See LICENSE for details.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+#include "SimulatedBus.hpp"
+
+
+#include "SensirionSensor.hpp"
+
+#include <cerrno>
+#include <cstring>
+
+
+namespace lr {
+
+
+namespace {
+
+constexpr uint8_t cGeneralCallAddress = 0x00; ///< The general call address, used for the soft reset.
+constexpr uint8_t cGeneralCallReset = 0x06; ///< The reset command for the general call address.
+constexpr uint64_t cDefaultSerialNumber = 0x0000012345ab; ///< The default serial number of the simulated sensor.
+
+}
+
+
+SimulatedBus::SimulatedBus(uint32_t seed)
+:
+    _random(seed),
+    _nackProbability(0.0),
+    _crcProbability(0.0),
+    _isBusStuck(false),
+    _isSensorHanging(false),
+    _isInitialized(false),
+    _co2(400),
+    _tvoc(0),
+    _co2Baseline(0),
+    _tvocBaseline(0),
+    _absoluteHumidity(0),
+    _model(nullptr),
+    _serialNumber(cDefaultSerialNumber),
+    _response(),
+    _statistics()
+{
+}
+
+
+void SimulatedBus::setMeasurements(uint16_t co2, uint16_t tvoc)
+{
+    _co2 = co2;
+    _tvoc = tvoc;
+}
+
+
+void SimulatedBus::setSerialNumber(uint64_t serialNumber)
+{
+    _serialNumber = serialNumber;
+}
+
+
+void SimulatedBus::setModel(SGP30Model *model)
+{
+    _model = model;
+}
+
+
+void SimulatedBus::setFaultRates(double nackProbability, double crcProbability)
+{
+    _nackProbability = nackProbability;
+    _crcProbability = crcProbability;
+}
+
+
+void SimulatedBus::injectBusStuck()
+{
+    _isBusStuck = true;
+}
+
+
+void SimulatedBus::injectSensorHang()
+{
+    _isSensorHanging = true;
+}
+
+
+const SimulatedBus::Statistics &SimulatedBus::getStatistics() const
+{
+    return _statistics;
+}
+
+
+void SimulatedBus::open()
+{
+    _statistics.opens += 1;
+    _isBusStuck = false;
+}
+
+
+int SimulatedBus::write(uint8_t address, const uint8_t *data, int size)
+{
+    _statistics.transfers += 1;
+    if (_isBusStuck) {
+        _statistics.injectedFaults += 1;
+        return EIO;
+    }
+    if (address == cGeneralCallAddress) {
+        if (size == 1 && data[0] == cGeneralCallReset) {
+            _statistics.resets += 1;
+            resetSensor();
+        }
+        return 0;
+    }
+    if (address != cSGP30Address || _isSensorHanging) {
+        return EREMOTEIO;
+    }
+    if (isRandomFault(_nackProbability)) {
+        _statistics.injectedFaults += 1;
+        return EREMOTEIO;
+    }
+    if (size < 2) {
+        return EREMOTEIO;
+    }
+    return handleCommand(static_cast<uint16_t>((data[0] << 8) | data[1]), data + 2, size - 2);
+}
+
+
+int SimulatedBus::read(uint8_t address, uint8_t *data, int size)
+{
+    _statistics.transfers += 1;
+    if (_isBusStuck) {
+        _statistics.injectedFaults += 1;
+        return EIO;
+    }
+    if (address != cSGP30Address || _isSensorHanging || _response.empty()) {
+        return EREMOTEIO;
+    }
+    if (isRandomFault(_nackProbability)) {
+        _statistics.injectedFaults += 1;
+        return EREMOTEIO;
+    }
+    std::memset(data, 0, static_cast<std::size_t>(size));
+    std::memcpy(data, _response.data(), std::min(_response.size(), static_cast<std::size_t>(size)));
+    _response.clear();
+    if (size >= 3 && isRandomFault(_crcProbability)) {
+        _statistics.injectedFaults += 1;
+        data[0] ^= 0x01u;
+    }
+    return 0;
+}
+
+
+int SimulatedBus::handleCommand(uint16_t command, const uint8_t *data, int size)
+{
+    // Each parameter word is followed by its CRC.
+    const auto getWord = [data, size](int index) -> int {
+        if (size < (index + 1) * 3 || SensirionSensor::getCrc8(data + index * 3, 2) != data[index * 3 + 2]) {
+            return -1;
+        }
+        return (data[index * 3] << 8) | data[index * 3 + 1];
+    };
+    _response.clear();
+    if (_model != nullptr) {
+        switch (command) {
+        case 0x2003: // iaq_init
+            _model->initialize();
+            return 0;
+        case 0x2008: { // measure_iaq
+            if (!_model->isInitialized()) {
+                return EREMOTEIO;
+            }
+            const auto [co2, tvoc] = _model->measure();
+            setResponse({co2, tvoc});
+            return 0;
+        }
+        case 0x2015: { // get_iaq_baseline
+            const auto [co2Baseline, tvocBaseline] = _model->getBaseline();
+            setResponse({co2Baseline, tvocBaseline});
+            return 0;
+        }
+        case 0x201e: { // set_iaq_baseline
+            const auto co2Baseline = getWord(0);
+            const auto tvocBaseline = getWord(1);
+            if (co2Baseline < 0 || tvocBaseline < 0) {
+                return EREMOTEIO;
+            }
+            _model->setBaseline(static_cast<uint16_t>(co2Baseline), static_cast<uint16_t>(tvocBaseline));
+            return 0;
+        }
+        case 0x2061: { // set_absolute_humidity
+            const auto absoluteHumidity = getWord(0);
+            if (absoluteHumidity < 0) {
+                return EREMOTEIO;
+            }
+            _model->setAbsoluteHumidity(static_cast<uint16_t>(absoluteHumidity));
+            return 0;
+        }
+        case 0x20b3: // get_tvoc_inceptive_baseline
+            setResponse({_model->getTvocInceptiveBaseline()});
+            return 0;
+        case 0x2077: { // set_tvoc_baseline
+            const auto tvocBaseline = getWord(0);
+            if (tvocBaseline < 0) {
+                return EREMOTEIO;
+            }
+            _model->setTvocBaseline(static_cast<uint16_t>(tvocBaseline));
+            return 0;
+        }
+        default:
+            break;
+        }
+    }
+    switch (command) {
+    case 0x2003: // iaq_init
+        _isInitialized = true;
+        return 0;
+    case 0x2008: // measure_iaq
+        if (!_isInitialized) {
+            return EREMOTEIO;
+        }
+        setResponse({_co2, _tvoc});
+        return 0;
+    case 0x2015: // get_iaq_baseline
+        setResponse({_co2Baseline, _tvocBaseline});
+        return 0;
+    case 0x201e: { // set_iaq_baseline
+        const auto co2Baseline = getWord(0);
+        const auto tvocBaseline = getWord(1);
+        if (co2Baseline < 0 || tvocBaseline < 0) {
+            return EREMOTEIO;
+        }
+        _co2Baseline = static_cast<uint16_t>(co2Baseline);
+        _tvocBaseline = static_cast<uint16_t>(tvocBaseline);
+        return 0;
+    }
+    case 0x2061: { // set_absolute_humidity
+        const auto absoluteHumidity = getWord(0);
+        if (absoluteHumidity < 0) {
+            return EREMOTEIO;
+        }
+        _absoluteHumidity = static_cast<uint16_t>(absoluteHumidity);
+        return 0;
+    }
+    case 0x2032: // measure_test
+        setResponse({0xd400});
+        return 0;
+    case 0x202f: // get_feature_set
+        setResponse({0x0022});
+        return 0;
+    case 0x2050: // measure_raw
+        setResponse({13600, 18500});
+        return 0;
+    case 0x20b3: // get_tvoc_inceptive_baseline
+        setResponse({0x8f00});
+        return 0;
+    case 0x2077: { // set_tvoc_baseline
+        const auto tvocBaseline = getWord(0);
+        if (tvocBaseline < 0) {
+            return EREMOTEIO;
+        }
+        _tvocBaseline = static_cast<uint16_t>(tvocBaseline);
+        return 0;
+    }
+    case 0x3682: // get_serial_id
+        setResponse({
+            static_cast<uint16_t>(_serialNumber >> 32),
+            static_cast<uint16_t>(_serialNumber >> 16),
+            static_cast<uint16_t>(_serialNumber)});
+        return 0;
+    default:
+        return EREMOTEIO;
+    }
+}
+
+
+void SimulatedBus::setResponse(std::initializer_list<uint16_t> words)
+{
+    for (const auto word : words) {
+        const uint8_t bytes[2] = {static_cast<uint8_t>(word >> 8), static_cast<uint8_t>(word)};
+        _response.push_back(bytes[0]);
+        _response.push_back(bytes[1]);
+        _response.push_back(SensirionSensor::getCrc8(bytes, 2));
+    }
+}
+
+
+bool SimulatedBus::isRandomFault(double probability)
+{
+    if (probability <= 0.0) {
+        return false;
+    }
+    return std::uniform_real_distribution<double>(0.0, 1.0)(_random) < probability;
+}
+
+
+void SimulatedBus::resetSensor()
+{
+    _isSensorHanging = false;
+    _isInitialized = false;
+    _co2Baseline = 0;
+    _tvocBaseline = 0;
+    _absoluteHumidity = 0;
+    _response.clear();
+    if (_model != nullptr) {
+        _model->reset();
+    }
+}
+
+
+}
+
@@ -0,0 +1,149 @@
+#pragma once
+//
+// (c)2020 by Lucky Resistor. See LICENSE for details.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+
+
+#include "BusBackend.hpp"
+#include "SGP30Model.hpp"
+
+#include <cstdint>
+#include <random>
+#include <vector>
+
+
+namespace lr {
+
+
+/// A simulated bus with a SGP30 sensor and fault injection.
+///
+/// The simulated sensor answers all commands of the SGP30 driver instantly, and returns
+/// fixed measurement values. With a behavioural model, the measurement, baseline and
+/// humidity commands are handled by the model instead. Faults can be injected to test the
+/// error handling:
+///
+/// - Random faults: a transfer is not acknowledged, or a received word is corrupted.
+/// - A stuck bus: all transfers fail until the bus is opened again.
+/// - A hanging sensor: the sensor does not acknowledge any transfer until a soft reset.
+///
+class SimulatedBus : public BusBackend
+{
+public:
+    /// The address of the simulated SGP30.
+    ///
+    static constexpr uint8_t cSGP30Address = 0x58;
+
+    /// Counters for the simulated transfers.
+    ///
+    struct Statistics {
+        uint64_t transfers; ///< The number of transfers.
+        uint64_t injectedFaults; ///< The number of failed or corrupted transfers.
+        uint64_t opens; ///< The number of times the bus was opened.
+        uint64_t resets; ///< The number of soft resets of the sensor.
+    };
+
+public:
+    /// Create a new simulated bus.
+    ///
+    /// @param seed The seed for the random faults.
+    ///
+    explicit SimulatedBus(uint32_t seed = 1);
+
+public:
+    /// Set the measurement values returned by the sensor.
+    ///
+    /// @param co2 The CO2eq value in ppm.
+    /// @param tvoc The TVOC value in ppb.
+    ///
+    void setMeasurements(uint16_t co2, uint16_t tvoc);
+
+    /// Set the serial number of the sensor.
+    ///
+    /// @param serialNumber The 48-bit serial number.
+    ///
+    void setSerialNumber(uint64_t serialNumber);
+
+    /// Set a behavioural model for the sensor.
+    ///
+    /// @param model The model, or `nullptr` to return fixed values. The model must outlive the bus.
+    ///
+    void setModel(SGP30Model *model);
+
+    /// Set the rate of random faults.
+    ///
+    /// @param nackProbability The probability of a transfer which is not acknowledged.
+    /// @param crcProbability The probability of a read with a corrupted word.
+    ///
+    void setFaultRates(double nackProbability, double crcProbability);
+
+    /// Let all transfers fail, until the bus is opened again.
+    ///
+    void injectBusStuck();
+
+    /// Let the sensor ignore all transfers, until a soft reset.
+    ///
+    void injectSensorHang();
+
+    /// Access the statistics.
+    ///
+    const Statistics &getStatistics() const;
+
+public: // BusBackend
+    void open() override;
+    int write(uint8_t address, const uint8_t *data, int size) override;
+    int read(uint8_t address, uint8_t *data, int size) override;
+
+private:
+    /// Handle a command for the simulated SGP30.
+    ///
+    /// @return The error number, zero on success.
+    ///
+    int handleCommand(uint16_t command, const uint8_t *data, int size);
+
+    /// Prepare the response of a command.
+    ///
+    void setResponse(std::initializer_list<uint16_t> words);
+
+    /// Check if a random fault shall be injected.
+    ///
+    bool isRandomFault(double probability);
+
+    /// Reset the state of the simulated sensor.
+    ///
+    void resetSensor();
+
+private:
+    std::mt19937 _random; ///< The random generator for the faults.
+    double _nackProbability; ///< The probability of a not acknowledged transfer.
+    double _crcProbability; ///< The probability of a corrupted word.
+    bool _isBusStuck; ///< If the bus is stuck.
+    bool _isSensorHanging; ///< If the sensor is hanging.
+    bool _isInitialized; ///< If the measurements were initialized.
+    uint16_t _co2; ///< The CO2eq measurement value.
+    uint16_t _tvoc; ///< The TVOC measurement value.
+    uint16_t _co2Baseline; ///< The CO2eq baseline.
+    uint16_t _tvocBaseline; ///< The TVOC baseline.
+    uint16_t _absoluteHumidity; ///< The absolute humidity for the compensation.
+    SGP30Model *_model; ///< The optional behavioural model.
+    uint64_t _serialNumber; ///< The serial number of the sensor.
+    std::vector<uint8_t> _response; ///< The prepared response for the next read.
+    Statistics _statistics; ///< The statistics.
+};
+
+
+}
+
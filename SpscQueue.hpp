@@ -0,0 +1,196 @@
+#pragma once
+//
+// (c)2020 by Lucky Resistor. See LICENSE for details.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+
+namespace lr {
+
+
+/// The size of a cache line, to keep the data of different threads apart.
+///
+constexpr std::size_t cCacheLineSize = 64;
+
+
+/// A lock-free queue of fixed-size entries from one producer thread to one consumer thread.
+///
+/// The read and the write position are on separate cache lines, and each thread keeps a copy
+/// of the position of the other thread, so it only has to load it when the queue looks full
+/// or empty. Each entry is padded to whole cache lines.
+///
+/// The entries are copied in and out as words of relaxed atomics. This allows the producer
+/// to drop the oldest entry while the consumer reads it: the consumer only accepts an entry,
+/// if it can advance the read position from the position the entry was read at.
+///
+/// @tparam T The type of the entries. It must be trivially copyable.
+/// @tparam tCapacity The maximum number of entries in the queue, a power of two.
+///
+template<typename T, std::size_t tCapacity>
+class SpscQueue
+{
+    static_assert(std::is_trivially_copyable_v<T>, "The entries must be trivially copyable.");
+    static_assert(tCapacity >= 2 && (tCapacity & (tCapacity - 1)) == 0, "The capacity must be a power of two.");
+
+public:
+    /// Create an empty queue.
+    ///
+    SpscQueue() noexcept
+    :
+        _writePosition(0),
+        _cachedReadPosition(0),
+        _readPosition(0),
+        _cachedWritePosition(0),
+        _slots()
+    {
+    }
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue &operator=(const SpscQueue&) = delete;
+
+public:
+    /// The maximum number of entries in the queue.
+    ///
+    static constexpr std::size_t getCapacity() noexcept {
+        return tCapacity;
+    }
+
+    /// Add an entry, if the queue is not full. Producer only.
+    ///
+    /// @param entry The entry to add.
+    /// @return `true` if the entry was added, `false` if the queue is full.
+    ///
+    bool tryPush(const T &entry) noexcept {
+        const auto position = _writePosition.load(std::memory_order_relaxed);
+        if (position - _cachedReadPosition >= tCapacity) {
+            _cachedReadPosition = _readPosition.load(std::memory_order_acquire);
+            if (position - _cachedReadPosition >= tCapacity) {
+                return false;
+            }
+        }
+        storeEntry(position, entry);
+        _writePosition.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    /// Add an entry, and drop the oldest entry if the queue is full. Producer only.
+    ///
+    /// @param entry The entry to add.
+    /// @return `true` if the oldest entry was dropped.
+    ///
+    bool pushDroppingOldest(const T &entry) noexcept {
+        const auto position = _writePosition.load(std::memory_order_relaxed);
+        bool hasDropped = false;
+        if (position - _cachedReadPosition >= tCapacity) {
+            _cachedReadPosition = _readPosition.load(std::memory_order_acquire);
+            while (position - _cachedReadPosition >= tCapacity) {
+                // On failure, the consumer has advanced, and the cached position is updated.
+                if (_readPosition.compare_exchange_weak(_cachedReadPosition, _cachedReadPosition + 1,
+                        std::memory_order_acq_rel, std::memory_order_acquire)) {
+                    _cachedReadPosition += 1;
+                    hasDropped = true;
+                }
+            }
+        }
+        storeEntry(position, entry);
+        _writePosition.store(position + 1, std::memory_order_release);
+        return hasDropped;
+    }
+
+    /// Remove the oldest entry. Consumer only.
+    ///
+    /// @param entry The variable to receive the entry.
+    /// @return `true` if an entry was removed, `false` if the queue is empty.
+    ///
+    bool tryPop(T &entry) noexcept {
+        auto position = _readPosition.load(std::memory_order_acquire);
+        while (true) {
+            if (position >= _cachedWritePosition) {
+                _cachedWritePosition = _writePosition.load(std::memory_order_acquire);
+                if (position >= _cachedWritePosition) {
+                    return false;
+                }
+            }
+            loadEntry(position, entry);
+            // On failure, the producer dropped the entry while it was read, and the position is updated.
+            if (_readPosition.compare_exchange_strong(position, position + 1,
+                    std::memory_order_acq_rel, std::memory_order_acquire)) {
+                return true;
+            }
+        }
+    }
+
+    /// The number of entries in the queue.
+    ///
+    /// The value is only exact, if neither the producer nor the consumer changes the queue.
+    ///
+    std::size_t getSize() const noexcept {
+        const auto readPosition = _readPosition.load(std::memory_order_acquire);
+        const auto writePosition = _writePosition.load(std::memory_order_acquire);
+        return static_cast<std::size_t>(writePosition - readPosition);
+    }
+
+private:
+    /// The number of words to store one entry.
+    ///
+    static constexpr std::size_t cWordCount = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+    /// One entry, padded to whole cache lines.
+    ///
+    struct alignas(cCacheLineSize) Slot {
+        std::array<std::atomic<uint64_t>, cWordCount> words; ///< The words of the entry.
+    };
+
+    /// Copy an entry into its slot.
+    ///
+    void storeEntry(uint64_t position, const T &entry) noexcept {
+        std::array<uint64_t, cWordCount> words{};
+        std::memcpy(words.data(), &entry, sizeof(T));
+        auto &slot = _slots[static_cast<std::size_t>(position) & (tCapacity - 1)];
+        for (std::size_t i = 0; i < cWordCount; ++i) {
+            slot.words[i].store(words[i], std::memory_order_relaxed);
+        }
+    }
+
+    /// Copy an entry out of its slot.
+    ///
+    void loadEntry(uint64_t position, T &entry) const noexcept {
+        std::array<uint64_t, cWordCount> words;
+        const auto &slot = _slots[static_cast<std::size_t>(position) & (tCapacity - 1)];
+        for (std::size_t i = 0; i < cWordCount; ++i) {
+            words[i] = slot.words[i].load(std::memory_order_relaxed);
+        }
+        std::memcpy(&entry, words.data(), sizeof(T));
+    }
+
+private:
+    alignas(cCacheLineSize) std::atomic<uint64_t> _writePosition; ///< The number of added entries.
+    uint64_t _cachedReadPosition; ///< The last read position seen by the producer.
+    alignas(cCacheLineSize) std::atomic<uint64_t> _readPosition; ///< The number of removed or dropped entries.
+    uint64_t _cachedWritePosition; ///< The last write position seen by the consumer.
+    std::array<Slot, tCapacity> _slots; ///< The entries.
+};
+
+
+}
+
@@ -0,0 +1,365 @@
+//
+// (c)2020 by Lucky Resistor. See LICENSE for details.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+#include "StateJournal.hpp"
+
+
+#include "FileLock.hpp"
+
+#include <sys/stat.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <array>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+
+
+namespace lr {
+
+
+namespace {
+
+constexpr uint32_t cRecordMagic = 0x4c524a31; ///< The magic value of a record ("LRJ1").
+constexpr uint16_t cRecordTypeIAQBaseline = 1; ///< The record type for iAQ baseline values.
+constexpr std::size_t cCompactRecordCount = 4096; ///< The number of records which trigger a compaction.
+constexpr int cMaximumReopenCount = 8; ///< The maximum number of reopens if the file is replaced while locking.
+
+/// Create the lookup table for the CRC-32 (IEEE 802.3) calculation.
+///
+constexpr std::array<uint32_t, 256> createCrc32Table()
+{
+    std::array<uint32_t, 256> table{};
+    for (uint32_t i = 0; i < 256; ++i) {
+        uint32_t value = i;
+        for (int bit = 0; bit < 8; ++bit) {
+            value = (value & 1u) ? (value >> 1) ^ 0xedb88320u : (value >> 1);
+        }
+        table[i] = value;
+    }
+    return table;
+}
+
+constexpr auto cCrc32Table = createCrc32Table();
+
+/// Write the whole buffer to a file.
+///
+bool writeAll(int fd, const void *data, std::size_t size)
+{
+    auto bytes = static_cast<const uint8_t*>(data);
+    while (size > 0) {
+        const auto written = write(fd, bytes, size);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        bytes += written;
+        size -= static_cast<std::size_t>(written);
+    }
+    return true;
+}
+
+/// Releases the lock on the journal file at the end of a scope.
+///
+/// The file descriptor is referenced, so the lock of a reopened file is released.
+///
+class FileUnlockGuard
+{
+public:
+    explicit FileUnlockGuard(const int &fd) : _fd(fd) {}
+    ~FileUnlockGuard() { if (_fd >= 0) { applyFileLock(_fd, LOCK_UN); } }
+    FileUnlockGuard(const FileUnlockGuard&) = delete;
+    FileUnlockGuard &operator=(const FileUnlockGuard&) = delete;
+
+private:
+    const int &_fd; ///< The file descriptor of the journal.
+};
+
+}
+
+
+StateJournal::StateJournal()
+    : _path(), _fd(-1), _syncInterval(1), _unsyncedRecords(0), _entries()
+{
+}
+
+
+StateJournal::~StateJournal()
+{
+    close();
+}
+
+
+StateJournal::Status StateJournal::open(const std::filesystem::path &path)
+{
+    close();
+    _path = path;
+    if (hasError(openFile())) {
+        return Status::Error;
+    }
+    FileUnlockGuard unlockGuard(_fd);
+    if (hasError(lockFile()) || hasError(load())) {
+        close();
+        return Status::Error;
+    }
+    if (_entries.size() >= cCompactRecordCount) {
+        return compact();
+    }
+    return Status::Success;
+}
+
+
+void StateJournal::close()
+{
+    if (_fd >= 0) {
+        sync();
+        ::close(_fd);
+        _fd = -1;
+    }
+    _entries.clear();
+}
+
+
+void StateJournal::setSyncInterval(uint32_t recordCount)
+{
+    _syncInterval = (recordCount > 0) ? recordCount : 1;
+}
+
+
+StateJournal::Status StateJournal::append(const Entry &entry)
+{
+    if (_fd < 0) {
+        std::cerr << "Call to append() for a closed state journal." << std::endl;
+        return Status::Error;
+    }
+    FileUnlockGuard unlockGuard(_fd);
+    if (hasError(lockFile())) {
+        return Status::Error;
+    }
+    const auto record = toRecord(entry);
+    if (!writeAll(_fd, &record, sizeof(record))) {
+        std::cerr << "Failed to write to the state journal. Error: " << strerror(errno) << std::endl;
+        return Status::Error;
+    }
+    _entries.push_back(entry);
+    _unsyncedRecords += 1;
+    if (_unsyncedRecords >= _syncInterval) {
+        return sync();
+    }
+    return Status::Success;
+}
+
+
+StateJournal::Status StateJournal::sync()
+{
+    if (_fd < 0 || _unsyncedRecords == 0) {
+        return Status::Success;
+    }
+    if (fdatasync(_fd) < 0) {
+        std::cerr << "Failed to sync the state journal. Error: " << strerror(errno) << std::endl;
+        return Status::Error;
+    }
+    _unsyncedRecords = 0;
+    return Status::Success;
+}
+
+
+StateJournal::EntryResult StateJournal::findLatest(uint64_t serialNumber) const
+{
+    for (auto it = _entries.crbegin(); it != _entries.crend(); ++it) {
+        if (it->serialNumber == serialNumber) {
+            return EntryResult::success(*it);
+        }
+    }
+    return EntryResult::error();
+}
+
+
+const StateJournal::EntryList &StateJournal::getEntries() const
+{
+    return _entries;
+}
+
+
+StateJournal::Status StateJournal::openFile()
+{
+    _fd = ::open(_path.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (_fd < 0) {
+        std::cerr << "Failed to open the state journal: " << _path.string() << std::endl;
+        return Status::Error;
+    }
+    return Status::Success;
+}
+
+
+StateJournal::Status StateJournal::lockFile()
+{
+    bool wasReopened = false;
+    for (int attempt = 0; attempt < cMaximumReopenCount; ++attempt) {
+        if (!applyFileLock(_fd, LOCK_EX)) {
+            std::cerr << "Failed to lock the state journal. Error: " << strerror(errno) << std::endl;
+            return Status::Error;
+        }
+        struct stat fileStatus{};
+        struct stat pathStatus{};
+        if (fstat(_fd, &fileStatus) < 0) {
+            std::cerr << "Failed to read the status of the state journal." << std::endl;
+            return Status::Error;
+        }
+        if (stat(_path.c_str(), &pathStatus) == 0 && fileStatus.st_dev == pathStatus.st_dev
+            && fileStatus.st_ino == pathStatus.st_ino) {
+            // Entries appended by other processes are picked up, if the file was replaced.
+            return wasReopened ? load() : Status::Success;
+        }
+        // Another process replaced the journal while compacting it, closing also releases the lock.
+        if (_unsyncedRecords > 0) {
+            fdatasync(_fd);
+            _unsyncedRecords = 0;
+        }
+        ::close(_fd);
+        _fd = -1;
+        if (hasError(openFile())) {
+            return Status::Error;
+        }
+        wasReopened = true;
+    }
+    std::cerr << "The state journal was replaced too often while locking it." << std::endl;
+    return Status::Error;
+}
+
+
+StateJournal::Status StateJournal::load()
+{
+    _entries.clear();
+    struct stat fileStatus{};
+    if (fstat(_fd, &fileStatus) < 0) {
+        std::cerr << "Failed to read the size of the state journal." << std::endl;
+        return Status::Error;
+    }
+    const auto recordCount = static_cast<std::size_t>(fileStatus.st_size) / sizeof(Record);
+    std::vector<Record> records(recordCount);
+    const auto byteCount = recordCount * sizeof(Record);
+    if (byteCount > 0 && pread(_fd, records.data(), byteCount, 0) != static_cast<ssize_t>(byteCount)) {
+        std::cerr << "Failed to read the state journal." << std::endl;
+        return Status::Error;
+    }
+    _entries.reserve(recordCount);
+    std::size_t validSize = 0;
+    for (std::size_t i = 0; i < recordCount; ++i) {
+        const auto &record = records[i];
+        if (record.magic != cRecordMagic || record.crc != getRecordCrc(record)) {
+            continue; // skip damaged records.
+        }
+        if (record.type == cRecordTypeIAQBaseline) {
+            _entries.push_back(Entry{record.serialNumber, record.timestamp, record.co2Baseline, record.tvocBaseline});
+        }
+        validSize = (i + 1) * sizeof(Record);
+    }
+    // Remove a torn write from the end of the file, so new records stay aligned.
+    if (static_cast<std::size_t>(fileStatus.st_size) != validSize) {
+        if (ftruncate(_fd, static_cast<off_t>(validSize)) < 0) {
+            std::cerr << "Failed to remove damaged records from the state journal." << std::endl;
+            return Status::Error;
+        }
+    }
+    return Status::Success;
+}
+
+
+StateJournal::Status StateJournal::compact()
+{
+    std::unordered_map<uint64_t, Entry> latestEntries;
+    for (const auto &entry : _entries) {
+        latestEntries[entry.serialNumber] = entry;
+    }
+    // A unique name, so a crashed or concurrent compaction never shares the temporary file.
+    auto tmpName = _path.string() + ".XXXXXX";
+    const int tmpFd = mkostemp(tmpName.data(), O_CLOEXEC);
+    if (tmpFd < 0) {
+        std::cerr << "Failed to create the temporary state journal: " << tmpName << std::endl;
+        return Status::Error;
+    }
+    const std::filesystem::path tmpPath = tmpName;
+    EntryList entries;
+    std::vector<Record> records;
+    for (const auto &[serialNumber, entry] : latestEntries) {
+        entries.push_back(entry);
+        records.push_back(toRecord(entry));
+    }
+    if (fchmod(tmpFd, 0644) < 0 || !writeAll(tmpFd, records.data(), records.size() * sizeof(Record))
+        || fdatasync(tmpFd) < 0) {
+        std::cerr << "Failed to write the temporary state journal: " << tmpPath.string() << std::endl;
+        ::close(tmpFd);
+        unlink(tmpPath.c_str());
+        return Status::Error;
+    }
+    ::close(tmpFd);
+    if (rename(tmpPath.c_str(), _path.c_str()) < 0) {
+        std::cerr << "Failed to replace the state journal: " << _path.string() << std::endl;
+        unlink(tmpPath.c_str());
+        return Status::Error;
+    }
+    // Sync the directory, to make the rename durable.
+    const int directoryFd = ::open(_path.parent_path().c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (directoryFd >= 0) {
+        fsync(directoryFd);
+        ::close(directoryFd);
+    }
+    // Closing the replaced file releases its lock, waiting processes detect the new inode.
+    ::close(_fd);
+    _fd = -1;
+    if (hasError(openFile())) {
+        return Status::Error;
+    }
+    _entries = std::move(entries);
+    _unsyncedRecords = 0;
+    return Status::Success;
+}
+
+
+StateJournal::Record StateJournal::toRecord(const Entry &entry)
+{
+    Record record{};
+    record.magic = cRecordMagic;
+    record.type = cRecordTypeIAQBaseline;
+    record.timestamp = entry.timestamp;
+    record.serialNumber = entry.serialNumber;
+    record.co2Baseline = entry.co2Baseline;
+    record.tvocBaseline = entry.tvocBaseline;
+    record.crc = getRecordCrc(record);
+    return record;
+}
+
+
+uint32_t StateJournal::getRecordCrc(const Record &record)
+{
+    auto data = reinterpret_cast<const uint8_t*>(&record);
+    uint32_t crc = 0xffffffffu;
+    for (std::size_t i = 0; i < offsetof(Record, crc); ++i) {
+        crc = cCrc32Table[(crc ^ data[i]) & 0xffu] ^ (crc >> 8);
+    }
+    return crc ^ 0xffffffffu;
+}
+
+
+}
+
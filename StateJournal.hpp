@@ -0,0 +1,185 @@
+#pragma once
+//
+// (c)2020 by Lucky Resistor. See LICENSE for details.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+
+
+#include "StatusTools.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+
+namespace lr {
+
+
+/// A crash-safe journal for the sensor state.
+///
+/// The journal is a binary file with fixed size records. Each record stores the baseline
+/// values of one sensor, together with the serial number of the sensor and a timestamp.
+/// New records are only appended to the file, and each record is protected with a CRC-32.
+/// A torn write at the end of the file is detected and removed while loading.
+///
+/// To reduce the write load, the file is only synced to the disk after a number of
+/// records, or if the journal is closed.
+///
+/// Several processes can share one journal. Loading, compacting and appending hold an
+/// exclusive `flock()` on the file. If another process replaced the file by a compaction,
+/// the journal is reopened and reloaded before the next record is appended.
+///
+class StateJournal
+{
+public:
+    using Status = CallStatus;
+
+    /// One baseline entry in the journal.
+    ///
+    struct Entry {
+        uint64_t serialNumber; ///< The serial number of the sensor.
+        int64_t timestamp; ///< The time of the entry in seconds since the epoch.
+        uint16_t co2Baseline; ///< The CO2eq baseline value.
+        uint16_t tvocBaseline; ///< The TVOC baseline value.
+    };
+
+    /// The result of a lookup.
+    ///
+    using EntryResult = StatusResult<Entry>;
+
+    /// The list of entries.
+    ///
+    using EntryList = std::vector<Entry>;
+
+public:
+    /// ctor
+    ///
+    StateJournal();
+
+    /// dtor
+    ///
+    /// Syncs and closes the journal.
+    ///
+    ~StateJournal();
+
+    StateJournal(const StateJournal&) = delete;
+    StateJournal &operator=(const StateJournal&) = delete;
+
+public:
+    /// Open the journal and load all valid entries.
+    ///
+    /// If the journal grew too large, it is compacted to the latest entry of each sensor.
+    ///
+    /// @param path The path to the journal file.
+    /// @return The call status.
+    ///
+    Status open(const std::filesystem::path &path);
+
+    /// Sync and close the journal.
+    ///
+    void close();
+
+    /// Set the number of appended records after which the file is synced.
+    ///
+    /// @param recordCount The number of records, `1` to sync after each record.
+    ///
+    void setSyncInterval(uint32_t recordCount);
+
+    /// Append a new entry to the journal.
+    ///
+    /// @param entry The entry to append.
+    /// @return The call status.
+    ///
+    Status append(const Entry &entry);
+
+    /// Sync all appended records to the disk.
+    ///
+    /// @return The call status.
+    ///
+    Status sync();
+
+    /// Find the latest entry for a sensor.
+    ///
+    /// @param serialNumber The serial number of the sensor.
+    /// @return The latest entry, or an error if there is no entry for this sensor.
+    ///
+    EntryResult findLatest(uint64_t serialNumber) const;
+
+    /// Access all valid entries, in the order they were written.
+    ///
+    const EntryList &getEntries() const;
+
+private:
+    /// The record as stored in the file.
+    ///
+    struct Record {
+        uint32_t magic; ///< The magic value of a record.
+        uint16_t type; ///< The type of the record.
+        uint16_t reserved; ///< Reserved, always zero.
+        int64_t timestamp; ///< The timestamp.
+        uint64_t serialNumber; ///< The serial number of the sensor.
+        uint16_t co2Baseline; ///< The CO2eq baseline value.
+        uint16_t tvocBaseline; ///< The TVOC baseline value.
+        uint32_t crc; ///< The CRC-32 of all previous fields.
+    };
+
+    static_assert(sizeof(Record) == 32, "Unexpected record size.");
+
+    /// Open the journal file at the current path.
+    ///
+    /// @return The call status.
+    ///
+    Status openFile();
+
+    /// Lock the journal file exclusively.
+    ///
+    /// If the file at the path was replaced, the new file is opened, locked and loaded.
+    ///
+    /// @return The call status.
+    ///
+    Status lockFile();
+
+    /// Load all records from the open file.
+    ///
+    /// @return The call status.
+    ///
+    Status load();
+
+    /// Rewrite the journal with the latest entry of each sensor.
+    ///
+    /// @return The call status.
+    ///
+    Status compact();
+
+    /// Convert an entry into a record.
+    ///
+    static Record toRecord(const Entry &entry);
+
+    /// Calculate the CRC-32 of a record.
+    ///
+    static uint32_t getRecordCrc(const Record &record);
+
+private:
+    std::filesystem::path _path; ///< The path to the journal file.
+    int _fd; ///< The file descriptor of the journal.
+    uint32_t _syncInterval; ///< The number of records after which the file is synced.
+    uint32_t _unsyncedRecords; ///< The number of records which were not synced yet.
+    EntryList _entries; ///< All valid entries in the journal.
+};
+
+
+}
+
@@ -0,0 +1,81 @@
+//
+// (c)2020 by Lucky Resistor. See LICENSE for details.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+#include "StatusMessage.hpp"
+
+
+#include <cstring>
+#include <sstream>
+
+
+namespace lr {
+
+
+const char *getStatusName(CallStatus status) noexcept
+{
+    switch (status) {
+    case CallStatus::Success: return "success";
+    case CallStatus::Nack: return "nack";
+    case CallStatus::ShortRead: return "short_read";
+    case CallStatus::CrcMismatch: return "crc_mismatch";
+    case CallStatus::Timeout: return "timeout";
+    case CallStatus::BadParameter: return "bad_parameter";
+    case CallStatus::IoError: return "io_error";
+    default: return "error";
+    }
+}
+
+
+std::string getStatusMessage(CallStatus status, uint8_t detail)
+{
+    std::stringstream message;
+    switch (status) {
+    case CallStatus::Success:
+        message << "Success.";
+        break;
+    case CallStatus::Nack:
+        message << "The device did not acknowledge the transfer (errno=" << static_cast<int>(detail) << ").";
+        break;
+    case CallStatus::ShortRead:
+        message << "The device sent only " << static_cast<int>(detail) << " bytes.";
+        break;
+    case CallStatus::CrcMismatch:
+        message << "The CRC of value " << static_cast<int>(detail) << " does not match.";
+        break;
+    case CallStatus::Timeout:
+        if (detail != 0) {
+            message << "Timeout while waiting for the device (errno=" << static_cast<int>(detail) << ").";
+        } else {
+            message << "Timeout while waiting for the I2C bus lock.";
+        }
+        break;
+    case CallStatus::BadParameter:
+        message << "A parameter is out of range.";
+        break;
+    case CallStatus::IoError:
+        message << "Error: " << strerror(detail) << " (errno=" << static_cast<int>(detail) << ").";
+        break;
+    default:
+        message << "The call failed.";
+        break;
+    }
+    return message.str();
+}
+
+
+}
+
@@ -0,0 +1,63 @@
+#pragma once
+//
+// (c)2020 by Lucky Resistor. See LICENSE for details.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+
+
+#include "StatusTools.hpp"
+
+#include <cstdint>
+#include <string>
+
+
+namespace lr {
+
+
+/// Get the name of a call status, for the JSON output.
+///
+/// @param status The call status.
+/// @return The name in snake case, like `crc_mismatch`.
+///
+const char *getStatusName(CallStatus status) noexcept;
+
+
+/// Get a readable message for a failed call.
+///
+/// The messages are only created at the edge of the application, where the error is shown
+/// to the user. The lower layers only pass the status and its detail.
+///
+/// @param status The call status.
+/// @param detail The detail of the error, see `CallStatus`.
+/// @return The message.
+///
+std::string getStatusMessage(CallStatus status, uint8_t detail = 0);
+
+
+/// Get a readable message for a failed result.
+///
+/// @param result The result.
+/// @return The message.
+///
+template<typename ValueType>
+std::string getStatusMessage(const StatusResult<ValueType> &result)
+{
+    return getStatusMessage(result.getStatus(), result.getDetail());
+}
+
+
+}
+
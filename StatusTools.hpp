@@ -27,9 +27,19 @@ namespace lr {
 
 /// A simple call status enumeration.
 ///
+/// Besides the generic `Error`, the status names the cause of a failed call, so callers
+/// can decide about a retry without parsing any messages. A `StatusResult` carries an
+/// additional detail byte, which is explained for each status.
+///
 enum class CallStatus : uint8_t {
     Success, ///< The call was successful.
-    Error ///< The call failed.
+    Error, ///< The call failed.
+    Nack, ///< The device did not acknowledge the transfer. Detail: the error number.
+    ShortRead, ///< The device sent less data than requested. Detail: the number of received bytes.
+    CrcMismatch, ///< The CRC of a received word did not match. Detail: the index of the word, starting with 1.
+    Timeout, ///< The bus or the device did not respond in time. Detail: the error number, or zero.
+    BadParameter, ///< A parameter of the call was out of range.
+    IoError ///< The transfer failed with an error from the system. Detail: the error number.
 };
 
 
@@ -85,10 +95,21 @@ public:
     /// Create a custom error status.
     ///
     /// @param status The custom error value.
+    /// @param detail The detail of the error, see the status enum.
     /// @return A new status result.
     ///
-    constexpr static StatusResult error(StatusEnum status) noexcept {
-        return StatusResult(status);
+    constexpr static StatusResult error(StatusEnum status, uint8_t detail = 0) noexcept {
+        return StatusResult(status, {}, detail);
+    }
+
+    /// Create an error status from the error of another result.
+    ///
+    /// @param other The other result with an error.
+    /// @return A new status result with the status and detail of the other result.
+    ///
+    template<typename OtherValueType>
+    constexpr static StatusResult error(const StatusResult<OtherValueType, StatusEnum> &other) noexcept {
+        return StatusResult(other.getStatus(), {}, other.getDetail());
     }
 
     /// Check if the result was successful.
@@ -119,6 +140,12 @@ public:
         return _status;
     }
 
+    /// Get the detail of an error.
+    ///
+    constexpr uint8_t getDetail() const noexcept {
+        return _detail;
+    }
+
 public: // Operators to allow working with the results as status.
     /// Compare the status of this result.
     ///
@@ -135,17 +162,22 @@ public: // Operators to allow working with the results as status.
 private:
     /// The private constructor to create a new status result.
     ///
-    constexpr explicit StatusResult(StatusEnum status, ValueType value = {}) noexcept
-        : _status(status), _value(value)
+    constexpr explicit StatusResult(StatusEnum status, ValueType value = {}, uint8_t detail = 0) noexcept
+        : _status(status), _detail(detail), _value(value)
     {
     }
 
 private:
     StatusEnum _status; ///< The status of the result.
+    uint8_t _detail; ///< The detail of an error, placed in the padding after the status.
     ValueType _value; ///< The value of the result.
 };
 
 
+static_assert(sizeof(StatusResult<uint16_t>) == 2 * sizeof(uint16_t),
+    "The error detail must not increase the size of a result.");
+
+
 template<typename ValueType, typename StatusEnum>
 constexpr inline bool isSuccessful(const StatusResult<ValueType, StatusEnum> &statusResult) noexcept
 {
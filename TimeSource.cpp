@@ -0,0 +1,115 @@
+//
+// (c)2020 by Lucky Resistor. See LICENSE for details.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+#include "TimeSource.hpp"
+
+
+#include <thread>
+
+
+namespace lr {
+
+
+TimeSource::TimePoint RealTimeSource::now() const
+{
+    return std::chrono::steady_clock::now();
+}
+
+
+TimeSource::SystemTimePoint RealTimeSource::getSystemTime() const
+{
+    return std::chrono::system_clock::now();
+}
+
+
+void RealTimeSource::sleepFor(std::chrono::nanoseconds duration)
+{
+    std::this_thread::sleep_for(duration);
+}
+
+
+void RealTimeSource::sleepUntil(TimePoint timePoint)
+{
+    std::this_thread::sleep_until(timePoint);
+}
+
+
+bool RealTimeSource::isRealTime() const
+{
+    return true;
+}
+
+
+SimulatedTimeSource::SimulatedTimeSource(SystemTimePoint systemTime)
+    : _startTime(std::chrono::steady_clock::now()), _systemStartTime(systemTime), _elapsedTime(0)
+{
+}
+
+
+void SimulatedTimeSource::advance(std::chrono::nanoseconds duration)
+{
+    if (duration.count() > 0) {
+        _elapsedTime += duration;
+    }
+}
+
+
+std::chrono::nanoseconds SimulatedTimeSource::getElapsedTime() const
+{
+    return _elapsedTime;
+}
+
+
+TimeSource::TimePoint SimulatedTimeSource::now() const
+{
+    return _startTime + std::chrono::duration_cast<TimePoint::duration>(_elapsedTime);
+}
+
+
+TimeSource::SystemTimePoint SimulatedTimeSource::getSystemTime() const
+{
+    return _systemStartTime + std::chrono::duration_cast<SystemTimePoint::duration>(_elapsedTime);
+}
+
+
+void SimulatedTimeSource::sleepFor(std::chrono::nanoseconds duration)
+{
+    advance(duration);
+}
+
+
+void SimulatedTimeSource::sleepUntil(TimePoint timePoint)
+{
+    advance(timePoint - now());
+}
+
+
+bool SimulatedTimeSource::isRealTime() const
+{
+    return false;
+}
+
+
+TimeSource &getRealTimeSource()
+{
+    static RealTimeSource realTimeSource;
+    return realTimeSource;
+}
+
+
+}
+
@@ -0,0 +1,128 @@
+#pragma once
+//
+// (c)2020 by Lucky Resistor. See LICENSE for details.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+
+
+#include <chrono>
+
+
+namespace lr {
+
+
+/// The source of time for the sensors and the sampler.
+///
+/// All waits and time stamps of the sensor and scheduling code go through this interface,
+/// so a simulation can run days of operation in seconds.
+///
+class TimeSource
+{
+public:
+    using TimePoint = std::chrono::steady_clock::time_point;
+    using SystemTimePoint = std::chrono::system_clock::time_point;
+
+public:
+    /// dtor
+    ///
+    virtual ~TimeSource() = default;
+
+public:
+    /// Get the current monotonic time.
+    ///
+    virtual TimePoint now() const = 0;
+
+    /// Get the current wall clock time, used for stored time stamps.
+    ///
+    virtual SystemTimePoint getSystemTime() const = 0;
+
+    /// Wait for the given duration.
+    ///
+    /// @param duration The duration.
+    ///
+    virtual void sleepFor(std::chrono::nanoseconds duration) = 0;
+
+    /// Wait until the given time.
+    ///
+    /// @param timePoint The time to wait for.
+    ///
+    virtual void sleepUntil(TimePoint timePoint) = 0;
+
+    /// Check if this is the real time.
+    ///
+    virtual bool isRealTime() const = 0;
+};
+
+
+/// The real time, using the monotonic and the system clock.
+///
+class RealTimeSource : public TimeSource
+{
+public:
+    TimePoint now() const override;
+    SystemTimePoint getSystemTime() const override;
+    void sleepFor(std::chrono::nanoseconds duration) override;
+    void sleepUntil(TimePoint timePoint) override;
+    bool isRealTime() const override;
+};
+
+
+/// A simulated time, which advances only with the waits.
+///
+/// Every wait returns immediately and moves the time forward. The simulated time must
+/// only be used by one thread.
+///
+class SimulatedTimeSource : public TimeSource
+{
+public:
+    /// Create a simulated time.
+    ///
+    /// @param systemTime The wall clock time at the start of the simulation.
+    ///
+    explicit SimulatedTimeSource(SystemTimePoint systemTime = std::chrono::system_clock::now());
+
+public:
+    /// Move the time forward.
+    ///
+    /// @param duration The duration.
+    ///
+    void advance(std::chrono::nanoseconds duration);
+
+    /// Get the simulated time since the start.
+    ///
+    std::chrono::nanoseconds getElapsedTime() const;
+
+public: // Implement TimeSource
+    TimePoint now() const override;
+    SystemTimePoint getSystemTime() const override;
+    void sleepFor(std::chrono::nanoseconds duration) override;
+    void sleepUntil(TimePoint timePoint) override;
+    bool isRealTime() const override;
+
+private:
+    TimePoint _startTime; ///< The monotonic time at the start.
+    SystemTimePoint _systemStartTime; ///< The wall clock time at the start.
+    std::chrono::nanoseconds _elapsedTime; ///< The simulated time since the start.
+};
+
+
+/// Access the shared real time source.
+///
+TimeSource &getRealTimeSource();
+
+
+}
+
@@ -0,0 +1,91 @@
+//
+// (c)2020 by Lucky Resistor. See LICENSE for details.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+#include "WakeupEvent.hpp"
+
+
+#include <cerrno>
+#include <cstdint>
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+
+namespace lr {
+
+
+WakeupEvent::WakeupEvent()
+:
+    _fd(-1),
+    _isWaiting(false)
+{
+}
+
+
+WakeupEvent::~WakeupEvent()
+{
+    close();
+}
+
+
+WakeupEvent::Status WakeupEvent::open()
+{
+    _fd = eventfd(0, EFD_CLOEXEC);
+    if (_fd < 0) {
+        return Status::IoError;
+    }
+    return Status::Success;
+}
+
+
+void WakeupEvent::close()
+{
+    if (_fd >= 0) {
+        ::close(_fd);
+        _fd = -1;
+    }
+}
+
+
+void WakeupEvent::wake() noexcept
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (_isWaiting.exchange(false, std::memory_order_relaxed)) {
+        signal();
+    }
+}
+
+
+void WakeupEvent::signal() noexcept
+{
+    const uint64_t value = 1;
+    if (::write(_fd, &value, sizeof(value)) < 0) {
+        // The counter of the event can not overflow with single increments.
+    }
+}
+
+
+void WakeupEvent::waitForSignal() noexcept
+{
+    uint64_t value;
+    while (::read(_fd, &value, sizeof(value)) < 0 && errno == EINTR) {
+    }
+}
+
+
+}
+
@@ -0,0 +1,99 @@
+#pragma once
+//
+// (c)2020 by Lucky Resistor. See LICENSE for details.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+
+
+#include "StatusTools.hpp"
+
+#include <atomic>
+
+
+namespace lr {
+
+
+/// An event to wake a consumer thread, which waits for entries of a lock-free queue.
+///
+/// The producer calls `wake()` after adding entries, which only makes a system call if the
+/// consumer actually waits. The consumer calls `wait()` with a check of its queue: either the
+/// check sees the new entries, or the producer sees that the consumer waits.
+///
+class WakeupEvent
+{
+public:
+    using Status = CallStatus;
+
+public:
+    /// ctor
+    ///
+    WakeupEvent();
+
+    /// dtor
+    ///
+    ~WakeupEvent();
+
+    WakeupEvent(const WakeupEvent&) = delete;
+    WakeupEvent &operator=(const WakeupEvent&) = delete;
+
+public:
+    /// Create the event.
+    ///
+    /// @return The call status. `IoError` if the event can not be created, with the error number in `errno`.
+    ///
+    Status open();
+
+    /// Close the event.
+    ///
+    void close();
+
+    /// Wake the consumer, if it waits.
+    ///
+    void wake() noexcept;
+
+    /// Wake the consumer, even if it does not wait yet, so its next wait returns at once.
+    ///
+    void signal() noexcept;
+
+    /// Wait until the event is woken, unless the consumer is ready.
+    ///
+    /// @param isReady A function which checks if there is work for the consumer.
+    ///
+    template<typename IsReady>
+    void wait(IsReady isReady) {
+        _isWaiting.store(true, std::memory_order_relaxed);
+        // Pairs with the fence in `wake()`.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (isReady()) {
+            _isWaiting.store(false, std::memory_order_relaxed);
+            return;
+        }
+        waitForSignal();
+    }
+
+private:
+    /// Block until the event is signalled.
+    ///
+    void waitForSignal() noexcept;
+
+private:
+    int _fd; ///< The file descriptor of the event, or -1.
+    std::atomic<bool> _isWaiting; ///< If the consumer waits for the event.
+};
+
+
+}
+
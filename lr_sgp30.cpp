@@ -0,0 +1,237 @@
+//
+// (c)2020 by Lucky Resistor. See LICENSE for details.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+#include "lr_sgp30.h"
+
+
+#include "I2CBus.hpp"
+#include "SGP30.hpp"
+#include "StatusMessage.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <sstream>
+
+
+/// The sensor handle of the C API.
+///
+struct lr_sgp30 {
+    explicit lr_sgp30(int bus) : sensor(bus), errorDetail(0) {}
+
+    lr::SGP30 sensor; ///< The sensor.
+    uint8_t errorDetail; ///< The detail of the last failed call.
+};
+
+
+namespace {
+
+
+static_assert(static_cast<int>(lr::CallStatus::IoError) == LR_SGP30_IO_ERROR, "The status values of the C API must match.");
+
+
+/// Convert a call status for the C API and keep the error detail.
+///
+/// @param handle The sensor handle.
+/// @param status The call status.
+/// @param detail The detail of the error.
+/// @return The status for the C API.
+///
+lr_sgp30_status toStatus(lr_sgp30 *handle, lr::CallStatus status, uint8_t detail) noexcept
+{
+    if (lr::hasError(status)) {
+        handle->errorDetail = detail;
+    }
+    return static_cast<lr_sgp30_status>(status);
+}
+
+
+/// Convert a call status for the C API and keep the error detail.
+///
+lr_sgp30_status toStatus(lr_sgp30 *handle, lr::CallStatus status) noexcept
+{
+    return toStatus(handle, status, handle->sensor.getErrorDetail(status));
+}
+
+
+/// Convert the status of a result for the C API and keep the error detail.
+///
+template<typename Result>
+lr_sgp30_status toStatus(lr_sgp30 *handle, const Result &result) noexcept
+{
+    return toStatus(handle, result.getStatus(), result.getDetail());
+}
+
+
+}
+
+
+extern "C" {
+
+
+int lr_sgp30_api_version(void)
+{
+    return LR_SGP30_API_VERSION;
+}
+
+
+const char *lr_sgp30_status_name(lr_sgp30_status status)
+{
+    return lr::getStatusName(static_cast<lr::CallStatus>(status));
+}
+
+
+lr_sgp30_status lr_sgp30_open(int bus, uint8_t mux_address, uint8_t mux_channel, lr_sgp30 **sensor)
+{
+    if (sensor == nullptr || bus < 0 || (mux_address != 0 && mux_channel > 7)) {
+        return LR_SGP30_BAD_PARAMETER;
+    }
+    auto handle = new (std::nothrow) lr_sgp30(bus);
+    if (handle == nullptr) {
+        return LR_SGP30_ERROR;
+    }
+    handle->sensor.getBus()->setMuxChannel(mux_address, mux_channel);
+    if (const auto status = handle->sensor.openBus(); lr::hasError(status)) {
+        delete handle;
+        return static_cast<lr_sgp30_status>(status);
+    }
+    *sensor = handle;
+    return LR_SGP30_SUCCESS;
+}
+
+
+void lr_sgp30_close(lr_sgp30 *sensor)
+{
+    if (sensor != nullptr) {
+        sensor->sensor.closeBus();
+        delete sensor;
+    }
+}
+
+
+void lr_sgp30_set_lock_timeout(lr_sgp30 *sensor, uint32_t timeout_ms)
+{
+    sensor->sensor.getBusLock().setTimeout(std::chrono::milliseconds(timeout_ms));
+}
+
+
+uint8_t lr_sgp30_error_detail(const lr_sgp30 *sensor)
+{
+    return sensor->errorDetail;
+}
+
+
+lr_sgp30_status lr_sgp30_init(lr_sgp30 *sensor)
+{
+    return toStatus(sensor, sensor->sensor.initializeMeasurements());
+}
+
+
+lr_sgp30_status lr_sgp30_read(lr_sgp30 *sensor, uint16_t *co2_ppm, uint16_t *tvoc_ppb)
+{
+    const auto result = sensor->sensor.readMeasurements();
+    if (lr::isSuccessful(result)) {
+        std::tie(*co2_ppm, *tvoc_ppb) = result.getValue();
+    }
+    return toStatus(sensor, result);
+}
+
+
+lr_sgp30_status lr_sgp30_get_baseline(lr_sgp30 *sensor, uint16_t *co2, uint16_t *tvoc)
+{
+    const auto result = sensor->sensor.getIAQBaseline();
+    if (lr::isSuccessful(result)) {
+        std::tie(*co2, *tvoc) = result.getValue();
+    }
+    return toStatus(sensor, result);
+}
+
+
+lr_sgp30_status lr_sgp30_set_baseline(lr_sgp30 *sensor, uint16_t co2, uint16_t tvoc)
+{
+    return toStatus(sensor, sensor->sensor.setIAQBaseline(std::make_tuple(co2, tvoc)));
+}
+
+
+lr_sgp30_status lr_sgp30_set_humidity(lr_sgp30 *sensor, double temperature_celsius, double relative_humidity)
+{
+    return toStatus(sensor, sensor->sensor.setHumidityCompensation(temperature_celsius, relative_humidity));
+}
+
+
+lr_sgp30_status lr_sgp30_read_serial_number(lr_sgp30 *sensor, uint64_t *serial_number)
+{
+    const auto result = sensor->sensor.readSerialNumberValue();
+    if (lr::isSuccessful(result)) {
+        *serial_number = result.getValue();
+    }
+    return toStatus(sensor, result);
+}
+
+
+lr_sgp30_status lr_sgp30_read_feature_set(lr_sgp30 *sensor, uint16_t *feature_set)
+{
+    const auto result = sensor->sensor.readFeatureSet();
+    if (lr::isSuccessful(result)) {
+        *feature_set = result.getValue();
+    }
+    return toStatus(sensor, result);
+}
+
+
+void lr_sgp30_get_statistics(const lr_sgp30 *sensor, lr_sgp30_statistics *statistics)
+{
+    const auto bus = sensor->sensor.getBus();
+    const auto &busStatistics = bus->getStatistics();
+    const auto &lockStatistics = bus->getBusLock().getStatistics();
+    statistics->writes = busStatistics.writes;
+    statistics->reads = busStatistics.reads;
+    statistics->bytes_written = busStatistics.bytesWritten;
+    statistics->bytes_read = busStatistics.bytesRead;
+    statistics->errors = busStatistics.errors;
+    statistics->crc_failures = sensor->sensor.getStatistics().crcFailures;
+    statistics->lock_acquisitions = lockStatistics.acquisitions;
+    statistics->lock_contentions = lockStatistics.contentions;
+    statistics->lock_timeouts = lockStatistics.timeouts;
+    statistics->lock_total_wait_ns = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(lockStatistics.totalWait).count());
+}
+
+
+size_t lr_sgp30_write_statistics_json(const lr_sgp30 *sensor, char *buffer, size_t size)
+{
+    try {
+        std::ostringstream output;
+        lr::SensirionSensor::writeStatisticsJson(output, {&sensor->sensor});
+        const auto text = output.str();
+        if (size > 0) {
+            const auto length = std::min(text.size(), size - 1);
+            std::memcpy(buffer, text.data(), length);
+            buffer[length] = '\0';
+        }
+        return text.size();
+    } catch (const std::bad_alloc&) {
+        if (size > 0) {
+            buffer[0] = '\0';
+        }
+        return 0;
+    }
+}
+
+
+}
+
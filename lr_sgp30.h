@@ -0,0 +1,215 @@
+#pragma once
+//
+// (c)2020 by Lucky Resistor. See LICENSE for details.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/// @file
+/// The C API of the SGP30 library.
+///
+/// The library reads SGP30 sensors in-process, using the same bus implementation as the
+/// `read_sgp30` tool, including the cross-process bus lock. All functions return a status code
+/// instead of throwing or writing messages. A sensor handle must not be used from several
+/// threads at the same time, but different handles can be used in parallel.
+///
+/// The API is stable for the same `LR_SGP30_API_VERSION`. New functions are only appended.
+///
+
+
+/// The version of the C API.
+///
+#define LR_SGP30_API_VERSION 1
+
+#if defined(LR_SGP30_BUILDING_LIBRARY)
+#define LR_SGP30_EXPORT __attribute__((visibility("default")))
+#else
+#define LR_SGP30_EXPORT
+#endif
+
+
+/// The status of a call.
+///
+/// The values match `lr::CallStatus` of the C++ implementation.
+///
+typedef enum lr_sgp30_status {
+    LR_SGP30_SUCCESS = 0, ///< The call was successful.
+    LR_SGP30_ERROR = 1, ///< A generic error, like a closed bus or a failed allocation.
+    LR_SGP30_NACK = 2, ///< The sensor did not acknowledge a transfer.
+    LR_SGP30_SHORT_READ = 3, ///< The sensor returned less bytes than requested.
+    LR_SGP30_CRC_MISMATCH = 4, ///< The CRC of a returned value did not match.
+    LR_SGP30_TIMEOUT = 5, ///< A timeout on the bus or while waiting for the bus lock.
+    LR_SGP30_BAD_PARAMETER = 6, ///< A parameter was out of range.
+    LR_SGP30_IO_ERROR = 7, ///< Any other error of the bus device.
+} lr_sgp30_status;
+
+
+/// An opaque handle for one sensor.
+///
+typedef struct lr_sgp30 lr_sgp30;
+
+
+/// The statistics of the bus and the sensor.
+///
+typedef struct lr_sgp30_statistics {
+    uint64_t writes; ///< The number of write calls.
+    uint64_t reads; ///< The number of read calls.
+    uint64_t bytes_written; ///< The number of written bytes.
+    uint64_t bytes_read; ///< The number of read bytes.
+    uint64_t errors; ///< The number of failed bus operations.
+    uint64_t crc_failures; ///< The number of values with a CRC mismatch.
+    uint64_t lock_acquisitions; ///< The number of bus lock acquisitions.
+    uint64_t lock_contentions; ///< The number of acquisitions which had to wait.
+    uint64_t lock_timeouts; ///< The number of acquisitions which timed out.
+    uint64_t lock_total_wait_ns; ///< The total time waiting for the bus lock.
+} lr_sgp30_statistics;
+
+
+/// Get the version of the C API of the loaded library.
+///
+/// @return The value of `LR_SGP30_API_VERSION` the library was built with.
+///
+LR_SGP30_EXPORT int lr_sgp30_api_version(void);
+
+/// Get the name of a status, like "crc_mismatch".
+///
+/// @param status The status.
+/// @return A static string.
+///
+LR_SGP30_EXPORT const char *lr_sgp30_status_name(lr_sgp30_status status);
+
+/// Open a sensor.
+///
+/// @param bus The number of the I2C bus, like 1 for `/dev/i2c-1`.
+/// @param mux_address The address of a TCA9548 multiplexer, or zero without multiplexer.
+/// @param mux_channel The channel of the multiplexer, 0-7.
+/// @param sensor Receives the new handle on success.
+/// @return The status of the call.
+///
+LR_SGP30_EXPORT lr_sgp30_status lr_sgp30_open(int bus, uint8_t mux_address, uint8_t mux_channel, lr_sgp30 **sensor);
+
+/// Close a sensor and free the handle.
+///
+/// @param sensor The handle, may be `NULL`.
+///
+LR_SGP30_EXPORT void lr_sgp30_close(lr_sgp30 *sensor);
+
+/// Set the maximum wait for the cross-process bus lock.
+///
+/// @param sensor The handle.
+/// @param timeout_ms The timeout in milliseconds. 2000 is the default.
+///
+LR_SGP30_EXPORT void lr_sgp30_set_lock_timeout(lr_sgp30 *sensor, uint32_t timeout_ms);
+
+/// Get the detail of the last failed call.
+///
+/// @param sensor The handle.
+/// @return The error number for `LR_SGP30_NACK`, `LR_SGP30_TIMEOUT` and `LR_SGP30_IO_ERROR`, the
+///     received bytes for `LR_SGP30_SHORT_READ` or the value index for `LR_SGP30_CRC_MISMATCH`.
+///
+LR_SGP30_EXPORT uint8_t lr_sgp30_error_detail(const lr_sgp30 *sensor);
+
+/// Initialize the measurements.
+///
+/// @param sensor The handle.
+/// @return The status of the call.
+///
+LR_SGP30_EXPORT lr_sgp30_status lr_sgp30_init(lr_sgp30 *sensor);
+
+/// Read the measurements.
+///
+/// @param sensor The handle.
+/// @param co2_ppm Receives the CO2 equivalent in ppm.
+/// @param tvoc_ppb Receives the TVOC value in ppb.
+/// @return The status of the call.
+///
+LR_SGP30_EXPORT lr_sgp30_status lr_sgp30_read(lr_sgp30 *sensor, uint16_t *co2_ppm, uint16_t *tvoc_ppb);
+
+/// Get the iAQ baseline.
+///
+/// @param sensor The handle.
+/// @param co2 Receives the CO2 baseline.
+/// @param tvoc Receives the TVOC baseline.
+/// @return The status of the call.
+///
+LR_SGP30_EXPORT lr_sgp30_status lr_sgp30_get_baseline(lr_sgp30 *sensor, uint16_t *co2, uint16_t *tvoc);
+
+/// Set the iAQ baseline.
+///
+/// @param sensor The handle.
+/// @param co2 The CO2 baseline.
+/// @param tvoc The TVOC baseline.
+/// @return The status of the call.
+///
+LR_SGP30_EXPORT lr_sgp30_status lr_sgp30_set_baseline(lr_sgp30 *sensor, uint16_t co2, uint16_t tvoc);
+
+/// Set the humidity compensation.
+///
+/// @param sensor The handle.
+/// @param temperature_celsius The temperature in celsius.
+/// @param relative_humidity The relative humidity in percent.
+/// @return The status of the call.
+///
+LR_SGP30_EXPORT lr_sgp30_status lr_sgp30_set_humidity(lr_sgp30 *sensor, double temperature_celsius, double relative_humidity);
+
+/// Read the serial number.
+///
+/// @param sensor The handle.
+/// @param serial_number Receives the 48 bit serial number.
+/// @return The status of the call.
+///
+LR_SGP30_EXPORT lr_sgp30_status lr_sgp30_read_serial_number(lr_sgp30 *sensor, uint64_t *serial_number);
+
+/// Read the feature set.
+///
+/// @param sensor The handle.
+/// @param feature_set Receives the feature set.
+/// @return The status of the call.
+///
+LR_SGP30_EXPORT lr_sgp30_status lr_sgp30_read_feature_set(lr_sgp30 *sensor, uint16_t *feature_set);
+
+/// Get the statistics.
+///
+/// @param sensor The handle.
+/// @param statistics Receives the statistics.
+///
+LR_SGP30_EXPORT void lr_sgp30_get_statistics(const lr_sgp30 *sensor, lr_sgp30_statistics *statistics);
+
+/// Write the statistics with the command latencies as JSON.
+///
+/// Like `snprintf`, the output is truncated to the buffer size and always terminated.
+///
+/// @param sensor The handle.
+/// @param buffer The buffer, may be `NULL` if `size` is zero.
+/// @param size The size of the buffer.
+/// @return The length of the complete JSON text, without the terminating zero.
+///
+LR_SGP30_EXPORT size_t lr_sgp30_write_statistics_json(const lr_sgp30 *sensor, char *buffer, size_t size);
+
+
+#ifdef __cplusplus
+}
+#endif
+